@@ -0,0 +1,274 @@
+# Benchmarks for the hot paths of pybytes and membridge
+#
+# Run from the root of the repository after building the modules:
+#
+#     python3 benchmarks/benchmark.py [--quick] [--json results.json] [--processes 1,2,4]
+#
+# The serialization benchmarks report the throughput of `from_value` and `to_value` per datatype,
+# next to `pickle` and `marshal`. The IPC benchmarks report the latency of `write_memory`, `read_memory`
+# and `call_function` while multiple processes use them at once. With `--json`, all results are also
+# written to a file, so that they can be compared across releases.
+
+from sysframe import pybytes, membridge
+
+from array import array
+from collections import deque
+import argparse
+import datetime
+import json
+import marshal
+import os
+import pickle
+import platform
+import sys
+import time
+
+# Use the test values from `test_pybytes` as the values of every datatype
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tests'))
+from test_pybytes import test_values
+
+
+# # Payloads
+
+def realistic_payloads(scale):
+    """The payloads to benchmark besides the test values, as (name, value) pairs."""
+
+    records = [{'id': i, 'name': f'user-{i}', 'email': f'user-{i}@example.com', 'active': i % 3 != 0, 'score': i * 0.5, 'tags': ['alpha', 'beta'][:i % 3]} for i in range(10000 // scale)]
+    config = {f'section-{i}': {'enabled': True, 'timeout': 30.0, 'retries': 3, 'hosts': [f'10.0.{i}.{j}' for j in range(8)], 'labels': {'team': 'core', 'tier': i % 4}} for i in range(500 // scale)}
+
+    return [
+        ('records', records),
+        ('config', config),
+        ('ints', list(range(100000 // scale))),
+        ('floats', [i / 7 for i in range(100000 // scale)]),
+        ('strings', [f'string-{i}' for i in range(50000 // scale)]),
+        ('array', array('d', range(1000000 // scale))),
+        ('text', 'lorem ipsum dolor sit amet, ' * (100000 // scale)),
+        ('blob', os.urandom((8 << 20) // scale)),
+    ]
+
+def count_objects(value):
+    """The number of objects in a value, counting nested items and dict keys."""
+
+    if isinstance(value, dict):
+        return 1 + sum(count_objects(key) + count_objects(item) for key, item in value.items())
+    if isinstance(value, (list, tuple, set, frozenset, deque)):
+        return 1 + sum(count_objects(item) for item in value)
+    if isinstance(value, array):
+        return 1 + len(value)
+    return 1
+
+
+# # Timing helpers
+
+def best_time(function, min_time):
+    """The best time in seconds of a single call of a function, repeated for at least `min_time` seconds."""
+
+    best = float('inf')
+    deadline = time.perf_counter() + min_time
+    calls = 0
+
+    while calls < 3 or time.perf_counter() < deadline:
+        start = time.perf_counter()
+        function()
+        best = min(best, time.perf_counter() - start)
+        calls += 1
+
+    return best
+
+def percentiles(latencies):
+    """The p50, p99 and max of latencies in seconds, in microseconds."""
+
+    latencies = sorted(latencies)
+    at = lambda fraction: latencies[min(len(latencies) - 1, int(len(latencies) * fraction))] * 1e6
+
+    return {'p50_us': round(at(0.50), 2), 'p99_us': round(at(0.99), 2), 'max_us': round(latencies[-1] * 1e6, 2), 'samples': len(latencies)}
+
+
+# # Serialization benchmarks
+
+def serializers():
+    """The serializers to compare, as (name, encode, decode) tuples."""
+
+    return [
+        ('pybytes', pybytes.from_value, pybytes.to_value),
+        ('pickle', lambda value: pickle.dumps(value, protocol=pickle.HIGHEST_PROTOCOL), pickle.loads),
+        ('marshal', marshal.dumps, marshal.loads),
+    ]
+
+def bench_payload(name, value, min_time):
+    """Benchmark every serializer on a payload, skipping those that don't support it."""
+
+    objects = count_objects(value)
+    results = []
+
+    for serializer, encode, decode in serializers():
+        # Serializers fail in different ways on values they don't support
+        try:
+            encoded = encode(value)
+            decode(encoded)
+        except Exception:
+            continue
+
+        encode_time = best_time(lambda: encode(value), min_time)
+        decode_time = best_time(lambda: decode(encoded), min_time)
+
+        results.append({
+            'payload': name,
+            'serializer': serializer,
+            'size': len(encoded),
+            'objects': objects,
+            'encode_us': round(encode_time * 1e6, 2),
+            'decode_us': round(decode_time * 1e6, 2),
+            'encode_mb_s': round(len(encoded) / encode_time / 1e6, 1),
+            'decode_mb_s': round(len(encoded) / decode_time / 1e6, 1),
+            'encode_objects_s': round(objects / encode_time),
+            'decode_objects_s': round(objects / decode_time),
+        })
+
+    return results
+
+def bench_serialization(quick):
+    """Benchmark the test values grouped by datatype, and the realistic payloads."""
+
+    min_time = 0.05 if quick else 0.25
+
+    # Group the test values by their type, so that every datatype is reported once
+    by_type = {}
+    for value in test_values:
+        by_type.setdefault(type(value).__name__, []).append(value)
+
+    payloads = [(f'type:{name}', values) for name, values in by_type.items()]
+    payloads += realistic_payloads(10 if quick else 1)
+
+    results = []
+    for name, value in payloads:
+        results += bench_payload(name, value, min_time)
+
+    return results
+
+
+# # IPC benchmarks
+
+def run_processes(count, worker):
+    """Run a worker in `count` processes at once, and collect the latencies they return through pipes."""
+
+    pipes = []
+    for index in range(count):
+        read_fd, write_fd = os.pipe()
+        pid = os.fork()
+
+        if pid == 0:
+            os.close(read_fd)
+            exit_code = 0
+            try:
+                data = pickle.dumps(worker(index))
+                with os.fdopen(write_fd, 'wb') as file:
+                    file.write(data)
+            except BaseException:
+                exit_code = 1
+            os._exit(exit_code)
+
+        os.close(write_fd)
+        pipes.append((pid, read_fd))
+
+    latencies = []
+    for pid, read_fd in pipes:
+        with os.fdopen(read_fd, 'rb') as file:
+            data = file.read()
+        os.waitpid(pid, 0)
+
+        if not data:
+            raise RuntimeError('A benchmark worker process failed')
+        latencies += pickle.loads(data)
+
+    return latencies
+
+def time_calls(function, iterations):
+    """The latency of every call of a function."""
+
+    latencies = []
+    for _ in range(iterations):
+        start = time.perf_counter()
+        function()
+        latencies.append(time.perf_counter() - start)
+
+    return latencies
+
+def bench_ipc(quick, process_counts):
+    """Benchmark the latency of shared memory reads and writes, and of shared function calls."""
+
+    iterations = 500 if quick else 5000
+    name = f'/sysframe-benchmark-{os.getpid()}'
+    function_name = f'/sysframe-benchmark-function-{os.getpid()}'
+
+    payloads = [('small', {'id': 1, 'name': 'small', 'values': [1, 2, 3]}), ('medium', [{'id': i, 'name': f'item-{i}'} for i in range(1000)])]
+    results = []
+
+    membridge.create_function(function_name, lambda value: value, background=True)
+
+    try:
+        for payload_name, payload in payloads:
+            membridge.write_memory(name, payload)
+
+            for count in process_counts:
+                operations = {
+                    'write_memory': lambda index: time_calls(lambda: membridge.write_memory(name, payload), iterations),
+                    'read_memory': lambda index: time_calls(lambda: membridge.read_memory(name), iterations),
+                    'call_function': lambda index: time_calls(lambda: membridge.call_function(function_name, (payload,)), iterations),
+                }
+
+                for operation, worker in operations.items():
+                    results.append({'operation': operation, 'payload': payload_name, 'processes': count, **percentiles(run_processes(count, worker))})
+    finally:
+        membridge.remove_function(function_name)
+        membridge.remove_memory(name)
+
+    return results
+
+
+# # Reporting
+
+def print_table(title, rows, columns):
+    """Print rows of results as an aligned table."""
+
+    print(f'\n{title}\n')
+    widths = [max(len(column), *(len(str(row.get(column, ''))) for row in rows)) for column in columns]
+
+    print('  '.join(column.ljust(width) for column, width in zip(columns, widths)))
+    for row in rows:
+        print('  '.join(str(row.get(column, '')).ljust(width) for column, width in zip(columns, widths)))
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark the hot paths of pybytes and membridge.')
+    parser.add_argument('--quick', action='store_true', help='use smaller payloads and fewer iterations')
+    parser.add_argument('--json', metavar='PATH', help='also write the results to a JSON file')
+    parser.add_argument('--processes', default='1,2,4', help='comma-separated numbers of processes for the IPC benchmarks')
+    parser.add_argument('--skip-ipc', action='store_true', help='only run the serialization benchmarks')
+    args = parser.parse_args()
+
+    process_counts = [int(count) for count in args.processes.split(',')]
+
+    results = {
+        'meta': {
+            'time': datetime.datetime.now(datetime.timezone.utc).isoformat(),
+            'python': platform.python_version(),
+            'platform': platform.platform(),
+            'cpus': os.cpu_count(),
+            'quick': args.quick,
+        },
+        'serialization': bench_serialization(args.quick),
+        'ipc': [] if args.skip_ipc else bench_ipc(args.quick, process_counts),
+    }
+
+    print_table('Serialization', results['serialization'], ['payload', 'serializer', 'size', 'encode_us', 'decode_us', 'encode_mb_s', 'decode_mb_s', 'encode_objects_s', 'decode_objects_s'])
+    if results['ipc']:
+        print_table('IPC latency', results['ipc'], ['operation', 'payload', 'processes', 'p50_us', 'p99_us', 'max_us', 'samples'])
+
+    if args.json:
+        with open(args.json, 'w') as file:
+            json.dump(results, file, indent=2)
+        print(f'\nWrote the results to {args.json}')
+
+if __name__ == '__main__':
+    main()
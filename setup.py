@@ -39,6 +39,8 @@ setup(
                 'sysframe/pybytes/pybytes.c',
                 'sysframe/pybytes/sbs_main/sbs_2.c',
                 'sysframe/pybytes/sbs_old/sbs_1.c',
+                'sysframe/pybytes/sfs_main/sfs_1.c',
+                'sysframe/pybytes/srs_main/srs_1.c',
             ],
             include_dirs=[
                 'sysframe/pybytes',
@@ -51,6 +53,7 @@ setup(
                 'sysframe/membridge/membridge.c',
                 'sysframe/pybytes/sbs_main/sbs_2.c',
                 'sysframe/pybytes/sbs_old/sbs_1.c',
+                'sysframe/pybytes/sfs_main/sfs_1.c',
             ],
             include_dirs=[
                 'sysframe/membridge',
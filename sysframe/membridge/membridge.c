@@ -1,8 +1,17 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <structmember.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <signal.h>
+#include <limits.h>
+#include <time.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -14,11 +23,50 @@
 
 // Include the serialization function from pybytes (from_value, to_value)
 #include "sbs_main/sbs_2.h"
+// Include the random-access protocol from pybytes (sfs_get_item, sfs_set_item)
+#include "sfs_main/sfs_1.h"
+
+/*
+  The segments can count what's done with them, for finding out where the
+  time goes in production. The counters live in the segments, so that every
+  process sees the same counts, but only the processes that enabled the
+  stats count. The others only pay for checking the flag.
+
+*/
+
+static int stats_enabled = 0;
+
+// Add to a counter in shared memory, if the stats are enabled in this process
+#define COUNT_SHARED(counter, amount) do { \
+        if (__atomic_load_n(&stats_enabled, __ATOMIC_RELAXED)) __atomic_fetch_add(&(counter), (uint64_t)(amount), __ATOMIC_RELAXED); \
+    } while (0)
+
+// The counters of a basic segment
+typedef struct {
+    uint64_t reads;         // Values copied out by readers
+    uint64_t read_retries;  // Copies retried because a write overlapped them
+    uint64_t bytes_read;    // Bytes copied out by readers
+    uint64_t writes;        // Writes done, including items set
+    uint64_t bytes_written; // The sizes of the values after the writes
+    uint64_t remaps;        // Times a process remapped the segment after it was resized
+    uint64_t lock_waits;    // Times a writer found the lock taken
+    uint64_t lock_wait_ns;  // The total time writers waited for the lock
+} BasicStats;
+
+#define BASIC_STATS (sizeof(BasicStats) / sizeof(uint64_t))
 
 // Struct for basic shared memory
 typedef struct {
     size_t max_size;
-    pthread_mutex_t mutex;
+    size_t used_size;    // The size of the value currently written, always up to max_size
+    uint64_t generation; // Incremented on every resize, so that mapped handles know when to remap
+    uint32_t seq;        // Sequence number for the readers, odd while a write is in progress
+    uint32_t version;    // Incremented after every write, the futex that `wait_for_change` waits on
+    uint32_t waiters;    // The number of processes sleeping on the version
+    uint32_t placement;  // The PLACE_* flags of the segment, applied to every part it grows by
+    int32_t numa_node;   // The NUMA node to prefer for the pages of the segment, -1 for none
+    BasicStats stats;
+    pthread_mutex_t mutex; // Only taken by writers
 } BasicShm;
 
 // The default size for basic shared memory
@@ -27,9 +75,151 @@ typedef struct {
 // The headroom size for not too frequent reallocs
 #define HEAD_SIZE 32
 
+// # Futex helpers
+
+/*
+  The shared functions, channels and change notifications use futexes
+  to wait on each other. These are not process-private, so they work
+  across processes on shared memory.
+
+*/
+
+// Wait while the word at the address holds the expected value, with a timeout in ms (-1 for none). Returns -1 on timeout
+static inline int futex_wait(uint32_t *address, uint32_t expected, long timeout_ms)
+{
+    struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000};
+
+    if (syscall(SYS_futex, address, FUTEX_WAIT, expected, timeout_ms < 0 ? NULL : &timeout, NULL, 0) == -1 && errno == ETIMEDOUT)
+        return -1;
+
+    return 0;
+}
+
+// Wake up to `count` waiters on the word at the address
+static inline void futex_wake(uint32_t *address, int count)
+{
+    syscall(SYS_futex, address, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+// Helper function to tell the CPU we're spinning
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Whether spinning can pay off, which it can't if the side we wait on can't run at the same time
+static int spinning_allowed = 1;
+
+// Helper function to get the spin budget to actually use
+static inline int spin_budget(int spin)
+{
+    return spinning_allowed ? spin : 0;
+}
+
+// Spin for up to `spins` checks while the word at the address holds the expected value. Returns 1 if it changed
+static inline int spin_wait(uint32_t *address, uint32_t expected, int spins)
+{
+    for (int i = 0; i < spins; i++)
+    {
+        if (__atomic_load_n(address, __ATOMIC_ACQUIRE) != expected) return 1;
+        cpu_relax();
+    }
+
+    return 0;
+}
+
+// Helper function to get a monotonic timestamp in ns
+static inline uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Helper function to get a timeout in seconds from a float or None, where None (-1) waits forever. Returns -1 on error
+static inline int parse_timeout(PyObject *timeout_obj, double *timeout)
+{
+    *timeout = -1;
+    if (timeout_obj == NULL || timeout_obj == Py_None) return 0;
+
+    *timeout = PyFloat_AsDouble(timeout_obj);
+    if (*timeout == -1 && PyErr_Occurred()) return -1;
+    if (*timeout < 0) *timeout = 0;
+
+    return 0;
+}
+
+// Helper function to get the time to sleep for at once until a deadline in ns (0 for none). Returns -1 once it passed
+static inline long wait_slice_ms(uint64_t deadline, long max_ms)
+{
+    if (deadline == 0) return max_ms;
+
+    uint64_t now = monotonic_ns();
+    if (now >= deadline) return -1;
+
+    uint64_t left_ms = (deadline - now + 999999) / 1000000;
+    return left_ms < (uint64_t)max_ms ? (long)left_ms : max_ms;
+}
+
 // # Shared memory creation & setup
 
-static inline int create_shared_memory(const char *name, size_t pre_size, PyObject *error_if_exists)
+/*
+  Big segments can ask for their pages to be placed with care, which is
+  stored in the segment so that every part it grows by gets the same.
+
+  POSIX shared memory lives on tmpfs, which can't be mapped with
+  MAP_HUGETLB, but does back its pages with transparent huge pages once
+  we ask for it with madvise. Populating faults all pages in up front,
+  so that the first writes don't pay for it, and the NUMA node is set as
+  the preferred node of the pages with mbind before they exist, as it
+  doesn't move pages that were already allocated.
+
+*/
+
+#define PLACE_HUGE_PAGES 1 // Back the segment with transparent huge pages
+#define PLACE_POPULATE   2 // Allocate the pages of the segment right away
+
+// Helper function to place the pages of a range of a mapped segment. Returns -1 if the NUMA node couldn't be set
+static inline int place_basic_range(BasicShm *shm, int fd, size_t start, size_t end)
+{
+    // The calls below work on whole pages, and the first page of the range might be in use already, which is fine
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    start -= start % page_size;
+    if (start >= end) return 0;
+
+    unsigned char *address = (unsigned char *)shm + start;
+    size_t size = end - start;
+
+    if (shm->numa_node >= 0)
+    {
+        unsigned long nodemask[16] = {0};
+        nodemask[shm->numa_node / (8 * sizeof(unsigned long))] = 1UL << (shm->numa_node % (8 * sizeof(unsigned long)));
+
+        if (syscall(SYS_mbind, address, size, MPOL_PREFERRED, nodemask, sizeof(nodemask) * 8, 0) == -1) return -1;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (shm->placement & PLACE_HUGE_PAGES) madvise(address, size, MADV_HUGEPAGE);
+#endif
+
+    if (shm->placement & PLACE_POPULATE)
+    {
+        // Fault the pages in through the mapping so that the hints above apply, or allocate them through the file on older kernels
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(address, size, MADV_POPULATE_WRITE) == 0) return 0;
+#endif
+        fallocate(fd, 0, (off_t)start, (off_t)size);
+    }
+
+    return 0;
+}
+
+static inline int create_shared_memory(const char *name, size_t pre_size, PyObject *error_if_exists, uint32_t placement, int numa_node)
 {
     int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
     if (fd == -1)
@@ -51,7 +241,9 @@ static inline int create_shared_memory(const char *name, size_t pre_size, PyObje
         return -1;
     }
 
-    BasicShm *shm = mmap(NULL, BASIC_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // Map all of it if the pages have to be placed, and only the basic structure otherwise
+    size_t mapped_size = placement != 0 || numa_node >= 0 ? BASIC_SIZE + pre_size : BASIC_SIZE;
+    BasicShm *shm = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     if (shm == MAP_FAILED)
     {
         close(fd);
@@ -66,7 +258,7 @@ static inline int create_shared_memory(const char *name, size_t pre_size, PyObje
         pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 ||
         pthread_mutex_init(&(shm->mutex), &attr) != 0)
     {
-        munmap(shm, BASIC_SIZE);
+        munmap(shm, mapped_size);
         close(fd);
         shm_unlink(name);
         PyErr_Format(PyExc_MemoryError, "Failed to initialize mutex for shared memory address '%s'.", name);
@@ -74,8 +266,25 @@ static inline int create_shared_memory(const char *name, size_t pre_size, PyObje
     }
 
     shm->max_size = pre_size;
+    shm->used_size = 0;
+    shm->generation = 0;
+    shm->seq = 0;
+    shm->version = 0;
+    shm->waiters = 0;
+    shm->placement = placement;
+    shm->numa_node = numa_node;
     pthread_mutexattr_destroy(&attr);
-    munmap(shm, BASIC_SIZE);
+
+    if (place_basic_range(shm, fd, 0, mapped_size) == -1)
+    {
+        munmap(shm, mapped_size);
+        close(fd);
+        shm_unlink(name);
+        PyErr_Format(PyExc_ValueError, "Failed to place shared memory address '%s' on NUMA node %d.", name, numa_node);
+        return -1;
+    }
+
+    munmap(shm, mapped_size);
     close(fd);
 
     // Return 0 to indicate success
@@ -87,15 +296,24 @@ PyObject *create_memory(PyObject *self, PyObject *args, PyObject *kwargs)
     const char *name;
     PyObject *prealloc_size = NULL;
     PyObject *error_if_exists = NULL;
+    int huge_pages = 0;
+    int populate = 0;
+    int numa_node = -1;
 
-    static char* kwlist[] = {"name", "prealloc_size", "error_if_exists", NULL};
+    static char* kwlist[] = {"name", "prealloc_size", "error_if_exists", "huge_pages", "populate", "numa_node", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O!O!", kwlist, &name, &PyLong_Type, &prealloc_size, &PyBool_Type, &error_if_exists))
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O!O!ppi", kwlist, &name, &PyLong_Type, &prealloc_size, &PyBool_Type, &error_if_exists, &huge_pages, &populate, &numa_node))
     {
         PyErr_SetString(PyExc_ValueError, "Expected at least the name (str) argument.");
         return NULL;
     }
 
+    if (numa_node < -1 || numa_node >= 1024)
+    {
+        PyErr_SetString(PyExc_ValueError, "The NUMA node should be between 0 and 1023, or -1 for none.");
+        return NULL;
+    }
+
     size_t pre_size = 0;
     if (prealloc_size != NULL)
     {
@@ -107,7 +325,8 @@ PyObject *create_memory(PyObject *self, PyObject *args, PyObject *kwargs)
         }
     }
 
-    int result = create_shared_memory(name, pre_size, error_if_exists);
+    uint32_t placement = (huge_pages ? PLACE_HUGE_PAGES : 0) | (populate ? PLACE_POPULATE : 0);
+    int result = create_shared_memory(name, pre_size, error_if_exists, placement, numa_node);
     switch(result)
     {
     case -1: return NULL; // Error already set
@@ -121,516 +340,3226 @@ PyObject *create_memory(PyObject *self, PyObject *args, PyObject *kwargs)
     }
 }
 
-// Helper function to get the basic shared memory pointer
-static inline BasicShm *get_basic_shm(const char *name, size_t new_size, PyObject *create)
+/*
+  Channels and tables are initialized once by the process that creates
+  them, which sets the magic number at the start of the segment last.
+  Other processes wait for it, so that they never use a half-initialized
+  segment. This also tells the segment apart from other kinds.
+
+*/
+
+// Open and map a whole segment once it's initialized, with its magic number in the first 4 bytes. Returns NULL on failure
+static inline void *map_ready_shm(const char *name, uint32_t magic, size_t header_size, size_t *mapped_size)
+{
+    int fd = shm_open(name, O_RDWR, 0666);
+    if (fd == -1)
+    {
+        PyErr_Format(PyExc_MemoryError, "Failed to open shared memory address '%s'.", name);
+        return NULL;
+    }
+
+    // Another process might have just created the segment, so give it a moment to initialize it
+    struct stat info;
+    void *shm = MAP_FAILED;
+    for (int attempt = 0; attempt < 1000; attempt++)
+    {
+        if (fstat(fd, &info) == -1) break;
+
+        if ((size_t)info.st_size >= header_size)
+        {
+            shm = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (shm == MAP_FAILED || __atomic_load_n((uint32_t *)shm, __ATOMIC_ACQUIRE) == magic) break;
+
+            munmap(shm, (size_t)info.st_size);
+            shm = MAP_FAILED;
+        }
+
+        sched_yield();
+    }
+    close(fd);
+
+    if (shm == MAP_FAILED)
+    {
+        PyErr_Format(PyExc_MemoryError, "Failed to map shared memory address '%s', or it isn't of the right kind.", name);
+        return NULL;
+    }
+
+    *mapped_size = (size_t)info.st_size;
+    return shm;
+}
+
+// # Basic shared memory handles
+
+// Struct that holds an opened and mapped basic shared memory segment
+typedef struct {
+    int fd;
+    BasicShm *shm;
+    BasicShm *header;    // A second mapping of just the BasicShm struct, which is never remapped, so it stays valid to block on without the GIL
+    size_t mapped_size;  // The size of our mapping, including the BasicShm struct
+    uint64_t generation; // The generation of the segment at the time we mapped it
+} BasicHandle;
+
+// Helper function to open and map a basic shared memory segment
+static inline int open_basic_handle(BasicHandle *handle, const char *name, PyObject *create)
 {
     int fd = shm_open(name, O_RDWR, 0666);
     if (fd == -1)
     {
         if (errno == ENOENT && (create == NULL || (create && Py_IsTrue(create))))
         {
-            if (create_shared_memory(name, 0, NULL) == -1)
-                return NULL;
+            if (create_shared_memory(name, 0, NULL, 0, -1) == -1)
+                return -1;
             fd = shm_open(name, O_RDWR, 0666);
             if (fd == -1)
             {
                 PyErr_Format(PyExc_MemoryError, "Failed to open shared memory address '%s' after creation.", name);
-                return NULL;
+                return -1;
             }
         }
         else
         {
             PyErr_Format(PyExc_MemoryError, "Failed to open shared memory address '%s'.", name);
-            return NULL;
+            return -1;
         }
     }
 
-    // Map the basic structure first to access max_size
+    // Map just the basic structure for now, the rest is mapped once we hold the lock
     BasicShm *shm = mmap(NULL, BASIC_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (shm == MAP_FAILED)
+    BasicShm *header = shm == MAP_FAILED ? MAP_FAILED : mmap(NULL, BASIC_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED)
     {
+        if (shm != MAP_FAILED) munmap(shm, BASIC_SIZE);
         close(fd);
         PyErr_Format(PyExc_MemoryError, "Failed to map shared memory metadata address '%s'.", name);
-        return NULL;
+        return -1;
     }
 
-    // Get the max size from the basic structure
-    size_t max_size = shm->max_size;
-    size_t total_size = BASIC_SIZE + max_size;
-    
-    // Unmap the initial mapping to remap the full size
-    munmap(shm, BASIC_SIZE);
+    handle->fd = fd;
+    handle->shm = shm;
+    handle->header = header;
+    handle->mapped_size = BASIC_SIZE;
+    // Use a generation that can't match, so that the first lock maps the full size
+    handle->generation = shm->generation - 1;
 
-    // Check whether we got a new size we might need to update
-    if (new_size > max_size)
-    {
-        // Update the new total size
-        total_size = BASIC_SIZE + new_size + HEAD_SIZE;
+    return 0;
+}
+
+// Helper function to remap a handle to the current size of the segment
+static inline int remap_basic_handle(BasicHandle *handle, const char *name)
+{
+    // Get the generation before the size, as readers can get here while a writer is resizing
+    uint64_t generation = __atomic_load_n(&(handle->shm->generation), __ATOMIC_ACQUIRE);
+    size_t total_size = BASIC_SIZE + __atomic_load_n(&(handle->shm->max_size), __ATOMIC_RELAXED);
 
-        if (ftruncate(fd, total_size) == -1)
+    if (total_size != handle->mapped_size)
+    {
+        // Let the kernel move the mapping if it can't be grown in place
+        void *mapping = mremap(handle->shm, handle->mapped_size, total_size, MREMAP_MAYMOVE);
+        if (mapping == MAP_FAILED)
         {
-            close(fd);
-            PyErr_Format(PyExc_MemoryError, "Failed to resize shared memory.");
-            return NULL;
+            PyErr_Format(PyExc_MemoryError, "Failed to remap shared memory address '%s'.", name);
+            return -1;
         }
-    }
 
-    // Remap with the correct size
-    shm = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (shm == MAP_FAILED)
-    {
-        close(fd);
-        PyErr_Format(PyExc_MemoryError, "Failed to map shared memory address '%s'.", name);
-        return NULL;
-    }
+        handle->shm = (BasicShm *)mapping;
+        handle->mapped_size = total_size;
+        COUNT_SHARED(handle->shm->stats.remaps, 1);
 
-    // Update the max size if it was changed
-    if (shm->max_size < new_size)
-        shm->max_size = new_size + HEAD_SIZE;
+#ifdef MADV_HUGEPAGE
+        // The hint belongs to our mapping, so every process has to give it
+        if (handle->shm->placement & PLACE_HUGE_PAGES) madvise(mapping, total_size, MADV_HUGEPAGE);
+#endif
+    }
 
-    close(fd);
-    return shm;
+    handle->generation = generation;
+    return 0;
 }
 
-// Function to close a shared memory pointer
-static inline void close_shm(BasicShm *shm)
+/*
+  The basic shared memory uses a seqlock. Writers serialize on the mutex,
+  and make the sequence number odd while they write and even once they're
+  done. Readers never take the mutex. They copy the value out, and retry
+  if the sequence number was odd or changed in the meantime.
+
+  Because the readers don't lock, the segment never shrinks. A reader
+  could still be copying from a part we'd truncate, and fault on it.
+
+  Values are serialized before taking the lock, as serializing can run
+  Python code that releases the GIL, and nothing may wait on us while
+  the sequence number is odd. With the lock only held for a memcpy, the
+  others can wait for it without holding the GIL either: writers block
+  on the mutex through the header mapping, which doesn't move when
+  another thread remaps the segment, and readers yield without it.
+
+*/
+
+static inline void unlock_basic_handle(BasicHandle *handle)
 {
-    pthread_mutex_unlock(&(shm->mutex));
-    munmap(shm, BASIC_SIZE + shm->max_size);
+    pthread_mutex_unlock(&(handle->header->mutex));
 }
 
-PyObject *remove_memory(PyObject *self, PyObject *args, PyObject *kwargs)
+// Helper function to lock the segment for writing, and remap if another process resized it
+static inline int lock_basic_handle(BasicHandle *handle, const char *name)
 {
-    const char *name;
-    PyObject *throw_error = NULL;
-
-    static char* kwlist[] = {"name", "throw_error", NULL};
+    int counting = __atomic_load_n(&stats_enabled, __ATOMIC_RELAXED);
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O!", kwlist, &name, &PyBool_Type, &throw_error))
+    // Try first, so that uncontended writes neither pay for the clock nor release the GIL
+    if (pthread_mutex_trylock(&(handle->header->mutex)) != 0)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument.");
-        return NULL;
-    }
+        uint64_t start = counting ? monotonic_ns() : 0;
 
-    if (shm_unlink(name) == -1)
-    {
-        if (throw_error && Py_IsTrue(throw_error))
+        // The holder might need the GIL to finish, so don't hold it while we wait
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&(handle->header->mutex));
+        Py_END_ALLOW_THREADS
+
+        if (counting)
         {
-            PyErr_SetString(PyExc_MemoryError, "Failed to unlink the shared memory.");
-            return NULL;
+            __atomic_fetch_add(&(handle->shm->stats.lock_waits), 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&(handle->shm->stats.lock_wait_ns), monotonic_ns() - start, __ATOMIC_RELAXED);
         }
-        Py_RETURN_FALSE;
     }
 
-    Py_RETURN_TRUE;
-}
-
-PyObject *read_memory(PyObject *self, PyObject *args)
-{
-    const char *name;
-
-    if (!PyArg_ParseTuple(args, "s", &name))
+    // Only remap if the segment was resized since our last mapping
+    if (handle->generation != handle->shm->generation && remap_basic_handle(handle, name) == -1)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
-        return NULL;
+        unlock_basic_handle(handle);
+        return -1;
     }
 
-    BasicShm *shm = get_basic_shm(name, 0, Py_None);
-    if (shm == NULL) return NULL;  // Error already set
-
-    if (shm->max_size == 0)
-    {
-        close_shm(shm);
-        Py_RETURN_NONE;
-    }
+    return 0;
+}
 
-    PyObject *py_bytes = PyBytes_FromStringAndSize((char *)shm + BASIC_SIZE, shm->max_size);
-    PyObject *value = to_value(py_bytes);
+// Mark the start of a write for the readers, should only be called while holding the lock
+static inline void begin_basic_write(BasicShm *shm)
+{
+    __atomic_store_n(&(shm->seq), shm->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-    Py_DECREF(py_bytes);
-    close_shm(shm);
+// Mark the end of a write for the readers, and wake the processes waiting for a change if there are any
+static inline void end_basic_write(BasicShm *shm)
+{
+    __atomic_store_n(&(shm->seq), shm->seq + 1, __ATOMIC_RELEASE);
+    COUNT_SHARED(shm->stats.writes, 1);
+    COUNT_SHARED(shm->stats.bytes_written, shm->used_size);
 
-    return value;
+    __atomic_fetch_add(&(shm->version), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(shm->waiters), __ATOMIC_SEQ_CST) > 0)
+        futex_wake(&(shm->version), INT_MAX);
 }
 
-PyObject *write_memory(PyObject *self, PyObject *args, PyObject *kwargs)
+// Helper function to grow the segment, should only be called while holding the lock
+static inline int grow_basic_handle(BasicHandle *handle, const char *name, size_t new_size)
 {
-    const char *name;
-    PyObject *value;
-    PyObject *create = NULL;
+    // Add the headroom to prevent having to resize on every slightly larger write
+    size_t max_size = new_size + HEAD_SIZE;
 
-    static char* kwlist[] = {"name", "value", "create", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|O!", kwlist, &name, &value, &PyBool_Type, &create))
+    if (ftruncate(handle->fd, BASIC_SIZE + max_size) == -1)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) and 'value' (any) arguments.");
-        return NULL;
+        PyErr_Format(PyExc_MemoryError, "Failed to resize shared memory address '%s'.", name);
+        return -1;
     }
 
-    // Convert the value to a Python bytes object
-    PyObject *py_bytes = from_value(value);
-    if (py_bytes == NULL) return NULL; // Error already set
-
-    // Convert the Python bytes object to C bytes
-    size_t size;
-    char *bytes;
-    if (PyBytes_AsStringAndSize(py_bytes, &bytes, (Py_ssize_t *)&size) == -1)
-    {
-        Py_DECREF(py_bytes);
-        PyErr_SetString(PyExc_RuntimeError, "Failed to convert a Python bytes object to a C string.");
-        return NULL;
-    }
-    Py_DECREF(py_bytes);
+    // Publish the new size before the generation, so that readers never map more than exists
+    size_t old_size = BASIC_SIZE + handle->shm->max_size;
+    __atomic_store_n(&(handle->shm->max_size), max_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&(handle->shm->generation), handle->shm->generation + 1, __ATOMIC_RELEASE);
 
-    BasicShm *shm = get_basic_shm(name, size, create);
-    if (shm == NULL) return NULL;
+    if (remap_basic_handle(handle, name) == -1) return -1;
 
-    memcpy((char *)shm + BASIC_SIZE, bytes, size);
-    close_shm(shm);
-    Py_RETURN_TRUE;
+    // Place the new pages like the rest, the node was already checked when the segment was created
+    if (old_size < handle->mapped_size) place_basic_range(handle->shm, handle->fd, old_size, handle->mapped_size);
+    return 0;
 }
 
-// # Shared functions
-
-typedef struct {
-    pthread_mutex_t mutex;
-    pthread_cond_t fcond; // Function cond
-    pthread_cond_t ccond; // Caller cond
-    unsigned char activity;
-} FunctionShm;
+// Helper function for readers waiting on a write in progress. Returns -1 if a signal interrupted us
+static inline int wait_for_basic_write(size_t *spins)
+{
+    // Give the writer some time before yielding our timeslice to it, and the GIL to the other threads
+    if (++(*spins) < 64) return 0;
 
-#define FUNCTION_ARGS 1024 // The static size that will hold the args
-#define FUNCTION_SIZE sizeof(FunctionShm)
+    Py_BEGIN_ALLOW_THREADS
+    sched_yield();
+    Py_END_ALLOW_THREADS
 
-// Helper function to write a NULL message to function shm
-static inline void null_function(FunctionShm *shm)
-{
-    // Simply set the first arg byte to NULL
-    ((char *)shm)[FUNCTION_SIZE] = 0;
+    // Check for signals every once in a while, so that a dead writer doesn't hang us forever
+    if ((*spins & 0x3FF) == 0 && PyErr_CheckSignals() == -1) return -1;
+    return 0;
 }
 
-// Initiate a shared memory for a shared function
-static inline PyObject *create_shared_function(const char *name, PyObject *func)
+// Function to unmap and close a handle
+static inline void close_basic_handle(BasicHandle *handle)
 {
-    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
-    if (fd == -1)
-    {
-        if (errno == EEXIST)
-            PyErr_Format(PyExc_MemoryError, "The memory address '%s' already exists.", name);
-        else
-            PyErr_Format(PyExc_MemoryError, "Failed to create memory address '%s'.", name);
-        
-        return NULL;
-    }
-
-    if (ftruncate(fd, FUNCTION_SIZE + FUNCTION_ARGS) == -1)
-    {
-        close(fd);
-        shm_unlink(name);
-        PyErr_Format(PyExc_MemoryError, "Failed to allocate for shared memory address '%s'.", name);
-        return NULL;
-    }
+    if (handle->shm == NULL) return;
 
-    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE + FUNCTION_ARGS, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    close(fd);
-    if (shm == MAP_FAILED)
-    {
-        shm_unlink(name);
-        PyErr_Format(PyExc_MemoryError, "Failed to map shared memory address '%s'.", name);
-        return NULL;
-    }
+    munmap(handle->shm, handle->mapped_size);
+    munmap(handle->header, BASIC_SIZE);
+    close(handle->fd);
 
-    // Initiate the mutex
-    pthread_mutexattr_t mutex_attr;
-    if (pthread_mutexattr_init(&mutex_attr) != 0 ||
-        pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED) != 0 ||
-        pthread_mutex_init(&(shm->mutex), &mutex_attr) != 0)
-    {
-        munmap(shm, BASIC_SIZE);
-        shm_unlink(name);
-        PyErr_Format(PyExc_MemoryError, "Failed to initialize mutex for shared memory address '%s'.", name);
-        return NULL;
-    }
-    pthread_mutexattr_destroy(&mutex_attr);
+    handle->shm = NULL;
+    handle->header = NULL;
+    handle->fd = -1;
+}
 
-    // Initiate the function cond
-    pthread_condattr_t func_attr;
-    if (pthread_condattr_init(&func_attr) != 0 ||
-        pthread_condattr_setpshared(&func_attr, PTHREAD_PROCESS_SHARED) != 0 ||
-        pthread_cond_init(&(shm->fcond), &func_attr) != 0)
-    {
-        munmap(shm, BASIC_SIZE);
-        shm_unlink(name);
-        PyErr_Format(PyExc_MemoryError, "Failed to initialize signal cond for shared memory address '%s'.", name);
-        return NULL;
-    }
-    pthread_condattr_destroy(&func_attr);
+// Copy the value out of the segment into a bytes object, or return None if the segment is empty. Sets the sequence number of the copy if `copied_seq` isn't NULL
+static inline PyObject *copy_basic_handle(BasicHandle *handle, const char *name, uint32_t *copied_seq)
+{
+    // The bytes object we copy the value into, reused across retries of the same size
+    PyObject *buffer = NULL;
+    size_t spins = 0;
 
-    // Initiate the caller cond
-    pthread_condattr_t call_attr;
-    if (pthread_condattr_init(&call_attr) != 0 ||
-        pthread_condattr_setpshared(&call_attr, PTHREAD_PROCESS_SHARED) != 0 ||
-        pthread_cond_init(&(shm->ccond), &call_attr) != 0)
+    while (1)
     {
-        munmap(shm, BASIC_SIZE);
-        shm_unlink(name);
-        PyErr_Format(PyExc_MemoryError, "Failed to initialize signal cond for shared memory address '%s'.", name);
-        return NULL;
-    }
-    pthread_condattr_destroy(&call_attr);
-
-    // Set the activity byte to 1 to indicate activity
-    shm->activity = 1;
-
-    // This will hold the exit status, set to 0 on clean exit
-    unsigned char exit_status = 1;
-
-    // Set a while loop to repeatedly catch all signals
-    while (1) {
-        // Begin waiting on the cond to be signaled
-        pthread_mutex_lock(&(shm->mutex));
-        pthread_cond_wait(&(shm->fcond), &(shm->mutex));
+        uint32_t seq = __atomic_load_n(&(handle->shm->seq), __ATOMIC_ACQUIRE);
 
-        // Check if the activity byte is set to inactive (0)
-        if (shm->activity == 0) {
-            printf("read\n");
-            // Set the exit status to 1 because we didn't exit with an error
-            exit_status = 0;
-            // Break the loop to cleanup
-            break;
+        // Check whether a write is in progress
+        if (seq & 1)
+        {
+            if (wait_for_basic_write(&spins) == -1)
+            {
+                Py_XDECREF(buffer);
+                return NULL;
+            }
+            continue;
         }
 
-        // Check whether the first byte is NULL, meaning we got a NULL message
-        if (*((char *)shm + FUNCTION_SIZE) == 0)
+        // Remap if the segment was resized since our last mapping
+        if (handle->generation != __atomic_load_n(&(handle->shm->generation), __ATOMIC_ACQUIRE) && remap_basic_handle(handle, name) == -1)
         {
-            PyErr_SetString(PyExc_RuntimeError, "Received a NULL message from the caller. This is likely because the caller sent arguments of too large size.");
-            break;
+            Py_XDECREF(buffer);
+            return NULL;
         }
 
-        // Convert the args to a Python value
-        PyObject *py_args = to_value(PyBytes_FromStringAndSize((char *)shm + FUNCTION_SIZE, FUNCTION_ARGS));
+        size_t size = __atomic_load_n(&(handle->shm->used_size), __ATOMIC_RELAXED);
 
-        // This will hold the args to be returned
-        PyObject *returned_args = NULL; // NULL by default to return errors on non-success scenarios
+        // The segment was grown after we checked the generation, so retry to remap first
+        if (BASIC_SIZE + size > handle->mapped_size) continue;
 
-        // Check if the args is a tuple
-        if (PyTuple_Check(py_args))
-            // Set the return args to the functions we receive from the function to call
-            if ((returned_args = PyObject_CallObject(func, py_args)) == NULL) return NULL;
-        Py_DECREF(py_args);
+        // Create a new buffer if the value doesn't have the same size
+        if (buffer == NULL || (size_t)PyBytes_GET_SIZE(buffer) != size)
+        {
+            Py_XDECREF(buffer);
+            buffer = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)size);
+            if (buffer == NULL) return NULL;
+        }
 
-        // Convert the return args to a char array to store them
-        PyObject *py_return = from_value(returned_args);
-        Py_XDECREF(returned_args);
-        if (py_return == NULL) break; // Error already set
+        memcpy(PyBytes_AS_STRING(buffer), (const unsigned char *)handle->shm + BASIC_SIZE, size);
 
-        size_t returned_size;
-        char *returned_bytes;
-        if (PyBytes_AsStringAndSize(py_return, &returned_bytes, (Py_ssize_t *)&returned_size) == -1)
+        // Check whether nothing was written while we were copying
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&(handle->shm->seq), __ATOMIC_RELAXED) != seq)
         {
-            Py_DECREF(py_return);
-            PyErr_SetString(PyExc_RuntimeError, "Failed to convert a Python bytes object to C bytes.");
-            break;
+            COUNT_SHARED(handle->shm->stats.read_retries, 1);
+            continue;
         }
-        Py_DECREF(py_return);
 
-        // Check whether the size doesn't exceed the limit
-        if (returned_size > FUNCTION_ARGS) break;
+        COUNT_SHARED(handle->shm->stats.reads, 1);
+        COUNT_SHARED(handle->shm->stats.bytes_read, size);
+        if (copied_seq != NULL) *copied_seq = seq;
 
-        // Set the returned bytes
-        memcpy((char *)shm + FUNCTION_SIZE, returned_bytes, returned_size);
+        if (size == 0)
+        {
+            Py_DECREF(buffer);
+            Py_RETURN_NONE;
+        }
 
-        // Signal the caller that the returned args are set
-        pthread_cond_signal(&(shm->ccond));
-        pthread_mutex_unlock(&(shm->mutex));
+        return buffer;
     }
+}
 
-    // Check whether we have to clean up some stuff due to an exception that occurred
-    if (exit_status == 1)
+// Decode the value stored in the segment of a handle, as a lazy view of the copy if `lazy` is set
+static inline PyObject *decode_basic_handle(BasicHandle *handle, const char *name, int lazy)
+{
+    while (1)
     {
-        null_function(shm);
-        // Signal the caller and unlock to prevent deadlocks
-        pthread_cond_signal(&(shm->ccond));
-        pthread_mutex_unlock(&(shm->mutex));
-    }
+        uint32_t seq;
+        PyObject *buffer = copy_basic_handle(handle, name, &seq);
+        if (buffer == NULL || buffer == Py_None) return buffer;
 
-    // Unmap and unlink the shared memory
-    munmap(shm, FUNCTION_SIZE + FUNCTION_ARGS);
-    shm_unlink(name);
+        // Decode the copy, only including the bytes that were written. The views keep the copy alive. Values can hold out-of-band buffers if they were written with `oob_threshold`
+        PyObject *value = lazy ? view_value(buffer, 1) : to_value_buf_oob((const unsigned char *)PyBytes_AS_STRING(buffer), (size_t)PyBytes_GET_SIZE(buffer));
+        Py_DECREF(buffer);
 
-    // Return None on success, NULL on error to throw it
-    return exit_status == 1 ? NULL : Py_None;
+        // Out-of-band buffers are released once their value is overwritten, so read the new value if that happened after our copy
+        if (value == NULL && PyErr_ExceptionMatches(PyExc_FileNotFoundError) && __atomic_load_n(&(handle->shm->seq), __ATOMIC_ACQUIRE) != seq)
+        {
+            PyErr_Clear();
+            continue;
+        }
+
+        return value;
+    }
 }
 
-PyObject *create_function(PyObject *self, PyObject *args)
+static inline PyObject *read_basic_handle(BasicHandle *handle, const char *name)
 {
-    const char *name;
+    return decode_basic_handle(handle, name, 0);
+}
+
+// Same as above, but only creates a lazy view of the copy. The copy is only a memcpy, while decoding is what takes the time
+static inline PyObject *view_basic_handle(BasicHandle *handle, const char *name)
+{
+    return decode_basic_handle(handle, name, 1);
+}
+
+// Release the out-of-band buffers of the value stored in the segment, as it's about to be overwritten. Should only be called while holding the lock
+static inline void release_basic_value(BasicHandle *handle)
+{
+    // Only segments with a valid header of out-of-band buffers are released, so the worst a broken value can do is keep its buffers around
+    if (release_oob_frame((const unsigned char *)handle->shm + BASIC_SIZE, handle->shm->used_size) == -1) PyErr_Clear();
+}
+
+// Struct that the target of a handle gets as its context
+typedef struct {
+    BasicHandle *handle;
+    const char *name;
+} BasicTargetContext;
+
+// Grow function for writing directly into the segment of a handle, for setting items of SFS values in place
+static int grow_basic_target(SBSTarget *target, size_t size)
+{
+    BasicTargetContext *context = (BasicTargetContext *)target->context;
+
+    // Grow at least twice the size, as every resize means a syscall and a remap
+    if (size < target->size * 2) size = target->size * 2;
+
+    if (grow_basic_handle(context->handle, context->name, size) == -1) return -1;
+
+    // The mapping might have moved, so point the target to the new one
+    target->bytes = (unsigned char *)context->handle->shm + BASIC_SIZE;
+    target->size = context->handle->shm->max_size;
+    return 0;
+}
+
+// Grow function for serializing into a heap buffer, before the bytes are copied to the segment
+static int grow_heap_target(SBSTarget *target, size_t size)
+{
+    // Grow at least twice the size, so that large values only reallocate a few times
+    if (size < target->size * 2) size = target->size * 2;
+
+    unsigned char *bytes = (unsigned char *)realloc(target->bytes, size);
+    if (bytes == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    target->bytes = bytes;
+    target->size = size;
+    return 0;
+}
+
+// Replace the value in the segment of a handle with serialized bytes. Returns -1 with the old value left intact on failure
+static inline int store_basic_bytes(BasicHandle *handle, const char *name, const unsigned char *bytes, size_t size)
+{
+    if (lock_basic_handle(handle, name) == -1) return -1;
+
+    if (size > handle->shm->max_size && grow_basic_handle(handle, name, size) == -1)
+    {
+        unlock_basic_handle(handle);
+        return -1;
+    }
+
+    // Nothing below runs Python code, so the write is over quickly
+    release_basic_value(handle);
+    begin_basic_write(handle->shm);
+    memcpy((unsigned char *)handle->shm + BASIC_SIZE, bytes, size);
+    __atomic_store_n(&(handle->shm->used_size), size, __ATOMIC_RELAXED);
+    end_basic_write(handle->shm);
+
+    unlock_basic_handle(handle);
+    return 0;
+}
+
+// Write a value in a frame (see compress_value and from_value_oob) to the segment of a handle
+static inline int write_basic_framed(BasicHandle *handle, const char *name, PyObject *value, int refs, int compress, size_t oob_threshold)
+{
+    PyObject *frame = from_value_oob(value, 0, refs, 1, oob_threshold);
+    if (frame != NULL && compress != 0)
+    {
+        PyObject *bytes = frame;
+        frame = compress_value(bytes, compress, COMPRESS_THRESHOLD);
+        Py_DECREF(bytes);
+    }
+    if (frame == NULL) return -1;
+
+    const unsigned char *bytes = (const unsigned char *)PyBytes_AS_STRING(frame);
+    size_t size = (size_t)PyBytes_GET_SIZE(frame);
+
+    // The out-of-band buffers of the frame aren't referenced by anything if it wasn't stored
+    int result = store_basic_bytes(handle, name, bytes, size);
+    if (result == -1) release_oob_frame(bytes, size);
+
+    Py_DECREF(frame);
+    return result;
+}
+
+// Write a value to the segment of a handle
+static inline int write_basic_handle(BasicHandle *handle, const char *name, PyObject *value, int sfs, int refs, int compress, size_t oob_threshold)
+{
+    if (compress != 0 || oob_threshold != 0)
+    {
+        if (sfs)
+        {
+            PyErr_SetString(PyExc_ValueError, "SFS buffers can't be compressed or hold out-of-band buffers, as their items have to be accessible in place.");
+            return -1;
+        }
+
+        if (compress != 0 && oob_threshold != 0)
+        {
+            PyErr_SetString(PyExc_ValueError, "Can't compress values with out-of-band buffers.");
+            return -1;
+        }
+
+        return write_basic_framed(handle, name, value, refs, compress, oob_threshold);
+    }
+
+    // Serialize into a heap buffer first, starting at the size of the current value as the next one tends to be alike
+    size_t initial = handle->shm->used_size > 4096 ? handle->shm->used_size : 4096;
+    SBSTarget target = {(unsigned char *)malloc(initial), initial, grow_heap_target, NULL};
+    if (target.bytes == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    Py_ssize_t size = sfs ? sfs_from_value(value, &target) : from_value_into(value, &target, refs);
+    int result = size == -1 ? -1 : store_basic_bytes(handle, name, target.bytes, (size_t)size);
+
+    free(target.bytes);
+    return result;
+}
+
+/*
+  A value written with `sfs` set is stored as an SFS buffer (see
+  sfs_1.c), so that single items can be read and written without the
+  rest of the value. A writer then only touches the bytes of the item
+  (and its slot in the index), unless the item has to move.
+
+  Readers find the item in the mapping itself, but only copy out its
+  bytes. Those are decoded once the sequence number shows that nothing
+  was written meanwhile. Finding the item might run into a half-written
+  index, which is fine: the SFS functions check every offset against
+  the used size, and we retry once we see the sequence number changed.
+
+*/
+
+static inline PyObject *get_basic_item(BasicHandle *handle, const char *name, PyObject *key)
+{
+    // The buffer we copy the item into, reused across retries
+    unsigned char *buffer = NULL;
+    size_t buffer_size = 0;
+    size_t spins = 0;
+
+    while (1)
+    {
+        uint32_t seq = __atomic_load_n(&(handle->shm->seq), __ATOMIC_ACQUIRE);
+
+        // Check whether a write is in progress
+        if (seq & 1)
+        {
+            if (wait_for_basic_write(&spins) == -1)
+            {
+                free(buffer);
+                return NULL;
+            }
+            continue;
+        }
+
+        // Remap if the segment was resized since our last mapping
+        if (handle->generation != __atomic_load_n(&(handle->shm->generation), __ATOMIC_ACQUIRE) && remap_basic_handle(handle, name) == -1)
+        {
+            free(buffer);
+            return NULL;
+        }
+
+        size_t size = __atomic_load_n(&(handle->shm->used_size), __ATOMIC_RELAXED);
+
+        // The segment was grown after we checked the generation, so retry to remap first
+        if (BASIC_SIZE + size > handle->mapped_size) continue;
+
+        size_t offset, item_size;
+        int result = sfs_find_item((const unsigned char *)handle->shm + BASIC_SIZE, size, key, &offset, &item_size);
+
+        if (result == 0)
+        {
+            // Grow the buffer if the item doesn't fit
+            if (item_size > buffer_size)
+            {
+                unsigned char *temp = (unsigned char *)realloc(buffer, item_size);
+                if (temp == NULL)
+                {
+                    free(buffer);
+                    PyErr_SetString(PyExc_MemoryError, "Not enough memory space available for use.");
+                    return NULL;
+                }
+
+                buffer = temp;
+                buffer_size = item_size;
+            }
+
+            memcpy(buffer, (const unsigned char *)handle->shm + BASIC_SIZE + offset, item_size);
+        }
+
+        // Check whether nothing was written while we were looking, also when we didn't find the item
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&(handle->shm->seq), __ATOMIC_RELAXED) != seq)
+        {
+            if (result == -1) PyErr_Clear();
+            COUNT_SHARED(handle->shm->stats.read_retries, 1);
+            continue;
+        }
+
+        COUNT_SHARED(handle->shm->stats.reads, 1);
+        if (result == 0) COUNT_SHARED(handle->shm->stats.bytes_read, item_size);
+
+        PyObject *value = result == -1 ? NULL : to_value_buf(buffer, item_size);
+
+        free(buffer);
+        return value;
+    }
+}
+
+static inline int set_basic_item(BasicHandle *handle, const char *name, PyObject *key, PyObject *value)
+{
+    // Serialize the key and value before taking the lock, like whole values (see above)
+    PyObject *key_bytes = from_value(key);
+    PyObject *value_bytes = key_bytes == NULL ? NULL : from_value(value);
+    if (value_bytes == NULL || lock_basic_handle(handle, name) == -1)
+    {
+        Py_XDECREF(key_bytes);
+        Py_XDECREF(value_bytes);
+        return -1;
+    }
+
+    BasicTargetContext context = {handle, name};
+    SBSTarget target = {(unsigned char *)handle->shm + BASIC_SIZE, handle->shm->max_size, grow_basic_target, &context};
+
+    // On errors, the SFS buffer is left as it was, so only update the used size on success
+    begin_basic_write(handle->shm);
+    Py_ssize_t size = sfs_set_item_bytes(&target, handle->shm->used_size, key, key_bytes, value_bytes);
+    if (size != -1) __atomic_store_n(&(handle->shm->used_size), (size_t)size, __ATOMIC_RELAXED);
+    end_basic_write(handle->shm);
+
+    unlock_basic_handle(handle);
+    Py_DECREF(key_bytes);
+    Py_DECREF(value_bytes);
+    return size == -1 ? -1 : 0;
+}
+
+/*
+  Every write increments the version of the segment once it's done, so
+  that other processes can wait for a change instead of polling it. The
+  version is a futex, and writers only wake the waiting processes with a
+  syscall if any of them went to sleep.
+
+*/
+
+#define CHANGE_POLL 100 // The max time in ms to sleep at once, so that signals are still handled
+
+// Wait until the version of the segment differs from the last one we saw. Returns the version, which is the last one on timeout
+static inline PyObject *wait_basic_change(BasicHandle *handle, uint32_t last_version, double timeout)
+{
+    // Wait through the header mapping, as other threads can remap the segment while we don't hold the GIL. Memory objects stay mapped while we wait (see enter_memory)
+    BasicShm *shm = handle->header;
+    uint64_t deadline = timeout < 0 ? 0 : monotonic_ns() + (uint64_t)(timeout * 1e9) + 1;
+
+    while (1)
+    {
+        uint32_t version = __atomic_load_n(&(shm->version), __ATOMIC_SEQ_CST);
+        if (version != last_version) return PyLong_FromUnsignedLong(version);
+
+        long wait_ms = wait_slice_ms(deadline, CHANGE_POLL);
+        if (wait_ms == -1) return PyLong_FromUnsignedLong(version);
+
+        Py_BEGIN_ALLOW_THREADS
+        __atomic_fetch_add(&(shm->waiters), 1, __ATOMIC_SEQ_CST);
+        futex_wait(&(shm->version), version, wait_ms);
+        __atomic_fetch_sub(&(shm->waiters), 1, __ATOMIC_SEQ_CST);
+        Py_END_ALLOW_THREADS
+
+        if (PyErr_CheckSignals() == -1) return NULL;
+    }
+}
+
+PyObject *wait_for_change(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    unsigned long last_version = 0;
+    PyObject *timeout_obj = Py_None;
+
+    static char* kwlist[] = {"name", "last_version", "timeout", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|kO", kwlist, &name, &last_version, &timeout_obj))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument, and optionally 'last_version' (int) and 'timeout' (float).");
+        return NULL;
+    }
+
+    double timeout;
+    if (parse_timeout(timeout_obj, &timeout) == -1) return NULL;
+
+    // Create the segment if it doesn't exist yet, so that we can wait for its first write
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, NULL) == -1) return NULL;
+
+    PyObject *version = wait_basic_change(&handle, (uint32_t)last_version, timeout);
+    close_basic_handle(&handle);
+
+    return version;
+}
+
+PyObject *remove_memory(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    PyObject *throw_error = NULL;
+
+    static char* kwlist[] = {"name", "throw_error", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O!", kwlist, &name, &PyBool_Type, &throw_error))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument.");
+        return NULL;
+    }
+
+    // Release the out-of-band buffers of the value, as no one can read it anymore
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_None) == -1) PyErr_Clear();
+    else
+    {
+        if (lock_basic_handle(&handle, name) == -1) PyErr_Clear();
+        else
+        {
+            release_basic_value(&handle);
+            unlock_basic_handle(&handle);
+        }
+        close_basic_handle(&handle);
+    }
+
+    if (shm_unlink(name) == -1)
+    {
+        if (throw_error && Py_IsTrue(throw_error))
+        {
+            PyErr_SetString(PyExc_MemoryError, "Failed to unlink the shared memory.");
+            return NULL;
+        }
+        Py_RETURN_FALSE;
+    }
+
+    Py_RETURN_TRUE;
+}
+
+PyObject *read_memory(PyObject *self, PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_None) == -1) return NULL; // Error already set
+
+    PyObject *value = read_basic_handle(&handle, name);
+    close_basic_handle(&handle);
+
+    return value;
+}
+
+PyObject *view_memory(PyObject *self, PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_None) == -1) return NULL;
+
+    PyObject *value = view_basic_handle(&handle, name);
+    close_basic_handle(&handle);
+
+    return value;
+}
+
+PyObject *write_memory(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    PyObject *value;
+    PyObject *create = NULL;
+    int sfs = 0;
+    int refs = 0;
+    int compress = 0;
+    Py_ssize_t oob_threshold = 0;
+
+    static char* kwlist[] = {"name", "value", "create", "sfs", "refs", "compress", "oob_threshold", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|O!ppin", kwlist, &name, &value, &PyBool_Type, &create, &sfs, &refs, &compress, &oob_threshold) || compress < 0 || compress > 9 || oob_threshold < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) and 'value' (any) arguments, and optionally a 'compress' level from 0 to 9 and a positive 'int' out-of-band threshold.");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, create) == -1) return NULL;
+
+    int result = write_basic_handle(&handle, name, value, sfs, refs, compress, (size_t)oob_threshold);
+    close_basic_handle(&handle);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+PyObject *get_memory_item(PyObject *self, PyObject *args)
+{
+    const char *name;
+    PyObject *key;
+
+    if (!PyArg_ParseTuple(args, "sO", &name, &key))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected the 'name' (str) and 'key' (any) arguments.");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_None) == -1) return NULL;
+
+    PyObject *value = get_basic_item(&handle, name, key);
+    close_basic_handle(&handle);
+
+    return value;
+}
+
+PyObject *set_memory_item(PyObject *self, PyObject *args)
+{
+    const char *name;
+    PyObject *key;
+    PyObject *value;
+
+    if (!PyArg_ParseTuple(args, "sOO", &name, &key, &value))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected the 'name' (str), 'key' (any) and 'value' (any) arguments.");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_False) == -1) return NULL;
+
+    int result = set_basic_item(&handle, name, key, value);
+    close_basic_handle(&handle);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+// Release the memory of the segment that isn't used by the value currently written
+static inline int trim_basic_handle(BasicHandle *handle, const char *name)
+{
+    if (lock_basic_handle(handle, name) == -1) return -1;
+
+    /*
+      As the segment never shrinks (see above), we punch a hole in the
+      unused part instead. That frees its pages, while the readers just
+      read zeroes there instead of faulting. The part has to be aligned
+      to the page size, as only whole pages can be freed.
+
+    */
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (BASIC_SIZE + handle->shm->used_size + page_size - 1) & ~(page_size - 1);
+    size_t end = BASIC_SIZE + handle->shm->max_size;
+
+    int result = 0;
+    if (start < end && fallocate(handle->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)start, (off_t)(end - start)) == -1)
+    {
+        PyErr_Format(PyExc_MemoryError, "Failed to trim shared memory address '%s'.", name);
+        result = -1;
+    }
+
+    unlock_basic_handle(handle);
+    return result;
+}
+
+PyObject *trim_memory(PyObject *self, PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_False) == -1) return NULL;
+
+    int result = trim_basic_handle(&handle, name);
+    close_basic_handle(&handle);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+PyObject *memory_stats(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    int reset = 0;
+
+    static char* kwlist[] = {"name", "reset", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|p", kwlist, &name, &reset))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument, and optionally 'reset' (bool).");
+        return NULL;
+    }
+
+    BasicHandle handle;
+    if (open_basic_handle(&handle, name, Py_False) == -1) return NULL;
+
+    // Swap the counters with 0 when resetting, so that nothing gets lost in between
+    uint64_t *counters = (uint64_t *)&(handle.shm->stats);
+    uint64_t values[BASIC_STATS];
+
+    for (size_t i = 0; i < BASIC_STATS; i++)
+        values[i] = reset ? __atomic_exchange_n(&counters[i], 0, __ATOMIC_RELAXED) : __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+
+    uint32_t version = __atomic_load_n(&(handle.shm->version), __ATOMIC_RELAXED);
+    close_basic_handle(&handle);
+
+    return Py_BuildValue("{sKsKsKsKsKsKsKsKsk}",
+        "reads", (unsigned long long)values[0],
+        "read_retries", (unsigned long long)values[1],
+        "bytes_read", (unsigned long long)values[2],
+        "writes", (unsigned long long)values[3],
+        "bytes_written", (unsigned long long)values[4],
+        "remaps", (unsigned long long)values[5],
+        "lock_waits", (unsigned long long)values[6],
+        "lock_wait_ns", (unsigned long long)values[7],
+        "version", (unsigned long)version);
+}
+
+// # Memory handle objects
+
+/*
+  The functions above open and map the segment on every call. For hot
+  loops, the Memory object keeps the file descriptor and the mapping
+  alive instead. It only remaps when another process resized the
+  segment, which it knows by comparing the generation of the segment.
+
+*/
+
+/*
+  The methods can release the GIL while they use the mapping, waiting
+  for the lock or for a writer, so other threads could close the handle
+  under them. The methods count themselves as users of the handle while
+  they run, and closing a handle that's in use only marks it as closed.
+  The last user unmaps it once it's done.
+
+*/
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *name;
+    BasicHandle handle;
+    int users;   // The number of method calls using the handle, only changed while holding the GIL
+    int closing; // Set if the handle was closed while in use, so that the last user unmaps it
+} MemoryObject;
+
+// Start using the handle if it's still open. Should be followed by leave_memory if it succeeds
+static inline int enter_memory(MemoryObject *self)
+{
+    if (self->handle.shm == NULL || self->closing)
+    {
+        PyErr_SetString(PyExc_ValueError, "The memory handle is closed.");
+        return -1;
+    }
+
+    self->users++;
+    return 0;
+}
+
+static inline void leave_memory(MemoryObject *self)
+{
+    if (--self->users == 0 && self->closing)
+    {
+        close_basic_handle(&(self->handle));
+        self->closing = 0;
+    }
+}
+
+static int Memory_init(MemoryObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    PyObject *create = NULL;
+
+    static char* kwlist[] = {"name", "create", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O!", kwlist, &name, &PyBool_Type, &create))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument.");
+        return -1;
+    }
+
+    if (self->users > 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "The memory handle is in use by another thread.");
+        return -1;
+    }
+
+    // Close the old handle in case init is called twice
+    close_basic_handle(&(self->handle));
+    self->closing = 0;
+    Py_CLEAR(self->name);
+
+    if (open_basic_handle(&(self->handle), name, create) == -1) return -1;
+
+    self->name = PyUnicode_FromString(name);
+    if (self->name == NULL)
+    {
+        close_basic_handle(&(self->handle));
+        return -1;
+    }
+
+    return 0;
+}
+
+static void Memory_dealloc(MemoryObject *self)
+{
+    close_basic_handle(&(self->handle));
+    Py_XDECREF(self->name);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Memory_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    MemoryObject *self = (MemoryObject *)type->tp_alloc(type, 0);
+    if (self == NULL) return NULL;
+
+    // Mark the handle as closed until it's initialized
+    self->name = NULL;
+    self->handle.fd = -1;
+    self->handle.shm = NULL;
+    self->handle.header = NULL;
+    self->users = 0;
+    self->closing = 0;
+
+    return (PyObject *)self;
+}
+
+static PyObject *Memory_read(MemoryObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (enter_memory(self) == -1) return NULL;
+
+    PyObject *value = read_basic_handle(&(self->handle), PyUnicode_AsUTF8(self->name));
+    leave_memory(self);
+
+    return value;
+}
+
+static PyObject *Memory_view(MemoryObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (enter_memory(self) == -1) return NULL;
+
+    PyObject *value = view_basic_handle(&(self->handle), PyUnicode_AsUTF8(self->name));
+    leave_memory(self);
+
+    return value;
+}
+
+static PyObject *Memory_write(MemoryObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *value;
+    int sfs = 0;
+    int refs = 0;
+    int compress = 0;
+    Py_ssize_t oob_threshold = 0;
+
+    static char* kwlist[] = {"value", "sfs", "refs", "compress", "oob_threshold", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ppin", kwlist, &value, &sfs, &refs, &compress, &oob_threshold) || compress < 0 || compress > 9 || oob_threshold < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected the 'value' (any) argument, and optionally 'sfs' (bool), 'refs' (bool), a 'compress' level from 0 to 9 and a positive 'int' out-of-band threshold.");
+        return NULL;
+    }
+
+    if (enter_memory(self) == -1) return NULL;
+
+    int result = write_basic_handle(&(self->handle), PyUnicode_AsUTF8(self->name), value, sfs, refs, compress, (size_t)oob_threshold);
+    leave_memory(self);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+static PyObject *Memory_get_item(MemoryObject *self, PyObject *key)
+{
+    if (enter_memory(self) == -1) return NULL;
+
+    PyObject *value = get_basic_item(&(self->handle), PyUnicode_AsUTF8(self->name), key);
+    leave_memory(self);
+
+    return value;
+}
+
+static PyObject *Memory_set_item(MemoryObject *self, PyObject *args)
+{
+    PyObject *key;
+    PyObject *value;
+
+    if (!PyArg_ParseTuple(args, "OO", &key, &value))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected the 'key' (any) and 'value' (any) arguments.");
+        return NULL;
+    }
+
+    if (enter_memory(self) == -1) return NULL;
+
+    int result = set_basic_item(&(self->handle), PyUnicode_AsUTF8(self->name), key, value);
+    leave_memory(self);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+static PyObject *Memory_trim(MemoryObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (enter_memory(self) == -1) return NULL;
+
+    int result = trim_basic_handle(&(self->handle), PyUnicode_AsUTF8(self->name));
+    leave_memory(self);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+static PyObject *Memory_wait_for_change(MemoryObject *self, PyObject *args, PyObject *kwargs)
+{
+    unsigned long last_version = 0;
+    PyObject *timeout_obj = Py_None;
+
+    static char* kwlist[] = {"last_version", "timeout", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|kO", kwlist, &last_version, &timeout_obj))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected optionally the 'last_version' (int) and 'timeout' (float) arguments.");
+        return NULL;
+    }
+
+    double timeout;
+    if (parse_timeout(timeout_obj, &timeout) == -1 || enter_memory(self) == -1) return NULL;
+
+    PyObject *version = wait_basic_change(&(self->handle), (uint32_t)last_version, timeout);
+    leave_memory(self);
+
+    return version;
+}
+
+static PyObject *Memory_close(MemoryObject *self, PyObject *Py_UNUSED(ignored))
+{
+    // Leave the mapping to the last user if other threads are still using it
+    if (self->users > 0) self->closing = 1;
+    else close_basic_handle(&(self->handle));
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Memory_methods[] = {
+    {"read", (PyCFunction)Memory_read, METH_NOARGS, "Get the value stored in the shared memory."},
+    {"view", (PyCFunction)Memory_view, METH_NOARGS, "Get a lazy view of the value stored in the shared memory."},
+    {"write", (PyCFunction)Memory_write, METH_VARARGS | METH_KEYWORDS, "Write a value to the shared memory."},
+    {"get_item", (PyCFunction)Memory_get_item, METH_O, "Get one item of the SFS value in the shared memory."},
+    {"set_item", (PyCFunction)Memory_set_item, METH_VARARGS, "Set one item of the SFS value in the shared memory."},
+    {"trim", (PyCFunction)Memory_trim, METH_NOARGS, "Shrink the shared memory down to the size of the value currently written."},
+    {"wait_for_change", (PyCFunction)Memory_wait_for_change, METH_VARARGS | METH_KEYWORDS, "Wait until the shared memory is written to."},
+    {"close", (PyCFunction)Memory_close, METH_NOARGS, "Unmap the shared memory and close the handle."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMemberDef Memory_members[] = {
+    {"name", T_OBJECT, offsetof(MemoryObject, name), READONLY, "The name of the shared memory."},
+
+    {NULL, 0, 0, 0, NULL}
+};
+
+static PyTypeObject MemoryType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "membridge.Memory",
+    .tp_doc = "A handle that keeps a shared memory segment mapped between reads and writes.",
+    .tp_basicsize = sizeof(MemoryObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Memory_new,
+    .tp_init = (initproc)Memory_init,
+    .tp_dealloc = (destructor)Memory_dealloc,
+    .tp_methods = Memory_methods,
+    .tp_members = Memory_members,
+};
+
+// # Shared functions
+
+/*
+  A shared function has a ring of request slots, so that multiple callers
+  can have calls in flight at once. A caller claims a free slot, writes its
+  args to it and marks it as a request. The function drains all requests
+  it finds on every wakeup, and writes the returned value to the same slot.
+  The caller waits on the state of its own slot, reads the returned value,
+  and releases the slot again.
+
+*/
+
+#define SPILL_NAME_SIZE 64 // The max size of the name of a spill-over segment
+#define FUNCTION_SLOTS  16 // The number of calls that can be in flight at once
+#define FUNCTION_ARGS 1024 // The static size that holds the args inline, per slot
+#define FUNCTION_POLL  100 // The time in ms after which callers check whether the function is still running
+#define FUNCTION_BUCKETS 24 // The number of buckets of the latency histogram, the last one holds everything slower
+
+// The states of a slot
+#define SLOT_FREE     0 // Not in use
+#define SLOT_CLAIMED  1 // Claimed by a caller writing its args
+#define SLOT_REQUEST  2 // Holds args, waiting for the function
+#define SLOT_BUSY     3 // The function is handling the call
+#define SLOT_RESPONSE 4 // Holds the returned value, waiting for the caller
+
+/*
+  Waiters can spin for a while before going to sleep on a futex, which
+  saves the context switches if the other side responds quickly. As a
+  futex wake is a syscall even without any waiters, waiters flag that
+  they're sleeping, and the other side only wakes them if they are.
+
+*/
+
+typedef struct {
+    uint32_t state; // The state of the slot, also used as the futex the caller waits on
+    uint32_t caller_sleeping; // Set while the caller sleeps on the state
+    uint32_t batch; // Set if the message holds a list of args tuples, to call the function with one after another
+    size_t size; // The size of the message written, 0 for a NULL message
+    char spill[SPILL_NAME_SIZE]; // The name of the spill-over segment holding the message, empty if it's inline
+    unsigned char args[FUNCTION_ARGS];
+} FunctionSlot;
+
+typedef struct {
+    uint32_t activity; // Set to 0 to stop the function
+    uint32_t pending;  // Incremented for every request, the futex the function waits on
+    uint32_t tail;     // Incremented for every claim, to spread the callers over the slots
+    uint32_t released; // Incremented for every released slot, the futex callers wait on if all slots are in use
+    uint32_t slot_waiters; // The number of callers waiting on a slot to be released
+    uint32_t server_sleeping; // The number of workers sleeping on the request count
+    pid_t pid; // The process that runs the function
+
+    // Latency counters, updated by the callers
+    uint64_t calls;    // The number of calls that got a response
+    uint64_t spun;     // The number of calls that got their response while spinning
+    uint64_t slept;    // The number of calls that slept on a futex for their response
+    uint64_t total_ns; // The total round trip time of all calls
+    uint64_t max_ns;   // The longest round trip time of a call
+    uint64_t server_sleeps; // The number of times a worker went to sleep waiting for requests
+
+    // Stats counters, only updated by the callers that enabled the stats
+    uint64_t slot_waits;   // The number of calls that found all slots in use
+    uint64_t slot_wait_ns; // The total time calls waited for a slot
+    uint64_t histogram[FUNCTION_BUCKETS]; // Bucket i counts the calls with a round trip time under 2^i microseconds
+
+    FunctionSlot slots[FUNCTION_SLOTS];
+} FunctionShm;
+
+#define FUNCTION_SIZE sizeof(FunctionShm)
+
+/*
+  Messages (the args and the returned value) are written inline if they
+  fit in FUNCTION_ARGS bytes. Larger messages spill over to a separate
+  segment, created by the writer of the message and named in the slot.
+  The reader of the message unlinks that segment once it has mapped it.
+
+  Messages can also hold out-of-band buffers (see from_value_oob), which
+  are mapped by the reader as well. As a message is only read once, the
+  reader releases their segment right after decoding it, and the caller
+  releases the segment of its args once the call is done, in case the
+  function never got to read them.
+
+*/
+
+// Helper function to write a NULL message to a slot
+static inline void null_function(FunctionSlot *slot)
+{
+    // A NULL message is a message without size
+    slot->size = 0;
+    slot->spill[0] = 0;
+}
+
+// Struct that the target of a message gets as its context
+typedef struct {
+    FunctionSlot *slot;
+    int fd; // The fd of the spill-over segment, -1 while the message is still inline
+} MessageContext;
+
+// Grow function for messages, which moves them to a spill-over segment once they don't fit inline
+static int grow_message_target(SBSTarget *target, size_t size)
+{
+    MessageContext *context = (MessageContext *)target->context;
+
+    // Grow at least twice the size, as every resize means a syscall and a remap
+    if (size < target->size * 2) size = target->size * 2;
+
+    if (context->fd == -1)
+    {
+        // Create a spill-over segment with a name unique to this process
+        static uint64_t spill_count = 0;
+        snprintf(context->slot->spill, SPILL_NAME_SIZE, "/membridge-spill-%d-%lu", (int)getpid(), (unsigned long)__atomic_fetch_add(&spill_count, 1, __ATOMIC_RELAXED));
+
+        int fd = shm_open(context->slot->spill, O_CREAT | O_EXCL | O_RDWR, 0666);
+        if (fd == -1)
+        {
+            context->slot->spill[0] = 0;
+            PyErr_SetString(PyExc_MemoryError, "Failed to create a spill-over segment for a message.");
+            return -1;
+        }
+
+        unsigned char *mapping;
+        if (ftruncate(fd, size) == -1 || (mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        {
+            close(fd);
+            shm_unlink(context->slot->spill);
+            context->slot->spill[0] = 0;
+            PyErr_SetString(PyExc_MemoryError, "Failed to allocate a spill-over segment for a message.");
+            return -1;
+        }
+
+        // Move over what we've written inline so far
+        memcpy(mapping, target->bytes, target->size);
+
+        context->fd = fd;
+        target->bytes = mapping;
+        target->size = size;
+        return 0;
+    }
+
+    // Grow the spill-over segment we already have
+    void *mapping;
+    if (ftruncate(context->fd, size) == -1 || (mapping = mremap(target->bytes, target->size, size, MREMAP_MAYMOVE)) == MAP_FAILED)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to grow the spill-over segment of a message.");
+        return -1;
+    }
+
+    target->bytes = (unsigned char *)mapping;
+    target->size = size;
+    return 0;
+}
+
+// Write a frame with out-of-band buffers to a target. Returns the size written, or -1 on failure
+static inline Py_ssize_t write_oob_message(SBSTarget *target, PyObject *value, size_t oob_threshold, PyObject **frame)
+{
+    // The frame starts with the name of the segment, so it has to be serialized before we copy it in
+    PyObject *bytes = from_value_oob(value, 0, 0, 1, oob_threshold);
+    if (bytes == NULL) return -1;
+
+    size_t size = (size_t)PyBytes_GET_SIZE(bytes);
+    if (size > target->size && target->grow(target, size) == -1)
+    {
+        release_oob_frame((const unsigned char *)PyBytes_AS_STRING(bytes), size);
+        Py_DECREF(bytes);
+        return -1;
+    }
+
+    memcpy(target->bytes, PyBytes_AS_STRING(bytes), size);
+
+    // Hand the frame to the caller if it wants to release the buffers itself
+    if (frame != NULL) *frame = bytes;
+    else Py_DECREF(bytes);
+
+    return (Py_ssize_t)size;
+}
+
+// Write a value as message to a slot, with buffers of at least `oob_threshold` bytes out-of-band if it's not 0. Sets the frame if `frame` isn't NULL and one was written. Returns -1 on failure
+static inline int write_function_message(FunctionSlot *slot, PyObject *value, size_t oob_threshold, PyObject **frame)
+{
+    slot->spill[0] = 0;
+
+    // Start writing inline, the grow function moves it to a spill-over segment if necessary
+    MessageContext context = {slot, -1};
+    SBSTarget target = {slot->args, FUNCTION_ARGS, grow_message_target, &context};
+
+    Py_ssize_t size = oob_threshold == 0 ? from_value_into(value, &target, 0) : write_oob_message(&target, value, oob_threshold, frame);
+
+    // Unmap the spill-over segment, the reader unlinks it
+    if (context.fd != -1)
+    {
+        munmap(target.bytes, target.size);
+        close(context.fd);
+
+        if (size == -1) shm_unlink(slot->spill);
+    }
+
+    if (size == -1)
+    {
+        null_function(slot);
+        return -1;
+    }
+
+    slot->size = (size_t)size;
+    return 0;
+}
+
+// Read the message from a slot as a value
+static inline PyObject *read_function_message(FunctionSlot *slot)
+{
+    // Check whether the message is inline
+    if (slot->spill[0] == 0)
+    {
+        PyObject *value = to_value_buf_oob(slot->args, slot->size);
+        if (release_oob_frame(slot->args, slot->size) == -1 && value != NULL) PyErr_Clear();
+
+        return value;
+    }
+
+    int fd = shm_open(slot->spill, O_RDONLY, 0666);
+    if (fd == -1)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to open the spill-over segment of a message.");
+        return NULL;
+    }
+
+    // Unlink it right away, the mapping stays valid until we unmap it
+    void *mapping = mmap(NULL, slot->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    shm_unlink(slot->spill);
+    slot->spill[0] = 0;
+
+    if (mapping == MAP_FAILED)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to map the spill-over segment of a message.");
+        return NULL;
+    }
+
+    PyObject *value = to_value_buf_oob((const unsigned char *)mapping, slot->size);
+    if (release_oob_frame((const unsigned char *)mapping, slot->size) == -1 && value != NULL) PyErr_Clear();
+    munmap(mapping, slot->size);
+
+    return value;
+}
+
+// Helper function to hand a slot back to its caller
+static inline void complete_function_slot(FunctionSlot *slot)
+{
+    __atomic_store_n(&(slot->state), SLOT_RESPONSE, __ATOMIC_SEQ_CST);
+
+    // Only wake the caller if it went to sleep
+    if (__atomic_load_n(&(slot->caller_sleeping), __ATOMIC_SEQ_CST))
+        futex_wake(&(slot->state), 1);
+}
+
+// Call the function with every args tuple in a list. Returns the list of returned values, or NULL on error
+static inline PyObject *call_function_batch(PyObject *func, PyObject *batch)
+{
+    if (!PyList_Check(batch))
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Received a batch that's not a list from the caller.");
+        return NULL;
+    }
+
+    Py_ssize_t count = PyList_GET_SIZE(batch);
+    PyObject *returned = PyList_New(count);
+    if (returned == NULL) return NULL;
+
+    // Run the calls back to back, failing the whole batch if one of them fails
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        PyObject *args = PyList_GET_ITEM(batch, i);
+        PyObject *value = PyTuple_Check(args) ? PyObject_CallObject(func, args) : NULL;
+
+        if (value == NULL)
+        {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_RuntimeError, "Received a batch with args that aren't a tuple from the caller.");
+            Py_DECREF(returned);
+            return NULL;
+        }
+
+        PyList_SET_ITEM(returned, i, value);
+    }
+
+    return returned;
+}
+
+// Handle the call in a slot. Returns -1 if the call raised an error
+static inline int handle_function_call(FunctionSlot *slot, PyObject *func, size_t oob_threshold)
+{
+    // Check whether we got a NULL message
+    if (slot->size == 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Received a NULL message from the caller.");
+        complete_function_slot(slot);
+        return -1;
+    }
+
+    // Convert the args to a Python value, only decoding the bytes that were written
+    PyObject *py_args = read_function_message(slot);
+    if (py_args == NULL)
+    {
+        null_function(slot);
+        complete_function_slot(slot);
+        return -1; // Error already set
+    }
+
+    // This will hold the args to be returned
+    PyObject *returned_args = NULL; // NULL by default to return errors on non-success scenarios
+
+    // Check if the args is a batch of calls, or a tuple for a single call
+    if (slot->batch || PyTuple_Check(py_args))
+    {
+        // Set the return args to the functions we receive from the function to call
+        returned_args = slot->batch ? call_function_batch(func, py_args) : PyObject_CallObject(func, py_args);
+        if (returned_args == NULL)
+        {
+            Py_DECREF(py_args);
+            null_function(slot);
+            complete_function_slot(slot);
+            return -1; // Error set by the function
+        }
+    }
+    Py_DECREF(py_args);
+
+    // Write the returned args as the message, this sets a NULL message on failure
+    int result = write_function_message(slot, returned_args, oob_threshold, NULL);
+    Py_XDECREF(returned_args);
+
+    complete_function_slot(slot);
+    return result;
+}
+
+/*
+  The function is served by one or more workers, which all run the same
+  loop. Workers claim requests with a CAS, so they never handle the same
+  call twice. They don't hold the GIL while waiting for requests, and only
+  take it to handle a call. A foreground server runs a single worker on
+  the calling thread, background servers run theirs on native threads and
+  return right away.
+
+*/
+
+typedef struct FunctionServer {
+    FunctionShm *shm;
+    PyObject *func;
+    char *name;
+    int background; // Whether errors raised by the function should be reported instead of stopping the server
+    uint32_t workers; // The number of workers still running
+    int spin; // The number of checks for new requests before a worker sleeps
+    size_t oob_threshold; // The min size of the buffers of the returned values to write out-of-band, or 0 to write them inline
+    struct FunctionServer *next;
+} FunctionServer;
+
+// The background servers that are still running, only accessed while holding the GIL
+static FunctionServer *background_servers = NULL;
+
+// Create and map the shared memory for a shared function
+static inline FunctionShm *open_function_shm(const char *name)
+{
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd == -1)
+    {
+        if (errno == EEXIST)
+            PyErr_Format(PyExc_MemoryError, "The memory address '%s' already exists.", name);
+        else
+            PyErr_Format(PyExc_MemoryError, "Failed to create memory address '%s'.", name);
+        
+        return NULL;
+    }
+
+    // The segment is zero-filled, which leaves all slots free
+    if (ftruncate(fd, FUNCTION_SIZE) == -1)
+    {
+        close(fd);
+        shm_unlink(name);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate for shared memory address '%s'.", name);
+        return NULL;
+    }
+
+    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+    {
+        shm_unlink(name);
+        PyErr_Format(PyExc_MemoryError, "Failed to map shared memory address '%s'.", name);
+        return NULL;
+    }
+
+    // Set the activity to 1 to indicate activity
+    shm->pid = getpid();
+    __atomic_store_n(&(shm->activity), 1, __ATOMIC_RELEASE);
+
+    return shm;
+}
+
+// Stop accepting calls, fail the requests that are still waiting, and unlink the shared memory
+static inline void close_function_shm(const char *name, FunctionShm *shm)
+{
+    __atomic_store_n(&(shm->activity), 0, __ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < FUNCTION_SLOTS; i++)
+    {
+        FunctionSlot *slot = &(shm->slots[i]);
+
+        uint32_t expected = SLOT_REQUEST;
+        if (__atomic_compare_exchange_n(&(slot->state), &expected, SLOT_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            // The args are never read, so clean up their spill-over segment
+            if (slot->spill[0] != 0) shm_unlink(slot->spill);
+            null_function(slot);
+            complete_function_slot(slot);
+        }
+    }
+
+    // Unmap and unlink the shared memory
+    munmap(shm, FUNCTION_SIZE);
+    shm_unlink(name);
+}
+
+// Helper function to stop all workers of a server
+static inline void stop_function_server(FunctionShm *shm)
+{
+    __atomic_store_n(&(shm->activity), 0, __ATOMIC_RELEASE);
+
+    __atomic_fetch_add(&(shm->pending), 1, __ATOMIC_SEQ_CST);
+    futex_wake(&(shm->pending), INT_MAX);
+}
+
+// The loop of a worker, called without holding the GIL. Returns -1 if the function raised an error that stopped the server
+static int serve_function(FunctionServer *server)
+{
+    FunctionShm *shm = server->shm;
+
+    // Start scanning at a different slot every round, so that every slot gets its turn first
+    uint32_t cursor = 0;
+
+    // Set a while loop to repeatedly drain all requests
+    while (1)
+    {
+        // Get the request count before scanning, so that we can't miss requests posted during the scan
+        uint32_t pending = __atomic_load_n(&(shm->pending), __ATOMIC_ACQUIRE);
+
+        // Check if the activity is set to inactive (0)
+        if (__atomic_load_n(&(shm->activity), __ATOMIC_ACQUIRE) == 0) return 0;
+
+        // Handle all requests in the ring as one batch
+        int handled = 0;
+        for (uint32_t i = 0; i < FUNCTION_SLOTS; i++)
+        {
+            FunctionSlot *slot = &(shm->slots[(cursor + i) % FUNCTION_SLOTS]);
+
+            uint32_t expected = SLOT_REQUEST;
+            if (!__atomic_compare_exchange_n(&(slot->state), &expected, SLOT_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                continue;
+
+            handled++;
+
+            // Only hold the GIL while handling the call
+            PyGILState_STATE gil = PyGILState_Ensure();
+            int result = handle_function_call(slot, server->func, server->oob_threshold);
+
+            if (result == -1 && server->background)
+            {
+                // There's no one to raise the error to, so report it and keep serving
+                PyErr_WriteUnraisable(server->func);
+                result = 0;
+            }
+            PyGILState_Release(gil);
+
+            if (result == -1)
+            {
+                // Stop the other workers as well
+                stop_function_server(shm);
+                return -1; // Error stays set for the thread that created the server
+            }
+        }
+        cursor++;
+
+        // Wait for new requests if there weren't any, spinning first if we're allowed to
+        if (handled == 0 && !spin_wait(&(shm->pending), pending, server->spin))
+        {
+            __atomic_fetch_add(&(shm->server_sleeping), 1, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&(shm->server_sleeps), 1, __ATOMIC_RELAXED);
+            futex_wait(&(shm->pending), pending, -1);
+            __atomic_fetch_sub(&(shm->server_sleeping), 1, __ATOMIC_SEQ_CST);
+        }
+    }
+}
+
+// The entry point of background workers, the last one to stop cleans up the server
+static void *run_function_worker(void *arg)
+{
+    FunctionServer *server = (FunctionServer *)arg;
+
+    serve_function(server);
+
+    if (__atomic_sub_fetch(&(server->workers), 1, __ATOMIC_ACQ_REL) != 0)
+        return NULL;
+
+    close_function_shm(server->name, server->shm);
+
+    // Unlink the server from the running servers
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    FunctionServer **link = &background_servers;
+    while (*link != server) link = &((*link)->next);
+    *link = server->next;
+
+    Py_DECREF(server->func);
+    PyGILState_Release(gil);
+
+    free(server->name);
+    free(server);
+
+    return NULL;
+}
+
+// Initiate a shared memory for a shared function, and serve it until it's removed
+static inline PyObject *create_shared_function(const char *name, PyObject *func, int spin, size_t oob_threshold)
+{
+    FunctionShm *shm = open_function_shm(name);
+    if (shm == NULL) return NULL; // Error already set
+
+    FunctionServer server = {shm, func, (char *)name, 0, 1, spin_budget(spin), oob_threshold, NULL};
+
+    // Serve the function without holding the GIL while waiting for calls
+    int exit_status;
+    Py_BEGIN_ALLOW_THREADS
+    exit_status = serve_function(&server);
+    close_function_shm(name, shm);
+    Py_END_ALLOW_THREADS
+
+    // Return None on success, NULL on error to throw it
+    if (exit_status == -1) return NULL;
+    Py_RETURN_NONE;
+}
+
+// Initiate a shared memory for a shared function, served by worker threads in the background
+static inline PyObject *create_background_function(const char *name, PyObject *func, int workers, int spin, size_t oob_threshold)
+{
+    FunctionServer *server = malloc(sizeof(FunctionServer));
+    char *server_name = strdup(name);
+
+    if (server == NULL || server_name == NULL)
+    {
+        free(server);
+        free(server_name);
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate for the shared function.");
+        return NULL;
+    }
+
+    FunctionShm *shm = open_function_shm(name);
+    if (shm == NULL)
+    {
+        free(server);
+        free(server_name);
+        return NULL; // Error already set
+    }
+
+    Py_INCREF(func);
+    *server = (FunctionServer){shm, func, server_name, 1, (uint32_t)workers, spin_budget(spin), oob_threshold, background_servers};
+    background_servers = server;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (int i = 0; i < workers; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, run_function_worker, server) == 0)
+            continue;
+
+        // Stop the workers that did start, the last one cleans up. Without any, clean up ourselves
+        uint32_t missing = (uint32_t)(workers - i);
+        stop_function_server(shm);
+
+        if (__atomic_sub_fetch(&(server->workers), missing, __ATOMIC_ACQ_REL) == 0)
+        {
+            close_function_shm(server_name, shm);
+            background_servers = server->next;
+            Py_DECREF(func);
+            free(server_name);
+            free(server);
+        }
+
+        pthread_attr_destroy(&attr);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to start the workers of the shared function.");
+        return NULL;
+    }
+
+    pthread_attr_destroy(&attr);
+    Py_RETURN_NONE;
+}
+
+// Stop all background servers and wait for them to clean up, registered to run at exit
+static PyObject *stop_background_functions(PyObject *self, PyObject *args)
+{
+    for (FunctionServer *server = background_servers; server != NULL; server = server->next)
+        stop_function_server(server->shm);
+
+    // The workers need the GIL to unlink themselves
+    while (background_servers != NULL)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        sched_yield();
+        Py_END_ALLOW_THREADS
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Forget the background servers in a forked child, as their workers only run in the parent
+static void forget_background_functions(void)
+{
+    background_servers = NULL;
+}
+
+PyObject *create_function(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
     PyObject *func;
+    PyObject *background = Py_False;
+    int workers = 1;
+    int spin = 0;
+    Py_ssize_t oob_threshold = 0;
+
+    static char* kwlist[] = {"name", "function", "background", "workers", "spin", "oob_threshold", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|O!iin", kwlist, &name, &func, &PyBool_Type, &background, &workers, &spin, &oob_threshold))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'callable' type.");
+        return NULL;
+    }
+
+    if (!PyCallable_Check(func))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'callable' type.");
+        return NULL;
+    }
+
+    if (workers < 1 || (workers > 1 && background != Py_True))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least 1 worker, and only 1 unless running in the background.");
+        return NULL;
+    }
+
+    if (spin < 0 || oob_threshold < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a spin budget and out-of-band threshold of at least 0.");
+        return NULL;
+    }
+
+    // Start the background workers and return right away
+    if (background == Py_True)
+        return create_background_function(name, func, workers, spin, (size_t)oob_threshold);
+
+    // Call the function to create and link the shared function
+    Py_INCREF(func);
+    PyObject *return_value = create_shared_function(name, func, spin, (size_t)oob_threshold);
+    Py_DECREF(func);
+
+    return return_value;
+}
+
+// Helper function to check whether the function of a shared memory is still running
+static inline int function_running(FunctionShm *shm)
+{
+    if (__atomic_load_n(&(shm->activity), __ATOMIC_ACQUIRE) == 0) return 0;
+
+    // Check whether the process of the function didn't die without cleaning up
+    return !(kill(shm->pid, 0) == -1 && errno == ESRCH);
+}
+
+// Claim a free slot for a call. Returns NULL if the function stopped running
+static inline FunctionSlot *claim_function_slot(FunctionShm *shm)
+{
+    // Spread the callers over the ring by starting at a different slot each claim
+    uint32_t start = __atomic_fetch_add(&(shm->tail), 1, __ATOMIC_RELAXED);
+    uint64_t wait_start = 0; // Set once we have to wait, if the stats are enabled
+
+    while (1)
+    {
+        // Get the release count before scanning, so that we can't miss slots released during the scan
+        uint32_t released = __atomic_load_n(&(shm->released), __ATOMIC_ACQUIRE);
+
+        for (uint32_t i = 0; i < FUNCTION_SLOTS; i++)
+        {
+            FunctionSlot *slot = &(shm->slots[(start + i) % FUNCTION_SLOTS]);
+
+            uint32_t expected = SLOT_FREE;
+            if (__atomic_compare_exchange_n(&(slot->state), &expected, SLOT_CLAIMED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                slot->caller_sleeping = 0;
+                if (wait_start != 0)
+                {
+                    __atomic_fetch_add(&(shm->slot_waits), 1, __ATOMIC_RELAXED);
+                    __atomic_fetch_add(&(shm->slot_wait_ns), monotonic_ns() - wait_start, __ATOMIC_RELAXED);
+                }
+                return slot;
+            }
+        }
+
+        if (!function_running(shm)) return NULL;
+        if (wait_start == 0 && __atomic_load_n(&stats_enabled, __ATOMIC_RELAXED)) wait_start = monotonic_ns();
+
+        // All slots are in use, so wait for one to be released
+        __atomic_fetch_add(&(shm->slot_waiters), 1, __ATOMIC_SEQ_CST);
+        futex_wait(&(shm->released), released, FUNCTION_POLL);
+        __atomic_fetch_sub(&(shm->slot_waiters), 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+// Hand a slot in to the function as a request
+static inline void post_function_slot(FunctionShm *shm, FunctionSlot *slot)
+{
+    __atomic_store_n(&(slot->state), SLOT_REQUEST, __ATOMIC_RELEASE);
+
+    // Only wake a worker if none of them is awake to see the request
+    __atomic_fetch_add(&(shm->pending), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(shm->server_sleeping), __ATOMIC_SEQ_CST) > 0)
+        futex_wake(&(shm->pending), 1);
+}
+
+// Wait for the function to respond in a slot, spinning up to `spin` checks first. Returns -1 if the function stopped before responding
+static inline int wait_function_slot(FunctionShm *shm, FunctionSlot *slot, int spin)
+{
+    // Spin until we get the response or run out of budget
+    for (int i = 0; i < spin; i++)
+    {
+        if (__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) == SLOT_RESPONSE)
+        {
+            __atomic_fetch_add(&(shm->spun), 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+
+        cpu_relax();
+    }
+
+    __atomic_fetch_add(&(shm->slept), 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&(slot->caller_sleeping), 1, __ATOMIC_SEQ_CST);
+
+    while (1)
+    {
+        uint32_t state = __atomic_load_n(&(slot->state), __ATOMIC_SEQ_CST);
+        if (state == SLOT_RESPONSE) return 0;
+
+        // Check whether the function is still running every once in a while
+        if (futex_wait(&(slot->state), state, FUNCTION_POLL) == -1 && !function_running(shm))
+        {
+            // Take the request back if the function never picked it up
+            uint32_t expected = SLOT_REQUEST;
+            if (__atomic_compare_exchange_n(&(slot->state), &expected, SLOT_CLAIMED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return -1;
+
+            // The function is still handling our call if its process is alive, so keep waiting
+            if (kill(shm->pid, 0) == -1 && errno == ESRCH)
+                return -1;
+        }
+    }
+}
+
+// Helper function to add the round trip time of a call to the latency counters
+static inline void record_function_call(FunctionShm *shm, uint64_t elapsed)
+{
+    __atomic_fetch_add(&(shm->calls), 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(shm->total_ns), elapsed, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&(shm->max_ns), __ATOMIC_RELAXED);
+    while (elapsed > max && !__atomic_compare_exchange_n(&(shm->max_ns), &max, elapsed, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (!__atomic_load_n(&stats_enabled, __ATOMIC_RELAXED)) return;
+
+    // The bucket is the number of bits of the time in microseconds, so bucket i holds the times under 2^i
+    uint64_t micros = elapsed / 1000;
+    int bucket = micros == 0 ? 0 : 64 - __builtin_clzll(micros);
+    if (bucket >= FUNCTION_BUCKETS) bucket = FUNCTION_BUCKETS - 1;
+
+    __atomic_fetch_add(&(shm->histogram[bucket]), 1, __ATOMIC_RELAXED);
+}
+
+// Release a slot so that other callers can claim it
+static inline void release_function_slot(FunctionShm *shm, FunctionSlot *slot)
+{
+    __atomic_store_n(&(slot->state), SLOT_FREE, __ATOMIC_RELEASE);
+
+    // Only wake the callers waiting for a slot if there are any
+    __atomic_fetch_add(&(shm->released), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(shm->slot_waiters), __ATOMIC_SEQ_CST) > 0)
+        futex_wake(&(shm->released), INT_MAX);
+}
+
+// Call a function linked to a shared memory ring
+PyObject *call_shared_function(const char *name, PyObject *args, int spin, int batch, size_t oob_threshold)
+{
+    int fd = shm_open(name, O_RDWR, 0666);
+    if (fd == -1)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to open the shared memory.");
+        return NULL;
+    }
+
+    // Get the shared memory
+    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to map the shared memory.");
+        return NULL;
+    }
+
+    // Claim a slot, without holding the GIL as we might have to wait for one
+    FunctionSlot *slot;
+    Py_BEGIN_ALLOW_THREADS
+    slot = claim_function_slot(shm);
+    Py_END_ALLOW_THREADS
+
+    if (slot == NULL)
+    {
+        munmap(shm, FUNCTION_SIZE);
+        PyErr_SetString(PyExc_RuntimeError, "The shared function is no longer running.");
+        return NULL;
+    }
+
+    // Write the args as the message, spilling over if they don't fit inline
+    PyObject *frame = NULL;
+    slot->batch = (uint32_t)batch;
+    if (write_function_message(slot, args, oob_threshold, &frame) == -1)
+    {
+        release_function_slot(shm, slot);
+        munmap(shm, FUNCTION_SIZE);
+        return NULL; // Error already set
+    }
+
+    // Hand the call to the function and wait for the returned value
+    int result;
+    uint64_t start = monotonic_ns();
+    post_function_slot(shm, slot);
+    Py_BEGIN_ALLOW_THREADS
+    result = wait_function_slot(shm, slot, spin);
+    Py_END_ALLOW_THREADS
+
+    if (result == 0) record_function_call(shm, monotonic_ns() - start);
+
+    PyObject *returned_value = NULL;
+    if (result == -1)
+    {
+        // Clean up the spill-over segment of our args, as they were never read
+        if (slot->spill[0] != 0) shm_unlink(slot->spill);
+        PyErr_SetString(PyExc_RuntimeError, "The shared function stopped running before handling the call.");
+    }
+    else if (slot->size == 0)
+        PyErr_SetString(PyExc_RuntimeError, "Received a NULL message from the function. This is likely because the function raised an error or returned an unsupported value.");
+    else
+        // Convert the returned message to the Python value we should return
+        returned_value = read_function_message(slot);
+
+    // Release the slot and unmap the shared memory as we no longer need it
+    release_function_slot(shm, slot);
+    munmap(shm, FUNCTION_SIZE);
+
+    // The function released the buffers of our args once it read them, but it might've stopped before that
+    if (frame != NULL)
+    {
+        if (release_oob_frame((const unsigned char *)PyBytes_AS_STRING(frame), (size_t)PyBytes_GET_SIZE(frame)) == -1 && returned_value != NULL) PyErr_Clear();
+        Py_DECREF(frame);
+    }
+
+    return returned_value;
+}
+
+PyObject *call_function(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    PyObject *py_args;
+    int spin = 0;
+    Py_ssize_t oob_threshold = 0;
+
+    static char* kwlist[] = {"name", "args", "spin", "oob_threshold", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO!|in", kwlist, &name, &PyTuple_Type, &py_args, &spin, &oob_threshold))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'tuple' type.");
+        return NULL;
+    }
+
+    if (spin < 0 || oob_threshold < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a spin budget and out-of-band threshold of at least 0.");
+        return NULL;
+    }
+
+    // Call the shared function and get the returned value
+    Py_INCREF(py_args);
+    PyObject *return_value = call_shared_function(name, py_args, spin_budget(spin), 0, (size_t)oob_threshold);
+    Py_DECREF(py_args);
+
+    // Return the returned value to the user
+    return return_value;
+}
+
+PyObject *call_function_many(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    PyObject *batch;
+    int spin = 0;
+    Py_ssize_t oob_threshold = 0;
+
+    static char* kwlist[] = {"name", "batch", "spin", "oob_threshold", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO!|in", kwlist, &name, &PyList_Type, &batch, &spin, &oob_threshold))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'list' type.");
+        return NULL;
+    }
+
+    if (spin < 0 || oob_threshold < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a spin budget and out-of-band threshold of at least 0.");
+        return NULL;
+    }
+
+    Py_ssize_t count = PyList_GET_SIZE(batch);
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        if (!PyTuple_Check(PyList_GET_ITEM(batch, i)))
+        {
+            PyErr_SetString(PyExc_ValueError, "Expected a 'list' of only 'tuple' types.");
+            return NULL;
+        }
+    }
+
+    // Nothing to call, so don't bother the function
+    if (count == 0) return PyList_New(0);
+
+    // Send all args as one message, and get all returned values back as one
+    Py_INCREF(batch);
+    PyObject *return_value = call_shared_function(name, batch, spin_budget(spin), 1, (size_t)oob_threshold);
+    Py_DECREF(batch);
+
+    return return_value;
+}
+
+PyObject *function_stats(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    PyObject *reset = Py_False;
+
+    static char* kwlist[] = {"name", "reset", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O!", kwlist, &name, &PyBool_Type, &reset))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDWR, 0666);
+    if (fd == -1)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to open the shared memory.");
+        return NULL;
+    }
+
+    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+    {
+        PyErr_SetString(PyExc_MemoryError, "Failed to map the shared memory.");
+        return NULL;
+    }
+
+    // Swap the counters with 0 when resetting, so that no call gets lost in between
+    int swap = reset == Py_True;
+    uint64_t *counters[] = {&(shm->calls), &(shm->spun), &(shm->slept), &(shm->total_ns), &(shm->max_ns), &(shm->server_sleeps), &(shm->slot_waits), &(shm->slot_wait_ns)};
+    uint64_t values[8];
+    uint64_t histogram[FUNCTION_BUCKETS];
+
+    for (int i = 0; i < 8; i++)
+        values[i] = swap ? __atomic_exchange_n(counters[i], 0, __ATOMIC_RELAXED) : __atomic_load_n(counters[i], __ATOMIC_RELAXED);
+    for (int i = 0; i < FUNCTION_BUCKETS; i++)
+        histogram[i] = swap ? __atomic_exchange_n(&(shm->histogram[i]), 0, __ATOMIC_RELAXED) : __atomic_load_n(&(shm->histogram[i]), __ATOMIC_RELAXED);
+
+    munmap(shm, FUNCTION_SIZE);
+
+    PyObject *buckets = PyList_New(FUNCTION_BUCKETS);
+    if (buckets == NULL) return NULL;
+
+    for (int i = 0; i < FUNCTION_BUCKETS; i++)
+    {
+        PyObject *count = PyLong_FromUnsignedLongLong((unsigned long long)histogram[i]);
+        if (count == NULL)
+        {
+            Py_DECREF(buckets);
+            return NULL;
+        }
+        PyList_SET_ITEM(buckets, i, count);
+    }
+
+    return Py_BuildValue("{sKsKsKsKsKsKsKsKsN}",
+        "calls", (unsigned long long)values[0],
+        "spun", (unsigned long long)values[1],
+        "slept", (unsigned long long)values[2],
+        "total_ns", (unsigned long long)values[3],
+        "max_ns", (unsigned long long)values[4],
+        "server_sleeps", (unsigned long long)values[5],
+        "slot_waits", (unsigned long long)values[6],
+        "slot_wait_ns", (unsigned long long)values[7],
+        "histogram", buckets);
+}
+
+PyObject *enable_stats(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    int enabled = 1;
+
+    static char* kwlist[] = {"enabled", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", kwlist, &enabled))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected an optional 'enabled' (bool).");
+        return NULL;
+    }
+
+    __atomic_store_n(&stats_enabled, enabled, __ATOMIC_RELAXED);
+    Py_RETURN_NONE;
+}
+
+PyObject *remove_function(PyObject *self, PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDWR, 0666);
+    if (fd == -1) Py_RETURN_FALSE; // Return False to indicate we couldn't open the shm in the first place
+
+    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) Py_RETURN_FALSE;
+
+    // Set the activity to 0 to indicate inactive
+    __atomic_store_n(&(shm->activity), 0, __ATOMIC_RELEASE);
+
+    // Wake the function to have it read inactivity and shut down
+    __atomic_fetch_add(&(shm->pending), 1, __ATOMIC_SEQ_CST);
+    futex_wake(&(shm->pending), INT_MAX);
+
+    munmap(shm, FUNCTION_SIZE);
+    Py_RETURN_TRUE; // Return True to indicate success
+}
+
+// # Channels
+
+/*
+  A channel is a ring of messages in a single segment, written by one
+  producer at a time and read by any number of readers. Every message is
+  serialized once, and every reader reads it from the ring with its own
+  cursor, so readers don't take anything away from each other.
+
+  The ring is addressed by positions that only go up, and a position maps
+  to `position % capacity` in the ring. Every message is written as a
+  ChannelRecord followed by its bytes, and may be split over the end of
+  the ring. The head holds the position the next message is written at,
+  and the tail the position of the oldest message that's still there.
+
+  The producer never waits on the readers. When a new message doesn't
+  fit, it moves the tail past the oldest messages first, and only then
+  overwrites them. Readers that fell that far behind skip to the tail,
+  and count the messages they missed. Like the basic shared memory, the
+  readers never lock: they copy a message out, and then check whether the
+  tail moved past it in the meantime.
+
+  Readers that are waiting for a message sleep on a futex that's bumped
+  for every message, and the producer only wakes them if there are any.
+
+*/
+
+#define CHANNEL_MAGIC    0x4d424348 // Marks a segment as a channel
+#define CHANNEL_CAPACITY (1 << 20)  // The default capacity of the ring in bytes
+#define CHANNEL_POLL     100        // The max time in ms to sleep at once, so that signals are still handled
+
+typedef struct {
+    uint32_t magic; // Set to CHANNEL_MAGIC once the channel is initialized
+    uint32_t seq;   // Incremented for every message, the futex readers wait on
+    uint32_t waiters; // The number of readers sleeping on the sequence number
+    uint64_t capacity; // The size of the ring in bytes
+    uint64_t head;  // The position the next message is written at
+    uint64_t tail;  // The position of the oldest message in the ring
+    uint64_t count; // The number of messages written so far
+    pthread_mutex_t mutex; // Taken by the producer, so that producers in different processes can't interleave
+} ChannelShm;
+
+#define CHANNEL_SIZE sizeof(ChannelShm)
+
+typedef struct {
+    uint64_t size;  // The size of the message bytes after the record
+    uint64_t index; // The number of messages written before this one
+} ChannelRecord;
+
+// Copy bytes out of the ring starting at a position, wrapping around its end
+static inline void read_channel_ring(ChannelShm *shm, uint64_t position, void *bytes, size_t size)
+{
+    const unsigned char *ring = (const unsigned char *)shm + CHANNEL_SIZE;
+    size_t offset = (size_t)(position % shm->capacity);
+    size_t first = size < shm->capacity - offset ? size : shm->capacity - offset;
+
+    memcpy(bytes, &ring[offset], first);
+    memcpy((unsigned char *)bytes + first, ring, size - first);
+}
+
+// Copy bytes into the ring starting at a position, wrapping around its end
+static inline void write_channel_ring(ChannelShm *shm, uint64_t position, const void *bytes, size_t size)
+{
+    unsigned char *ring = (unsigned char *)shm + CHANNEL_SIZE;
+    size_t offset = (size_t)(position % shm->capacity);
+    size_t first = size < shm->capacity - offset ? size : shm->capacity - offset;
+
+    memcpy(&ring[offset], bytes, first);
+    memcpy(ring, (const unsigned char *)bytes + first, size - first);
+}
+
+// Create and initialize the segment of a channel. Returns 1 if it already exists
+static inline int create_channel_shm(const char *name, size_t capacity)
+{
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd == -1)
+    {
+        if (errno == EEXIST) return 1;
+
+        PyErr_Format(PyExc_MemoryError, "Failed to create shared memory address '%s'.", name);
+        return -1;
+    }
+
+    ChannelShm *shm;
+    if (ftruncate(fd, CHANNEL_SIZE + capacity) == -1 || (shm = mmap(NULL, CHANNEL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        shm_unlink(name);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate for shared memory address '%s'.", name);
+        return -1;
+    }
+    close(fd);
+
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0 ||
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 ||
+        pthread_mutex_init(&(shm->mutex), &attr) != 0)
+    {
+        munmap(shm, CHANNEL_SIZE);
+        shm_unlink(name);
+        PyErr_Format(PyExc_MemoryError, "Failed to initialize mutex for shared memory address '%s'.", name);
+        return -1;
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    // The segment is zero-filled, so only the capacity is left to set before marking it as initialized
+    shm->capacity = capacity;
+    __atomic_store_n(&(shm->magic), CHANNEL_MAGIC, __ATOMIC_RELEASE);
+
+    munmap(shm, CHANNEL_SIZE);
+    return 0;
+}
+
+// Open and map the segment of a channel, creating it if necessary. Returns NULL on failure
+static inline ChannelShm *open_channel_shm(const char *name, size_t capacity, PyObject *create, size_t *mapped_size)
+{
+    if ((create == NULL || Py_IsTrue(create)) && create_channel_shm(name, capacity) == -1) return NULL;
+
+    ChannelShm *shm = map_ready_shm(name, CHANNEL_MAGIC, CHANNEL_SIZE, mapped_size);
+    if (shm == NULL) return NULL;
+
+    if (CHANNEL_SIZE + shm->capacity > *mapped_size)
+    {
+        munmap(shm, *mapped_size);
+        PyErr_Format(PyExc_MemoryError, "The shared memory address '%s' is not a valid channel.", name);
+        return NULL;
+    }
+
+    return shm;
+}
+
+// Write a message to the ring, overwriting the oldest messages if it doesn't fit. Returns -1 if it's too large
+static inline int send_channel_message(ChannelShm *shm, const unsigned char *bytes, size_t size)
+{
+    if (size > shm->capacity - sizeof(ChannelRecord))
+    {
+        PyErr_SetString(PyExc_ValueError, "The message is larger than the capacity of the channel.");
+        return -1;
+    }
+
+    pthread_mutex_lock(&(shm->mutex));
+
+    uint64_t head = shm->head;
+    uint64_t tail = shm->tail;
+    uint64_t needed = sizeof(ChannelRecord) + size;
+
+    // Drop the oldest messages until the new one fits
+    while (head + needed - tail > shm->capacity)
+    {
+        ChannelRecord oldest;
+        read_channel_ring(shm, tail, &oldest, sizeof(ChannelRecord));
+        tail += sizeof(ChannelRecord) + oldest.size;
+    }
+
+    // Publish the new tail before overwriting anything, so that readers can tell their copy got overwritten
+    if (tail != shm->tail)
+    {
+        __atomic_store_n(&(shm->tail), tail, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    ChannelRecord record = {size, shm->count};
+    write_channel_ring(shm, head, &record, sizeof(ChannelRecord));
+    write_channel_ring(shm, head + sizeof(ChannelRecord), bytes, size);
+
+    shm->count++;
+    __atomic_store_n(&(shm->head), head + needed, __ATOMIC_RELEASE);
+
+    // Only wake the readers if any of them went to sleep
+    __atomic_fetch_add(&(shm->seq), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(shm->waiters), __ATOMIC_SEQ_CST) > 0)
+        futex_wake(&(shm->seq), INT_MAX);
+
+    pthread_mutex_unlock(&(shm->mutex));
+    return 0;
+}
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *name;
+    ChannelShm *shm;
+    size_t mapped_size;
+    uint64_t cursor;     // The position of the next message to read
+    uint64_t next_index; // The index of the next message to read, to count the ones we missed
+    unsigned long long dropped; // The number of messages that were overwritten before we read them
+    int users;   // The number of method calls using the mapping, only changed while holding the GIL (see enter_memory)
+    int closing; // Set if the channel was closed while in use, so that the last user unmaps it
+} ChannelObject;
+
+// Copy the next message out of the ring. Returns NULL without an error set if there's no message yet
+static inline PyObject *copy_channel_message(ChannelObject *self)
+{
+    ChannelShm *shm = self->shm;
+
+    while (1)
+    {
+        uint64_t head = __atomic_load_n(&(shm->head), __ATOMIC_ACQUIRE);
+        if (self->cursor == head) return NULL;
+
+        // Skip to the oldest message if the ones we didn't read yet were overwritten
+        uint64_t tail = __atomic_load_n(&(shm->tail), __ATOMIC_ACQUIRE);
+        if (self->cursor < tail || self->cursor > head) self->cursor = tail;
+
+        ChannelRecord record;
+        read_channel_ring(shm, self->cursor, &record, sizeof(ChannelRecord));
+
+        // A record that's being overwritten can hold anything, so only trust it once we've checked the tail
+        PyObject *buffer = NULL;
+        if (record.size <= shm->capacity - sizeof(ChannelRecord))
+        {
+            buffer = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)record.size);
+            if (buffer == NULL) return NULL;
+
+            read_channel_ring(shm, self->cursor + sizeof(ChannelRecord), PyBytes_AS_STRING(buffer), (size_t)record.size);
+        }
+
+        // Check whether the producer didn't overwrite the message while we were copying it
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&(shm->tail), __ATOMIC_RELAXED) > self->cursor || buffer == NULL)
+        {
+            Py_XDECREF(buffer);
+            continue;
+        }
+
+        if (record.index > self->next_index) self->dropped += record.index - self->next_index;
+        self->next_index = record.index + 1;
+        self->cursor += sizeof(ChannelRecord) + record.size;
+
+        return buffer;
+    }
+}
+
+static inline void close_channel(ChannelObject *self)
+{
+    if (self->shm == NULL) return;
+
+    munmap(self->shm, self->mapped_size);
+    self->shm = NULL;
+}
+
+// Start using the mapping if the channel is still open. Should be followed by leave_channel if it succeeds
+static inline int enter_channel(ChannelObject *self)
+{
+    if (self->shm == NULL || self->closing)
+    {
+        PyErr_SetString(PyExc_ValueError, "The channel is closed.");
+        return -1;
+    }
+
+    self->users++;
+    return 0;
+}
+
+static inline void leave_channel(ChannelObject *self)
+{
+    if (--self->users == 0 && self->closing)
+    {
+        close_channel(self);
+        self->closing = 0;
+    }
+}
+
+static int Channel_init(ChannelObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    Py_ssize_t capacity = CHANNEL_CAPACITY;
+    PyObject *create = NULL;
+
+    static char* kwlist[] = {"name", "capacity", "create", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|nO!", kwlist, &name, &capacity, &PyBool_Type, &create) || capacity <= (Py_ssize_t)sizeof(ChannelRecord))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument, and optionally a positive 'capacity' (int) and 'create' (bool).");
+        return -1;
+    }
+
+    if (self->users > 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "The channel is in use by another thread.");
+        return -1;
+    }
+
+    // Close the old channel in case init is called twice
+    close_channel(self);
+    self->closing = 0;
+    Py_CLEAR(self->name);
+
+    self->shm = open_channel_shm(name, (size_t)capacity, create, &(self->mapped_size));
+    if (self->shm == NULL) return -1;
+
+    self->name = PyUnicode_FromString(name);
+    if (self->name == NULL)
+    {
+        close_channel(self);
+        return -1;
+    }
+
+    // Only read the messages written from now on. Taking the lock gets a head and count that belong together
+    pthread_mutex_lock(&(self->shm->mutex));
+    self->cursor = self->shm->head;
+    self->next_index = self->shm->count;
+    pthread_mutex_unlock(&(self->shm->mutex));
+
+    self->dropped = 0;
+
+    return 0;
+}
+
+static void Channel_dealloc(ChannelObject *self)
+{
+    close_channel(self);
+    Py_XDECREF(self->name);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Channel_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    ChannelObject *self = (ChannelObject *)type->tp_alloc(type, 0);
+    if (self == NULL) return NULL;
+
+    // Mark the channel as closed until it's initialized
+    self->name = NULL;
+    self->shm = NULL;
+    self->users = 0;
+    self->closing = 0;
+
+    return (PyObject *)self;
+}
+
+static PyObject *Channel_send(ChannelObject *self, PyObject *value)
+{
+    if (enter_channel(self) == -1) return NULL;
+
+    // Serialize the message once, for all readers
+    PyObject *bytes = from_value(value);
+    int result = bytes == NULL ? -1 : send_channel_message(self->shm, (const unsigned char *)PyBytes_AS_STRING(bytes), (size_t)PyBytes_GET_SIZE(bytes));
+    Py_XDECREF(bytes);
+    leave_channel(self);
+
+    if (result == -1) return NULL;
+    Py_RETURN_TRUE;
+}
+
+// Read the next message, waiting for one until the timeout. Should only be called while using the channel (see enter_channel)
+static inline PyObject *recv_channel_message(ChannelObject *self, double timeout)
+{
+    ChannelShm *shm = self->shm;
+    uint64_t deadline = timeout < 0 ? 0 : monotonic_ns() + (uint64_t)(timeout * 1e9) + 1;
+
+    while (1)
+    {
+        // Get the sequence number before checking for a message, so that we can't miss the wakeup of the next one
+        uint32_t seq = __atomic_load_n(&(shm->seq), __ATOMIC_SEQ_CST);
+
+        PyObject *buffer = copy_channel_message(self);
+        if (buffer != NULL)
+        {
+            PyObject *value = to_value_buf((const unsigned char *)PyBytes_AS_STRING(buffer), (size_t)PyBytes_GET_SIZE(buffer));
+            Py_DECREF(buffer);
+            return value;
+        }
+        if (PyErr_Occurred()) return NULL;
+
+        // Sleep for the time that's left, in slices so that we can still handle signals
+        long wait_ms = wait_slice_ms(deadline, CHANNEL_POLL);
+        if (wait_ms == -1)
+        {
+            PyErr_SetString(PyExc_TimeoutError, "No message was received before the timeout.");
+            return NULL;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        __atomic_fetch_add(&(shm->waiters), 1, __ATOMIC_SEQ_CST);
+        futex_wait(&(shm->seq), seq, wait_ms);
+        __atomic_fetch_sub(&(shm->waiters), 1, __ATOMIC_SEQ_CST);
+        Py_END_ALLOW_THREADS
+
+        if (PyErr_CheckSignals() == -1) return NULL;
+
+        // Stop waiting once another thread closed the channel
+        if (self->closing)
+        {
+            PyErr_SetString(PyExc_ValueError, "The channel was closed while waiting for a message.");
+            return NULL;
+        }
+    }
+}
+
+static PyObject *Channel_recv(ChannelObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *timeout_obj = Py_None;
+
+    static char* kwlist[] = {"timeout", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &timeout_obj))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected optionally the 'timeout' (float) argument.");
+        return NULL;
+    }
+
+    double timeout;
+    if (parse_timeout(timeout_obj, &timeout) == -1 || enter_channel(self) == -1) return NULL;
+
+    // Other threads can close the channel while we wait without the GIL, which then leaves the mapping to us
+    PyObject *value = recv_channel_message(self, timeout);
+    leave_channel(self);
+
+    return value;
+}
+
+static PyObject *Channel_close(ChannelObject *self, PyObject *Py_UNUSED(ignored))
+{
+    // Leave the mapping to the last user if other threads are still using it
+    if (self->users > 0) self->closing = 1;
+    else close_channel(self);
 
-    if (!PyArg_ParseTuple(args, "sO", &name, &func))
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Channel_methods[] = {
+    {"send", (PyCFunction)Channel_send, METH_O, "Write a message to the channel for all readers."},
+    {"recv", (PyCFunction)Channel_recv, METH_VARARGS | METH_KEYWORDS, "Read the next message from the channel, waiting for one if necessary."},
+    {"close", (PyCFunction)Channel_close, METH_NOARGS, "Unmap the channel."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMemberDef Channel_members[] = {
+    {"name", T_OBJECT, offsetof(ChannelObject, name), READONLY, "The name of the shared memory of the channel."},
+    {"dropped", T_ULONGLONG, offsetof(ChannelObject, dropped), READONLY, "The number of messages that were overwritten before they were read."},
+
+    {NULL, 0, 0, 0, NULL}
+};
+
+static PyTypeObject ChannelType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "membridge.Channel",
+    .tp_doc = "A ring of messages in shared memory, written by a producer and read by any number of readers.",
+    .tp_basicsize = sizeof(ChannelObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Channel_new,
+    .tp_init = (initproc)Channel_init,
+    .tp_dealloc = (destructor)Channel_dealloc,
+    .tp_methods = Channel_methods,
+    .tp_members = Channel_members,
+};
+
+// # Tables
+
+/*
+  A table holds many values in a single segment, each under its own key,
+  so that it doesn't take a segment (and a file descriptor and mapping)
+  per key. The segment starts with the header, followed by the stripes,
+  the slots of the hash index, and the blocks of the keys and values.
+
+  The index is split into stripes of their own, each with a lock and an
+  open-addressed range of slots. A key always hashes to the same stripe,
+  and is only looked for in the slots of that stripe with linear probing,
+  so that processes using different stripes never wait on each other.
+  Deleted keys leave a tombstone, which is reused by the next insert.
+
+  The keys and values are stored SBS-encoded in blocks, which come from
+  a slab allocator with power-of-two size classes: freed blocks go on
+  the free list of their class, and new ones are taken from there first.
+  The allocator has a lock of its own, which is only held briefly while
+  taking or returning a block.
+
+  Keys and values are serialized before taking any lock and decoded after
+  releasing it, so the locks are only held while copying bytes. Keys are
+  compared by their serialized bytes, so keys that are equal in Python
+  but of a different type (like 1 and 1.0) are different keys here.
+
+*/
+
+#define TABLE_MAGIC    0x4d425442 // Marks a segment as a table
+#define TABLE_STRIPES  64         // The number of stripes of the index, a power of two
+#define TABLE_CAPACITY 65536      // The default number of keys
+#define TABLE_SIZE     (64 << 20) // The default size of the blocks of the keys and values
+#define TABLE_CLASSES  40         // The number of size classes of the blocks
+#define TABLE_MIN_BLOCK 32        // The size of the blocks of the smallest class
+
+#define SLOT_EMPTY     0 // The offset of a slot that was never used
+#define SLOT_DELETED   1 // The offset of a slot of which the key was deleted
+
+typedef struct {
+    uint32_t magic; // Set to TABLE_MAGIC once the table is initialized
+    uint32_t stripe_slots; // The number of slots in every stripe, a power of two
+    uint64_t blocks_offset; // The offset of the blocks from the start of the segment
+    uint64_t blocks_size; // The size of the space for the blocks
+    uint64_t blocks_used; // The size of the space for the blocks that was given out
+    uint64_t free[TABLE_CLASSES]; // The offsets of the first free block of every class, 0 for none
+    pthread_mutex_t mutex; // Taken while allocating and freeing blocks
+} TableShm;
+
+typedef struct {
+    pthread_mutex_t mutex; // Taken while reading or writing the slots of the stripe
+    uint64_t count; // The number of keys in the stripe
+} __attribute__((aligned(64))) TableStripe;
+
+typedef struct {
+    uint64_t hash;   // The hash of the key
+    uint64_t offset; // The offset of the block from the start of the segment, or SLOT_EMPTY/SLOT_DELETED
+} TableSlot;
+
+typedef struct {
+    uint32_t size_class; // The class of the block, the block is TABLE_MIN_BLOCK << size_class bytes
+    uint32_t key_size;   // The size of the key bytes after the header, followed by the value bytes
+    uint64_t value_size; // The size of the value bytes; the offset of the next free block while it's free
+} TableBlock;
+
+#define TABLE_HEADER_SIZE (sizeof(TableShm) + TABLE_STRIPES * sizeof(TableStripe))
+
+static inline TableStripe *table_stripes(TableShm *shm)
+{
+    return (TableStripe *)((unsigned char *)shm + sizeof(TableShm));
+}
+
+static inline TableSlot *table_slots(TableShm *shm, size_t stripe)
+{
+    return (TableSlot *)((unsigned char *)shm + TABLE_HEADER_SIZE) + stripe * shm->stripe_slots;
+}
+
+static inline TableBlock *table_block(TableShm *shm, uint64_t offset)
+{
+    return (TableBlock *)((unsigned char *)shm + offset);
+}
+
+// Hash the serialized bytes of a key (FNV-1a), which is the same in every process unlike Python's own hash
+static inline uint64_t hash_table_key(const unsigned char *bytes, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'callable' type.");
-        return NULL;
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
     }
 
-    if (!PyCallable_Check(func))
+    // Mix the high bits into the low ones, as those pick the stripe and the slot
+    return hash ^ (hash >> 32);
+}
+
+// Take a block of at least `size` bytes. Returns 0 if there's no space left
+static inline uint64_t alloc_table_block(TableShm *shm, size_t size)
+{
+    uint32_t size_class = 0;
+    while (size_class < TABLE_CLASSES - 1 && ((size_t)TABLE_MIN_BLOCK << size_class) < size) size_class++;
+
+    size_t block_size = (size_t)TABLE_MIN_BLOCK << size_class;
+    if (block_size < size) return 0;
+
+    pthread_mutex_lock(&(shm->mutex));
+
+    uint64_t offset = shm->free[size_class];
+    if (offset != 0)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'callable' type.");
-        return NULL;
+        shm->free[size_class] = table_block(shm, offset)->value_size;
+    }
+    else if (shm->blocks_size - shm->blocks_used >= block_size)
+    {
+        offset = shm->blocks_offset + shm->blocks_used;
+        shm->blocks_used += block_size;
     }
 
-    // Call the function to create and link the shared function
-    Py_INCREF(func);
-    PyObject *return_value = create_shared_function(name, func);
-    Py_DECREF(func);
+    pthread_mutex_unlock(&(shm->mutex));
 
-    return return_value;
+    if (offset != 0) table_block(shm, offset)->size_class = size_class;
+    return offset;
 }
 
-// Call a function linked to a shared memory conditional
-PyObject *call_shared_function(const char *name, PyObject *args)
+// Put a block back on the free list of its class
+static inline void free_table_block(TableShm *shm, uint64_t offset)
 {
-    int fd = shm_open(name, O_RDWR, 0666);
+    TableBlock *block = table_block(shm, offset);
+
+    pthread_mutex_lock(&(shm->mutex));
+    block->value_size = shm->free[block->size_class];
+    shm->free[block->size_class] = offset;
+    pthread_mutex_unlock(&(shm->mutex));
+}
+
+// Find the slot of a key in a stripe, which should be locked. Returns NULL if the key isn't in it
+static inline TableSlot *find_table_slot(TableShm *shm, TableSlot *slots, uint64_t hash, const unsigned char *key, size_t key_size, TableSlot **free_slot)
+{
+    uint32_t mask = shm->stripe_slots - 1;
+    if (free_slot != NULL) *free_slot = NULL;
+
+    // The low bits pick the stripe, so use the ones above them to pick the slot
+    for (uint32_t i = 0, index = (uint32_t)(hash / TABLE_STRIPES) & mask; i < shm->stripe_slots; i++, index = (index + 1) & mask)
+    {
+        TableSlot *slot = &slots[index];
+
+        if (slot->offset == SLOT_EMPTY)
+        {
+            if (free_slot != NULL && *free_slot == NULL) *free_slot = slot;
+            return NULL;
+        }
+
+        if (slot->offset == SLOT_DELETED)
+        {
+            if (free_slot != NULL && *free_slot == NULL) *free_slot = slot;
+            continue;
+        }
+
+        TableBlock *block = table_block(shm, slot->offset);
+        if (slot->hash == hash && block->key_size == key_size && memcmp((unsigned char *)block + sizeof(TableBlock), key, key_size) == 0)
+            return slot;
+    }
+
+    return NULL;
+}
+
+// Create and initialize the segment of a table. Returns 1 if it already exists
+static inline int create_table_shm(const char *name, size_t capacity, size_t size)
+{
+    // Keep the index at most 3/4 full, spread evenly over the stripes
+    size_t stripe_slots = 8;
+    while (stripe_slots * TABLE_STRIPES * 3 / 4 < capacity) stripe_slots *= 2;
+
+    if (stripe_slots > UINT32_MAX)
+    {
+        PyErr_SetString(PyExc_ValueError, "The capacity of the table is too large.");
+        return -1;
+    }
+
+    size_t blocks_offset = TABLE_HEADER_SIZE + stripe_slots * TABLE_STRIPES * sizeof(TableSlot);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
     if (fd == -1)
     {
-        PyErr_SetString(PyExc_MemoryError, "Failed to open the shared memory.");
-        return NULL;
+        if (errno == EEXIST) return 1;
+
+        PyErr_Format(PyExc_MemoryError, "Failed to create shared memory address '%s'.", name);
+        return -1;
     }
 
-    // Get the shared memory
-    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE + FUNCTION_ARGS, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    TableShm *shm;
+    if (ftruncate(fd, blocks_offset + size) == -1 || (shm = mmap(NULL, TABLE_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        shm_unlink(name);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate for shared memory address '%s'.", name);
+        return -1;
+    }
     close(fd);
-    if (shm == MAP_FAILED)
+
+    // The segment is zero-filled, so all slots start out empty and all free lists empty
+    TableStripe *stripes = table_stripes(shm);
+    pthread_mutexattr_t attr;
+    int failed = pthread_mutexattr_init(&attr) != 0 ||
+                 pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 ||
+                 pthread_mutex_init(&(shm->mutex), &attr) != 0;
+
+    for (size_t i = 0; i < TABLE_STRIPES && !failed; i++)
+        failed = pthread_mutex_init(&(stripes[i].mutex), &attr) != 0;
+
+    if (failed)
     {
-        PyErr_SetString(PyExc_MemoryError, "Failed to map the shared memory.");
-        return NULL;
+        munmap(shm, TABLE_HEADER_SIZE);
+        shm_unlink(name);
+        PyErr_Format(PyExc_MemoryError, "Failed to initialize mutex for shared memory address '%s'.", name);
+        return -1;
     }
+    pthread_mutexattr_destroy(&attr);
 
-    // Lock the mutex
-    pthread_mutex_lock(&(shm->mutex));
+    shm->stripe_slots = (uint32_t)stripe_slots;
+    shm->blocks_offset = blocks_offset;
+    shm->blocks_size = size;
+    __atomic_store_n(&(shm->magic), TABLE_MAGIC, __ATOMIC_RELEASE);
+
+    munmap(shm, TABLE_HEADER_SIZE);
+    return 0;
+}
 
-    // Convert the args to a Python bytes object
-    PyObject *py_args = from_value(args);
-    if (args == NULL)
+typedef struct {
+    PyObject_HEAD
+    PyObject *name;
+    TableShm *shm;
+    size_t mapped_size;
+} TableObject;
+
+static inline int check_table_open(TableObject *self)
+{
+    if (self->shm == NULL)
     {
-        pthread_mutex_unlock(&(shm->mutex));
-        munmap(shm, FUNCTION_SIZE + FUNCTION_ARGS);
-        return NULL; // Error already set
+        PyErr_SetString(PyExc_ValueError, "The table is closed.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline void close_table(TableObject *self)
+{
+    if (self->shm == NULL) return;
+
+    munmap(self->shm, self->mapped_size);
+    self->shm = NULL;
+}
+
+// Serialize a key and find its stripe. Returns NULL on failure
+static inline PyObject *encode_table_key(TableObject *self, PyObject *key, uint64_t *hash, TableStripe **stripe, TableSlot **slots)
+{
+    if (check_table_open(self) == -1) return NULL;
+
+    PyObject *bytes = from_value(key);
+    if (bytes == NULL) return NULL;
+
+    *hash = hash_table_key((const unsigned char *)PyBytes_AS_STRING(bytes), (size_t)PyBytes_GET_SIZE(bytes));
+    *stripe = &(table_stripes(self->shm)[*hash & (TABLE_STRIPES - 1)]);
+    *slots = table_slots(self->shm, *hash & (TABLE_STRIPES - 1));
+
+    return bytes;
+}
+
+static int Table_init(TableObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *name;
+    Py_ssize_t capacity = TABLE_CAPACITY;
+    Py_ssize_t size = TABLE_SIZE;
+    PyObject *create = NULL;
+
+    static char* kwlist[] = {"name", "capacity", "size", "create", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|nnO!", kwlist, &name, &capacity, &size, &PyBool_Type, &create) || capacity <= 0 || size <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected at least the 'name' (str) argument, and optionally a positive 'capacity' (int) and 'size' (int), and 'create' (bool).");
+        return -1;
     }
 
-    // Convert the args to a char array
-    size_t arg_size;
-    char *arg_bytes;
-    if (PyBytes_AsStringAndSize(py_args, &arg_bytes, (Py_ssize_t *)&arg_size) == -1)
+    // Close the old table in case init is called twice
+    close_table(self);
+    Py_CLEAR(self->name);
+
+    if ((create == NULL || Py_IsTrue(create)) && create_table_shm(name, (size_t)capacity, (size_t)size) == -1) return -1;
+
+    self->shm = map_ready_shm(name, TABLE_MAGIC, TABLE_HEADER_SIZE, &(self->mapped_size));
+    if (self->shm == NULL) return -1;
+
+    if (self->shm->blocks_offset + self->shm->blocks_size > self->mapped_size)
     {
-        Py_DECREF(py_args);
-        pthread_mutex_unlock(&(shm->mutex));
-        munmap(shm, FUNCTION_SIZE + FUNCTION_ARGS);
-        PyErr_SetString(PyExc_RuntimeError, "Failed to convert the args to C bytes.");
-        return NULL;
+        close_table(self);
+        PyErr_Format(PyExc_MemoryError, "The shared memory address '%s' is not a valid table.", name);
+        return -1;
     }
-    Py_DECREF(py_args);
 
-    // Check whether the size doesn't exceed the limit
-    if (arg_size > FUNCTION_ARGS)
+    self->name = PyUnicode_FromString(name);
+    if (self->name == NULL)
     {
-        pthread_mutex_unlock(&(shm->mutex));
-        munmap(shm, FUNCTION_SIZE + FUNCTION_ARGS);
-        PyErr_SetString(PyExc_ValueError, "The received args exceed the maximum accepted arg size of 1024 bytes.");
-        return NULL;
+        close_table(self);
+        return -1;
     }
 
-    // Copy the bytes to the shared memory
-    memcpy((char *)shm + FUNCTION_SIZE, arg_bytes, arg_size);
+    return 0;
+}
+
+static void Table_dealloc(TableObject *self)
+{
+    close_table(self);
+    Py_XDECREF(self->name);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Table_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    TableObject *self = (TableObject *)type->tp_alloc(type, 0);
+    if (self == NULL) return NULL;
+
+    // Mark the table as closed until it's initialized
+    self->name = NULL;
+    self->shm = NULL;
+
+    return (PyObject *)self;
+}
+
+static PyObject *Table_get(TableObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *key;
+    PyObject *default_value = Py_None;
 
-    // Signal the function
-    pthread_cond_signal(&(shm->fcond));
-    // Wait for the return args
-    pthread_cond_wait(&(shm->ccond), &(shm->mutex));
+    static char* kwlist[] = {"key", "default", NULL};
 
-    // Check whether we didn't receive a NULL message
-    if (*((char *)shm + FUNCTION_SIZE) == 0)
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist, &key, &default_value))
     {
-        PyErr_SetString(PyExc_RuntimeError, "Received a NULL message from the function. This is likely because the function returned arguments of too large size.");
+        PyErr_SetString(PyExc_ValueError, "Expected the 'key' (any) argument, and optionally 'default' (any).");
         return NULL;
     }
 
-    // Convert the C args to Python bytes
-    PyObject *py_return_args = PyBytes_FromStringAndSize((char *)shm + FUNCTION_SIZE, FUNCTION_ARGS);
+    uint64_t hash;
+    TableStripe *stripe;
+    TableSlot *slots;
+    PyObject *key_bytes = encode_table_key(self, key, &hash, &stripe, &slots);
+    if (key_bytes == NULL) return NULL;
 
-    // Close the mutex and unmap the shared memory as we no longer need it
-    pthread_mutex_unlock(&(shm->mutex));
-    munmap(shm, FUNCTION_SIZE + FUNCTION_ARGS);
+    size_t key_size = (size_t)PyBytes_GET_SIZE(key_bytes);
+    PyObject *buffer = NULL;
 
-    if (py_return_args == NULL)
+    pthread_mutex_lock(&(stripe->mutex));
+
+    TableSlot *slot = find_table_slot(self->shm, slots, hash, (const unsigned char *)PyBytes_AS_STRING(key_bytes), key_size, NULL);
+    if (slot != NULL)
     {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to convert C bytes to a Python bytes object.");
-        return NULL;
+        // Only copy the value while holding the lock, and decode it after
+        TableBlock *block = table_block(self->shm, slot->offset);
+        buffer = PyBytes_FromStringAndSize((const char *)block + sizeof(TableBlock) + key_size, (Py_ssize_t)block->value_size);
     }
 
-    // Convert the Python bytes to the Python value we should return, and return it
-    PyObject *returned_value = to_value(py_return_args);
-    return returned_value;
+    pthread_mutex_unlock(&(stripe->mutex));
+    Py_DECREF(key_bytes);
+
+    if (slot == NULL)
+    {
+        Py_INCREF(default_value);
+        return default_value;
+    }
+    if (buffer == NULL) return NULL;
+
+    PyObject *value = to_value_buf((const unsigned char *)PyBytes_AS_STRING(buffer), (size_t)PyBytes_GET_SIZE(buffer));
+    Py_DECREF(buffer);
+    return value;
 }
 
-PyObject *call_function(PyObject *self, PyObject *args)
+static PyObject *Table_set(TableObject *self, PyObject *args)
 {
-    const char *name;
-    PyObject *py_args;
+    PyObject *key;
+    PyObject *value;
 
-    if (!PyArg_ParseTuple(args, "sO!", &name, &PyTuple_Type, &py_args))
+    if (!PyArg_ParseTuple(args, "OO", &key, &value))
     {
-        PyErr_SetString(PyExc_ValueError, "Expected a 'str' and 'tuple' type.");
+        PyErr_SetString(PyExc_ValueError, "Expected the 'key' (any) and 'value' (any) arguments.");
         return NULL;
     }
 
-    // Call the shared function and get the returned value
-    Py_INCREF(py_args);
-    PyObject *return_value = call_shared_function(name, py_args);
-    Py_DECREF(py_args);
+    uint64_t hash;
+    TableStripe *stripe;
+    TableSlot *slots;
+    PyObject *key_bytes = encode_table_key(self, key, &hash, &stripe, &slots);
+    if (key_bytes == NULL) return NULL;
 
-    // Return the returned value to the user
-    return return_value;
+    PyObject *value_bytes = from_value(value);
+    if (value_bytes == NULL)
+    {
+        Py_DECREF(key_bytes);
+        return NULL;
+    }
+
+    size_t key_size = (size_t)PyBytes_GET_SIZE(key_bytes);
+    size_t value_size = (size_t)PyBytes_GET_SIZE(value_bytes);
+    const unsigned char *key_data = (const unsigned char *)PyBytes_AS_STRING(key_bytes);
+
+    // Write the new block before taking the lock of the stripe, so that the lock is only held to swap it in
+    uint64_t offset = key_size > UINT32_MAX ? 0 : alloc_table_block(self->shm, sizeof(TableBlock) + key_size + value_size);
+    if (offset != 0)
+    {
+        TableBlock *block = table_block(self->shm, offset);
+        block->key_size = (uint32_t)key_size;
+        block->value_size = value_size;
+        memcpy((unsigned char *)block + sizeof(TableBlock), key_data, key_size);
+        memcpy((unsigned char *)block + sizeof(TableBlock) + key_size, PyBytes_AS_STRING(value_bytes), value_size);
+    }
+    Py_DECREF(value_bytes);
+
+    if (offset == 0)
+    {
+        Py_DECREF(key_bytes);
+        PyErr_Format(PyExc_MemoryError, "There's no space left in table '%U' for the value.", self->name);
+        return NULL;
+    }
+
+    uint64_t old_offset = 0;
+    int full = 0;
+
+    pthread_mutex_lock(&(stripe->mutex));
+
+    TableSlot *free_slot;
+    TableSlot *slot = find_table_slot(self->shm, slots, hash, key_data, key_size, &free_slot);
+    if (slot != NULL)
+    {
+        old_offset = slot->offset;
+        slot->offset = offset;
+    }
+    else if (free_slot != NULL)
+    {
+        stripe->count++;
+
+        free_slot->hash = hash;
+        free_slot->offset = offset;
+    }
+    else
+    {
+        full = 1;
+    }
+
+    pthread_mutex_unlock(&(stripe->mutex));
+    Py_DECREF(key_bytes);
+
+    if (full)
+    {
+        free_table_block(self->shm, offset);
+        PyErr_Format(PyExc_MemoryError, "There are no slots left in table '%U' for the key.", self->name);
+        return NULL;
+    }
+
+    if (old_offset != 0) free_table_block(self->shm, old_offset);
+    Py_RETURN_TRUE;
 }
 
-PyObject *remove_function(PyObject *self, PyObject *args)
+static PyObject *Table_delete(TableObject *self, PyObject *key)
 {
-    const char *name;
+    uint64_t hash;
+    TableStripe *stripe;
+    TableSlot *slots;
+    PyObject *key_bytes = encode_table_key(self, key, &hash, &stripe, &slots);
+    if (key_bytes == NULL) return NULL;
+
+    uint64_t old_offset = 0;
 
-    if (!PyArg_ParseTuple(args, "s|O!", &name))
+    pthread_mutex_lock(&(stripe->mutex));
+
+    TableSlot *slot = find_table_slot(self->shm, slots, hash, (const unsigned char *)PyBytes_AS_STRING(key_bytes), (size_t)PyBytes_GET_SIZE(key_bytes), NULL);
+    if (slot != NULL)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected 1 'str' type.");
-        return NULL;
+        old_offset = slot->offset;
+        slot->offset = SLOT_DELETED;
+        stripe->count--;
     }
 
-    int fd = shm_open(name, O_RDWR, 0666);
-    if (fd == -1) return Py_False; // Return False to indicate we couldn't open the shm in the first place
+    pthread_mutex_unlock(&(stripe->mutex));
+    Py_DECREF(key_bytes);
 
-    FunctionShm *shm = mmap(NULL, FUNCTION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    close(fd);
-    if (shm == MAP_FAILED) return Py_False;
+    if (old_offset == 0) Py_RETURN_FALSE;
 
-    // Lock the mutex
-    pthread_mutex_lock(&(shm->mutex));
+    free_table_block(self->shm, old_offset);
+    Py_RETURN_TRUE;
+}
+
+static Py_ssize_t Table_length(TableObject *self)
+{
+    if (check_table_open(self) == -1) return -1;
 
-    // Set the activity byte to 0 to indicate inactive
-    shm->activity = 0;
+    // The stripes are counted one after another, so this isn't a snapshot while others write
+    TableStripe *stripes = table_stripes(self->shm);
+    uint64_t count = 0;
+    for (size_t i = 0; i < TABLE_STRIPES; i++)
+        count += __atomic_load_n(&(stripes[i].count), __ATOMIC_RELAXED);
 
-    // Signal the function to have it read inactivity and shut down
-    pthread_cond_signal(&(shm->fcond));
-    pthread_mutex_unlock(&(shm->mutex));
-    return Py_True; // Return True to indicate success
+    return (Py_ssize_t)count;
 }
 
+static PyObject *Table_close(TableObject *self, PyObject *Py_UNUSED(ignored))
+{
+    close_table(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Table_methods[] = {
+    {"get", (PyCFunction)Table_get, METH_VARARGS | METH_KEYWORDS, "Get the value of a key in the table."},
+    {"set", (PyCFunction)Table_set, METH_VARARGS, "Set the value of a key in the table."},
+    {"delete", (PyCFunction)Table_delete, METH_O, "Delete a key from the table."},
+    {"close", (PyCFunction)Table_close, METH_NOARGS, "Unmap the table."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMemberDef Table_members[] = {
+    {"name", T_OBJECT, offsetof(TableObject, name), READONLY, "The name of the shared memory of the table."},
+
+    {NULL, 0, 0, 0, NULL}
+};
+
+static PyMappingMethods Table_mapping = {
+    .mp_length = (lenfunc)Table_length,
+};
+
+static PyTypeObject TableType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "membridge.Table",
+    .tp_doc = "A table of keys and values in a single shared memory segment.",
+    .tp_basicsize = sizeof(TableObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Table_new,
+    .tp_init = (initproc)Table_init,
+    .tp_dealloc = (destructor)Table_dealloc,
+    .tp_methods = Table_methods,
+    .tp_members = Table_members,
+    .tp_as_mapping = &Table_mapping,
+};
+
 static PyMethodDef methods[] = {
     {"create_memory", (PyCFunction)create_memory, METH_VARARGS | METH_KEYWORDS, "Create a shared memory address."},
     {"remove_memory", (PyCFunction)remove_memory, METH_VARARGS | METH_KEYWORDS, "Remove a shared memory address."},
     {"read_memory", read_memory, METH_VARARGS, "Get the value stored in a shared memory address."},
+    {"view_memory", view_memory, METH_VARARGS, "Get a lazy view of the value stored in a shared memory address."},
     {"write_memory", (PyCFunction)write_memory, METH_VARARGS | METH_KEYWORDS, "Write a value to a shared memory address."},
-
-    {"create_function", create_function, METH_VARARGS, "Create and link a function to shared memory."},
+    {"trim_memory", trim_memory, METH_VARARGS, "Shrink a shared memory address down to the size of its value."},
+    {"wait_for_change", (PyCFunction)wait_for_change, METH_VARARGS | METH_KEYWORDS, "Wait until a shared memory address is written to."},
+    {"get_item", get_memory_item, METH_VARARGS, "Get one item of the SFS value in a shared memory address."},
+    {"set_item", set_memory_item, METH_VARARGS, "Set one item of the SFS value in a shared memory address."},
+    {"stats", (PyCFunction)memory_stats, METH_VARARGS | METH_KEYWORDS, "Get the stats counters of a shared memory address."},
+    {"enable_stats", (PyCFunction)enable_stats, METH_VARARGS | METH_KEYWORDS, "Enable or disable the stats counters in this process."},
+
+    {"create_function", (PyCFunction)create_function, METH_VARARGS | METH_KEYWORDS, "Create and link a function to shared memory."},
     {"remove_function", remove_function, METH_VARARGS, "Stop a function linked to shared memory."},
-    {"call_function", call_function, METH_VARARGS, "Call a function linked to shared memory."},
+    {"call_function", (PyCFunction)call_function, METH_VARARGS | METH_KEYWORDS, "Call a function linked to shared memory."},
+    {"call_function_many", (PyCFunction)call_function_many, METH_VARARGS | METH_KEYWORDS, "Call a function linked to shared memory with a batch of args."},
+    {"function_stats", (PyCFunction)function_stats, METH_VARARGS | METH_KEYWORDS, "Get the latency counters of a function linked to shared memory."},
 
     {NULL, NULL, 0, NULL}
 };
@@ -655,6 +3584,55 @@ PyMODINIT_FUNC PyInit_membridge(void)
 {
     sbs2_init();
     Py_Initialize();
-    return PyModule_Create(&membridge);
+
+    if (PyType_Ready(&MemoryType) < 0 || PyType_Ready(&ChannelType) < 0 || PyType_Ready(&TableType) < 0) return NULL;
+
+    PyObject *module = PyModule_Create(&membridge);
+    if (module == NULL) return NULL;
+
+    // Stop the background functions at exit, while the interpreter can still run their workers
+    pthread_atfork(NULL, NULL, forget_background_functions);
+
+    // Spinning only burns the time slice of the other side on a single CPU
+    spinning_allowed = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+    static PyMethodDef stop_method = {"_stop_background_functions", stop_background_functions, METH_NOARGS, NULL};
+    PyObject *stop_function = PyCFunction_New(&stop_method, NULL);
+    PyObject *atexit = PyImport_ImportModule("atexit");
+    PyObject *registered = (stop_function != NULL && atexit != NULL) ? PyObject_CallMethod(atexit, "register", "O", stop_function) : NULL;
+    Py_XDECREF(stop_function);
+    Py_XDECREF(atexit);
+    if (registered == NULL)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+    Py_DECREF(registered);
+
+    Py_INCREF(&MemoryType);
+    if (PyModule_AddObject(module, "Memory", (PyObject *)&MemoryType) < 0)
+    {
+        Py_DECREF(&MemoryType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&ChannelType);
+    if (PyModule_AddObject(module, "Channel", (PyObject *)&ChannelType) < 0)
+    {
+        Py_DECREF(&ChannelType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TableType);
+    if (PyModule_AddObject(module, "Table", (PyObject *)&TableType) < 0)
+    {
+        Py_DECREF(&TableType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
 }
 
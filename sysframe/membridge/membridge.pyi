@@ -1,6 +1,6 @@
 # membridge.pyi
 
-def create_memory(name: str, prealloc_size: int=None, error_if_exists: bool=False) -> bool:
+def create_memory(name: str, prealloc_size: int=None, error_if_exists: bool=False, huge_pages: bool=False, populate: bool=False, numa_node: int=-1) -> bool:
     """
     Create a shared memory segment.
     
@@ -10,6 +10,11 @@ def create_memory(name: str, prealloc_size: int=None, error_if_exists: bool=Fals
     - `name`: The unique name for your shared memory, used to be able to locate it in other processes as well.
     - `prealloc_size`: Space to allocate up front for data to write to (optional).
     - `error_if_exists`: Throw an error if the shared memory address already exists (optional).
+    - `huge_pages`: Back the segment with transparent huge pages, if the system allows it for shared memory (optional).
+    - `populate`: Allocate the pages of the segment right away, instead of on the first write to them (optional).
+    - `numa_node`: The NUMA node to prefer for the pages of the segment, -1 for none (optional).
+    
+    The placement arguments also apply to the space the segment grows by later on.
     
     The `prealloc_size` argument is optional because the shared memory will resize automatically based on what is written to it.
     
@@ -40,10 +45,24 @@ def read_memory(name: str) -> any:
     Arguments:
     - `name`: The unique name of the shared memory segment you want to read the value from.
     
+    Reads never block on the writers. If a value is written while it's being read, the read is retried.
+    
+    """
+    ...
+
+def view_memory(name: str) -> any:
+    """
+    Read the value stored to a shared memory segment as a lazy view (see `pybytes.view`).
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment you want to read the value from.
+    
+    The bytes are copied out just like `read_memory` does, but only the items that are accessed are created.
+    
     """
     ...
 
-def write_memory(name: str, value: any, create: bool=True) -> bool:
+def write_memory(name: str, value: any, create: bool=True, sfs: bool=False, refs: bool=False, compress: int=0, oob_threshold: int=0) -> bool:
     """
     Write a value to a shared memory segment.
     
@@ -51,19 +70,321 @@ def write_memory(name: str, value: any, create: bool=True) -> bool:
     - `name`: The unique name for your shared memory to write the value to.
     - `value`: The value you want to write to the shared memory.
     - `create`: Create the shared memory if it doesn't exist yet (optional).
+    - `sfs`: Write a dict or list as an SFS buffer, so that `get_item` and `set_item` can access single items (optional).
+    - `refs`: Write repeated strings once, and refer back to them after that (optional, ignored with `sfs`).
+    - `compress`: The zlib level from 1 to 9 to compress values of at least 4 KiB with, 0 to not compress (optional, not with `sfs`).
+    - `oob_threshold`: The min size of buffers to write out-of-band to a segment of their own, 0 to write them inline (optional, not with `sfs` or `compress`).
+    
+    The value is serialized before taking the lock, and then copied to the shared memory, which grows when it runs out of space.
+    If the value can't be serialized, the previous value is left in place.
+    
+    """
+    ...
+
+def get_item(name: str, key: any) -> any:
+    """
+    Read one item of the dict or list written to a shared memory segment with `sfs=True`.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment.
+    - `key`: The key of the item for dicts, or the index for lists.
+    
+    Only the bytes of the item are copied out and decoded. Just like `read_memory`, this never blocks on the writers.
+    Raises a `KeyError` or `IndexError` if the item doesn't exist.
+    
+    """
+    ...
+
+def set_item(name: str, key: any, value: any) -> bool:
+    """
+    Write one item of the dict or list written to a shared memory segment with `sfs=True`.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment.
+    - `key`: The key of the item for dicts, or the index for lists.
+    - `value`: The new value of the item.
+    
+    Only the bytes of the item are rewritten, unless the new value doesn't fit in the space of the old one.
+    New keys are added to dicts, while lists keep their length.
+    
+    """
+    ...
+
+class Memory:
+    """
+    A handle to a shared memory segment that stays mapped between reads and writes.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment.
+    - `create`: Create the shared memory if it doesn't exist yet (optional).
+    
+    The `read_memory` and `write_memory` functions open and map the segment on every call.
+    This handle keeps it mapped instead, and only remaps when another process resized the segment.
+    
+    """
+    
+    name: str
+    
+    def __init__(self, name: str, create: bool=True) -> None: ...
+    
+    def read(self) -> any:
+        """
+        Read the value stored to the shared memory segment.
+        
+        """
+        ...
+    
+    def view(self) -> any:
+        """
+        Read the value stored to the shared memory segment as a lazy view (see `pybytes.view`).
+        
+        """
+        ...
+    
+    def write(self, value: any, sfs: bool=False, refs: bool=False, compress: int=0, oob_threshold: int=0) -> bool:
+        """
+        Write a value to the shared memory segment.
+        
+        Arguments:
+        - `value`: The value you want to write to the shared memory.
+        - `sfs`: Write a dict or list as an SFS buffer, so that `get_item` and `set_item` can access single items (optional).
+        - `refs`: Write repeated strings once, and refer back to them after that (optional, ignored with `sfs`).
+        - `compress`: The zlib level from 1 to 9 to compress values of at least 4 KiB with, 0 to not compress (optional, not with `sfs`).
+        - `oob_threshold`: The min size of buffers to write out-of-band to a segment of their own, 0 to write them inline (optional, not with `sfs` or `compress`).
+        
+        """
+        ...
+    
+    def get_item(self, key: any) -> any:
+        """
+        Read one item of the dict or list written to the shared memory segment with `sfs=True`.
+        
+        Arguments:
+        - `key`: The key of the item for dicts, or the index for lists.
+        
+        """
+        ...
+    
+    def set_item(self, key: any, value: any) -> bool:
+        """
+        Write one item of the dict or list written to the shared memory segment with `sfs=True`.
+        
+        Arguments:
+        - `key`: The key of the item for dicts, or the index for lists.
+        - `value`: The new value of the item.
+        
+        """
+        ...
+    
+    def trim(self) -> bool:
+        """
+        Free the memory of the shared memory segment that isn't used by the value currently written to it.
+        
+        """
+        ...
+    
+    def wait_for_change(self, last_version: int=0, timeout: float=None) -> int:
+        """
+        Wait until the shared memory segment is written to, and return its new version (see `wait_for_change`).
+        
+        Arguments:
+        - `last_version`: The last version that was seen, 0 for a segment that was never written to (optional).
+        - `timeout`: The max time in seconds to wait, after which `last_version` is returned (optional, waits forever by default).
+        
+        """
+        ...
+    
+    def close(self) -> None:
+        """
+        Unmap the shared memory segment and close the handle.
+        
+        This does not remove the shared memory segment itself, use `remove_memory` for that.
+        
+        """
+        ...
+
+def trim_memory(name: str) -> bool:
+    """
+    Free the memory of a shared memory segment that isn't used by the value currently written to it.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment you want to trim.
+    
+    Segments only grow automatically, so this can be used to free the space left over after writing a large value.
+    The size of the segment stays the same, but the unused pages are released.
     
     """
     ...
 
-def create_function(name: str, function: callable) -> None:
+class Table:
+    """
+    A table of keys and values in a single shared memory segment.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment of the table.
+    - `capacity`: The number of keys the table has room for, only used when the table is created (optional).
+    - `size`: The space in bytes for the keys and values, only used when the table is created (optional).
+    - `create`: Create the table if it doesn't exist yet (optional).
+    
+    The index is split into stripes with a lock each, so that processes working on different keys rarely wait on each other.
+    Keys are compared by their serialized bytes, so `1` and `1.0` are different keys.
+    
+    """
+    
+    name: str
+    
+    def __init__(self, name: str, capacity: int=65536, size: int=67108864, create: bool=True) -> None: ...
+    
+    def __len__(self) -> int: ...
+    
+    def get(self, key: any, default: any=None) -> any:
+        """
+        Get the value of a key in the table.
+        
+        Arguments:
+        - `key`: The key of the value.
+        - `default`: The value to return if the key isn't in the table (optional).
+        
+        """
+        ...
+    
+    def set(self, key: any, value: any) -> bool:
+        """
+        Set the value of a key in the table, raising a `MemoryError` if there's no room for it.
+        
+        Arguments:
+        - `key`: The key of the value.
+        - `value`: The new value of the key.
+        
+        """
+        ...
+    
+    def delete(self, key: any) -> bool:
+        """
+        Delete a key from the table. Returns whether it was in the table.
+        
+        Arguments:
+        - `key`: The key to delete.
+        
+        """
+        ...
+    
+    def close(self) -> None:
+        """
+        Unmap the table.
+        
+        This does not remove the shared memory segment itself, use `remove_memory` for that.
+        
+        """
+        ...
+
+class Channel:
+    """
+    A ring of messages in shared memory, written by a producer and read by any number of readers.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment of the channel.
+    - `capacity`: The size of the ring in bytes, only used when the channel is created (optional).
+    - `create`: Create the channel if it doesn't exist yet (optional).
+    
+    Every reader gets every message sent after it opened the channel.
+    Once the ring is full, the oldest messages are overwritten, and readers that didn't read them yet skip them.
+    
+    """
+    
+    name: str
+    dropped: int
+    
+    def __init__(self, name: str, capacity: int=1048576, create: bool=True) -> None: ...
+    
+    def send(self, value: any) -> bool:
+        """
+        Write a message to the channel for all readers, overwriting the oldest messages if the ring is full.
+        
+        Arguments:
+        - `value`: The message you want to send, which can't be larger than the capacity of the channel.
+        
+        """
+        ...
+    
+    def recv(self, timeout: float=None) -> any:
+        """
+        Read the next message from the channel, waiting for one to be sent if necessary.
+        
+        Arguments:
+        - `timeout`: The max time in seconds to wait, raising a `TimeoutError` after it (optional, waits forever by default).
+        
+        """
+        ...
+    
+    def close(self) -> None:
+        """
+        Unmap the channel.
+        
+        Threads waiting in `recv` raise a `ValueError`, and the channel is only unmapped once they're done.
+        This does not remove the shared memory segment itself, use `remove_memory` for that.
+        
+        """
+        ...
+
+def wait_for_change(name: str, last_version: int=0, timeout: float=None) -> int:
+    """
+    Wait until a shared memory segment is written to, and return its new version.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment, which is created if it doesn't exist yet.
+    - `last_version`: The last version that was seen, 0 for a segment that was never written to (optional).
+    - `timeout`: The max time in seconds to wait, after which `last_version` is returned (optional, waits forever by default).
+    
+    Every write increments the version, and this returns right away if it already differs from `last_version`.
+    The GIL is released while waiting.
+    
+    """
+    ...
+
+def stats(name: str, reset: bool=False) -> dict:
+    """
+    Get the stats counters of a shared memory segment.
+    
+    Arguments:
+    - `name`: The unique name of the shared memory segment.
+    - `reset`: Reset the counters to 0 after reading them (optional).
+    
+    Returns a dict with the number of `reads` and `writes`, the bytes they copied (`bytes_read` and `bytes_written`),
+    the reads that were retried because a write overlapped them (`read_retries`), the times a process remapped the segment (`remaps`),
+    how often writers waited for the lock and for how long in ns (`lock_waits` and `lock_wait_ns`), and the current `version`.
+    Only the processes that called `enable_stats` count.
+    
+    """
+    ...
+
+def enable_stats(enabled: bool=True) -> None:
+    """
+    Enable or disable the stats counters for the calls made by this process, which are disabled by default.
+    
+    Arguments:
+    - `enabled`: Whether to count (optional).
+    
+    This covers the counters returned by `stats`, and the `histogram`, `slot_waits` and `slot_wait_ns` of `function_stats`.
+    
+    """
+    ...
+
+def create_function(name: str, function: callable, background: bool = False, workers: int = 1, spin: int = 0, oob_threshold: int = 0) -> None:
     """
     Create and link a function to shared memory.
     
     Arguments:
     - `name`: The unique name for your shared memory.
     - `function`: The function (or any callable) you want to link to the shared memory.
+    - `background`: Serve the function on background threads and return right away, instead of blocking until it's removed (optional).
+    - `workers`: The number of background threads serving the function, only with `background` (optional).
+    - `spin`: The number of times to check for new calls before going to sleep (optional).
+    - `oob_threshold`: The min size of the buffers in returned values to pass out-of-band, 0 to pass them inline (optional).
     
     The given function will run in the context of the process that linked it to the shared memory.
+    The GIL is only held while the function runs, so other threads can run while it waits for calls.
+    In the background, errors raised by the function are reported through `sys.unraisablehook` instead of stopping it.
     
     """
     ...
@@ -81,16 +402,55 @@ def remove_function(name: str) -> bool:
     """
     ...
 
-def call_function(name: str, args: tuple) -> any:
+def call_function(name: str, args: tuple, spin: int = 0, oob_threshold: int = 0) -> any:
     """
     Call a function linked to shared memory.
     
     Arguments:
     - `name`: The unique name that the function is linked to.
     - `args`: The arguments you want to send to the function
+    - `spin`: The number of times to check for the returned value before going to sleep (optional).
+    - `oob_threshold`: The min size of the buffers in the arguments to pass out-of-band, 0 to pass them inline (optional).
     
     This will call the linked function in the context the process that defined it.
     This will return the arguments sent by the linked function.
+    Multiple callers can have calls in flight at once, and the GIL is released while waiting for the function.
+    This raises a `RuntimeError` if the function stops before handling the call.
+    
+    The arguments and the returned value can be of any size. Small ones are passed inline, larger ones through a separate segment.
+    
+    """
+    ...
+
+def call_function_many(name: str, batch: list, spin: int = 0, oob_threshold: int = 0) -> list:
+    """
+    Call a function linked to shared memory once for every args tuple in a batch.
+    
+    Arguments:
+    - `name`: The unique name that the function is linked to.
+    - `batch`: A list of the argument tuples you want to call the function with.
+    - `spin`: The number of times to check for the returned values before going to sleep (optional).
+    - `oob_threshold`: The min size of the buffers in the arguments to pass out-of-band, 0 to pass them inline (optional).
+    
+    All arguments are sent as one message, and the function is called with them one after another.
+    This will return a list of the values returned by the linked function, in the same order.
+    If one of the calls fails, the whole batch fails with a `RuntimeError`.
+    
+    """
+    ...
+
+def function_stats(name: str, reset: bool = False) -> dict:
+    """
+    Get the latency counters of a function linked to shared memory.
+    
+    Arguments:
+    - `name`: The unique name that the function is linked to.
+    - `reset`: Reset the counters to 0 after reading them (optional).
+    
+    Returns a dict with the number of `calls`, how many of them got their returned value while spinning (`spun`) or after sleeping (`slept`),
+    their total and longest round trip time in ns (`total_ns` and `max_ns`), and how often the function went to sleep waiting for calls (`server_sleeps`).
+    Calls made with the stats enabled also count in the `histogram` of round trip times, where item `i` holds the calls under 2^i µs,
+    and in the number of calls that waited for a free slot and for how long in ns (`slot_waits` and `slot_wait_ns`).
     
     """
     ...
@@ -1,53 +1,329 @@
 #include "sbs_main/sbs_2.h"
+#include "sfs_main/sfs_1.h"
+#include "srs_main/srs_1.h"
 
 // # The python handles for from and to value calls
 
-static PyObject *py_from_value(PyObject *self, PyObject *args)
+static PyObject *py_from_value(PyObject *self, PyObject *args, PyObject *kwargs)
 {
     PyObject *value;
+    Py_ssize_t size_hint = 0;
+    int refs = 0;
+    int workers = 1;
+    int compress = 0;
+    Py_ssize_t compress_threshold = COMPRESS_THRESHOLD;
+    Py_ssize_t oob_threshold = 0;
+
+    static char* kwlist[] = {"value", "size_hint", "refs", "workers", "compress", "compress_threshold", "oob_threshold", NULL};
 
     // Parse the args and kwargs
-    if (!PyArg_ParseTuple(args, "O", &value))
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|npiinn", kwlist, &value, &size_hint, &refs, &workers, &compress, &compress_threshold, &oob_threshold) ||
+        size_hint < 0 || workers < 1 || compress < 0 || compress > 9 || compress_threshold < 0 || oob_threshold < 0)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected 1 'any' argument.");
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'any' argument, and optionally a positive 'int' size hint, 'refs' (bool), a positive 'int' number of workers, a 'compress' level from 0 to 9, a positive 'int' compress threshold and a positive 'int' out-of-band threshold.");
+        return NULL;
+    }
+
+    // Out-of-band buffers are read straight from their segment, so there's nothing left worth compressing
+    if (compress != 0 && oob_threshold != 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Can't compress bytes with out-of-band buffers.");
         return NULL;
     }
 
     Py_INCREF(value);
 
     // Call the imported from_value converter function
-    PyObject *bytes = from_value(value);
+    PyObject *bytes = from_value_oob(value, (size_t)size_hint, refs, workers, (size_t)oob_threshold);
 
     // Clean up reference
     Py_DECREF(value);
 
-    return bytes;
+    if (bytes == NULL || compress == 0) return bytes;
+
+    PyObject *frame = compress_value(bytes, compress, (size_t)compress_threshold);
+    Py_DECREF(bytes);
+
+    return frame;
 }
 
-static PyObject *py_to_value(PyObject *self, PyObject *args)
+static PyObject *py_to_value(PyObject *self, PyObject *args, PyObject *kwargs)
 {
     PyObject *py_bytes = NULL;
+    int workers = 1;
+    int oob = 0;
+
+    static char* kwlist[] = {"value", "workers", "oob", NULL};
 
-    if (!PyArg_ParseTuple(args, "O!", &PyBytes_Type, &py_bytes))
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ip", kwlist, &py_bytes, &workers, &oob) || !PyObject_CheckBuffer(py_bytes) || workers < 1)
     {
-        PyErr_SetString(PyExc_ValueError, "Expected 1 'bytes' type.");
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'bytes-like' type, and optionally a positive 'int' number of workers and a 'bool' for out-of-band buffers.");
         return NULL;
     }
 
     Py_INCREF(py_bytes);
 
-    PyObject *result = to_value(py_bytes);
+    // This decodes straight from the buffer of the object, without copying it
+    PyObject *result = to_value(py_bytes, workers, oob);
 
     Py_DECREF(py_bytes);
     return result;
 }
 
+static PyObject *py_view(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *py_bytes = NULL;
+    int oob = 0;
+
+    static char* kwlist[] = {"value", "oob", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", kwlist, &py_bytes, &oob) || !PyObject_CheckBuffer(py_bytes))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'bytes-like' type, and optionally a 'bool' for out-of-band buffers.");
+        return NULL;
+    }
+
+    // The views keep the buffer of the object exported, and read from it directly
+    return view_value(py_bytes, oob);
+}
+
+static PyObject *py_dump(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *value;
+    PyObject *file;
+    Py_ssize_t chunk_size = 65536;
+    int refs = 0;
+
+    static char* kwlist[] = {"value", "file", "chunk_size", "refs", NULL};
+
+    // Parse the args and kwargs
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|np", kwlist, &value, &file, &chunk_size, &refs) || chunk_size <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'any' argument and a file, and optionally a positive 'int' chunk size and 'refs' (bool).");
+        return NULL;
+    }
+
+    Py_INCREF(value);
+    Py_INCREF(file);
+
+    // Write the value to the file in chunks
+    Py_ssize_t written = dump_value(value, file, (size_t)chunk_size, refs);
+
+    Py_DECREF(value);
+    Py_DECREF(file);
+
+    if (written == -1) return NULL;
+    return PyLong_FromSsize_t(written);
+}
+
+static PyObject *py_load(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *file;
+    Py_ssize_t chunk_size = 65536;
+
+    static char* kwlist[] = {"file", "chunk_size", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n", kwlist, &file, &chunk_size) || chunk_size <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a file, and optionally a positive 'int' chunk size.");
+        return NULL;
+    }
+
+    Py_INCREF(file);
+
+    // Read the value from the file in chunks
+    PyObject *result = load_value(file, (size_t)chunk_size);
+
+    Py_DECREF(file);
+    return result;
+}
+
+// # The python handles for the SFS functions
+
+// Grow function for writing SFS buffers to a bytearray, which is kept as the context
+static int grow_bytearray_target(SBSTarget *target, size_t size)
+{
+    PyObject *array = (PyObject *)target->context;
+
+    // The bytearray over-allocates by itself, so just ask for what we need
+    if (PyByteArray_Resize(array, (Py_ssize_t)size) == -1) return -1;
+
+    target->bytes = (unsigned char *)PyByteArray_AS_STRING(array);
+    target->size = size;
+    return 0;
+}
+
+// Grow function for writing SFS buffers to a fixed-size buffer, which can't grow
+static int grow_fixed_target(SBSTarget *target, size_t size)
+{
+    PyErr_SetString(PyExc_BufferError, "Not enough space in the buffer for the item, use a bytearray to let it grow.");
+    return -1;
+}
+
+static PyObject *py_sfs_from_value(PyObject *self, PyObject *args)
+{
+    PyObject *value;
+
+    if (!PyArg_ParseTuple(args, "O", &value))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'dict' or 'list' type.");
+        return NULL;
+    }
+
+    PyObject *array = PyByteArray_FromStringAndSize(NULL, 0);
+    if (array == NULL) return NULL;
+
+    SBSTarget target = {(unsigned char *)PyByteArray_AS_STRING(array), 0, grow_bytearray_target, array};
+
+    Py_INCREF(value);
+    Py_ssize_t size = sfs_from_value(value, &target);
+    Py_DECREF(value);
+
+    // Cut off what was reserved but not used
+    if (size == -1 || PyByteArray_Resize(array, size) == -1)
+    {
+        Py_DECREF(array);
+        return NULL;
+    }
+
+    return array;
+}
+
+static PyObject *py_sfs_get_item(PyObject *self, PyObject *args)
+{
+    PyObject *buffer;
+    PyObject *key;
+
+    if (!PyArg_ParseTuple(args, "OO", &buffer, &key) || !PyObject_CheckBuffer(buffer))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'bytes-like' type and a key.");
+        return NULL;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_SIMPLE) == -1) return NULL;
+
+    // Only the item itself is decoded, straight from the buffer
+    PyObject *result = sfs_get_item((const unsigned char *)view.buf, (size_t)view.len, key);
+
+    PyBuffer_Release(&view);
+    return result;
+}
+
+static PyObject *py_sfs_set_item(PyObject *self, PyObject *args)
+{
+    PyObject *buffer;
+    PyObject *key;
+    PyObject *value;
+
+    if (!PyArg_ParseTuple(args, "OOO", &buffer, &key, &value) || !PyObject_CheckBuffer(buffer))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 writable 'bytes-like' type, a key and a value.");
+        return NULL;
+    }
+
+    Py_ssize_t result;
+
+    if (PyByteArray_Check(buffer))
+    {
+        // A bytearray can grow, so we don't hold a buffer on it, as that prevents resizing
+        SBSTarget target = {(unsigned char *)PyByteArray_AS_STRING(buffer), (size_t)PyByteArray_GET_SIZE(buffer), grow_bytearray_target, buffer};
+        result = sfs_set_item(&target, target.size, key, value);
+    }
+    else
+    {
+        Py_buffer view;
+        if (PyObject_GetBuffer(buffer, &view, PyBUF_WRITABLE) == -1) return NULL;
+
+        SBSTarget target = {(unsigned char *)view.buf, (size_t)view.len, grow_fixed_target, NULL};
+        result = sfs_set_item(&target, target.size, key, value);
+
+        PyBuffer_Release(&view);
+    }
+
+    if (result == -1) return NULL;
+    Py_RETURN_NONE;
+}
+
+// # Out-of-band buffers
+
+static PyObject *py_release_buffers(PyObject *self, PyObject *args)
+{
+    PyObject *buffer;
+
+    if (!PyArg_ParseTuple(args, "O", &buffer) || !PyObject_CheckBuffer(buffer))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 'bytes-like' type.");
+        return NULL;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_SIMPLE) == -1) return NULL;
+
+    int result = release_oob_frame((const unsigned char *)view.buf, (size_t)view.len);
+
+    PyBuffer_Release(&view);
+    if (result == -1) return NULL;
+
+    return PyBool_FromLong(result);
+}
+
+// # Stats
+
+static PyObject *py_enable_stats(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    int enabled = 1;
+
+    static char* kwlist[] = {"enabled", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", kwlist, &enabled))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected an optional 'enabled' (bool).");
+        return NULL;
+    }
+
+    sbs_enable_stats(enabled);
+    Py_RETURN_NONE;
+}
+
+static PyObject *py_stats(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    int reset = 0;
+
+    static char* kwlist[] = {"reset", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", kwlist, &reset))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected an optional 'reset' (bool).");
+        return NULL;
+    }
+
+    SBSStats stats;
+    sbs_get_stats(&stats, reset);
+
+    return Py_BuildValue("{sKsKsKsKsK}",
+        "encodes", (unsigned long long)stats.encodes,
+        "decodes", (unsigned long long)stats.decodes,
+        "bytes_out", (unsigned long long)stats.bytes_out,
+        "bytes_in", (unsigned long long)stats.bytes_in,
+        "reallocs", (unsigned long long)stats.reallocs);
+}
+
 // # Module declarations
 
 // The offered methods and their descriptions
 static PyMethodDef methods[] = {
-    {"from_value", py_from_value, METH_VARARGS, "Convert a value to a bytes object."},
-    {"to_value", py_to_value, METH_VARARGS, "Convert a bytes object to a value."},
+    {"from_value", (PyCFunction)py_from_value, METH_VARARGS | METH_KEYWORDS, "Convert a value to a bytes object."},
+    {"to_value", (PyCFunction)py_to_value, METH_VARARGS | METH_KEYWORDS, "Convert a bytes-like object to a value."},
+    {"view", (PyCFunction)py_view, METH_VARARGS | METH_KEYWORDS, "Create a lazy view of a bytes-like object."},
+    {"dump", (PyCFunction)py_dump, METH_VARARGS | METH_KEYWORDS, "Write a value to a file in chunks."},
+    {"load", (PyCFunction)py_load, METH_VARARGS | METH_KEYWORDS, "Read a value from a file in chunks."},
+    {"sfs_from_value", py_sfs_from_value, METH_VARARGS, "Convert a dict or list to a random-access SFS bytearray."},
+    {"sfs_get_item", py_sfs_get_item, METH_VARARGS, "Get one item of an SFS buffer without decoding the rest."},
+    {"sfs_set_item", py_sfs_set_item, METH_VARARGS, "Set one item of an SFS buffer without rewriting the rest."},
+    {"release_buffers", py_release_buffers, METH_VARARGS, "Release the shared memory segment of the out-of-band buffers of bytes."},
+    {"enable_stats", (PyCFunction)py_enable_stats, METH_VARARGS | METH_KEYWORDS, "Enable or disable counting the work done by the conversions."},
+    {"stats", (PyCFunction)py_stats, METH_VARARGS | METH_KEYWORDS, "Get the counts of the work done by the conversions."},
 
     {NULL, NULL, 0, NULL}
 };
@@ -76,7 +352,25 @@ PyMODINIT_FUNC PyInit_pybytes(void)
     // Init the SBS module
     if (sbs2_init() == -1) return NULL;
 
-    // Create and return this module
-    return PyModule_Create(&pybytes);
+    // Create this module
+    PyObject *module = PyModule_Create(&pybytes);
+    if (module == NULL) return NULL;
+
+    if (PyType_Ready(&SchemaType) < 0)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    // Add the types of the lazy views, so they can be checked against, and the schemas
+    if (PyModule_AddObjectRef(module, "ListView", (PyObject *)&ListViewType) < 0 ||
+        PyModule_AddObjectRef(module, "DictView", (PyObject *)&DictViewType) < 0 ||
+        PyModule_AddObjectRef(module, "Schema", (PyObject *)&SchemaType) < 0)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
 }
 
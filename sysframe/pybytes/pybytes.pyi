@@ -1,9 +1,20 @@
 # pybytes.pyi
 
-def from_value(value: any) -> bytes:
+def from_value(value: any, size_hint: int = 0, refs: bool = False, workers: int = 1, compress: int = 0, compress_threshold: int = 4096, oob_threshold: int = 0) -> bytes:
     """
     Convert any value to a bytes object.
     
+    Arguments:
+    - `value`: The value to convert.
+    - `size_hint`: The number of bytes to pre-allocate for the conversion, for payloads of a known size (optional).
+    - `refs`: Write repeated strings once, and refer back to them after that (optional).
+    - `workers`: The number of threads to spread copies of large buffers and packing of long lists of numbers over (optional). The GIL stays held while doing so inside the value, so that other threads can't change it meanwhile.
+    - `compress`: The zlib level from 1 to 9 to compress the bytes with, 0 to not compress them (optional).
+    - `compress_threshold`: The min number of bytes to compress, smaller ones are returned uncompressed (optional).
+    - `oob_threshold`: The min size of `bytes`, `bytearray` and `memoryview` objects to write out-of-band to a shared memory segment, 0 to write them inline (optional).
+    
+    Bytes with out-of-band buffers only decode with `oob=True` on `to_value`, which returns those as read-only memoryviews of the segment, and need `release_buffers` once no one needs them anymore.
+    
     Example usage:
     
     >>> # The value we want to convert to bytes
@@ -35,15 +46,24 @@ def from_value(value: any) -> bytes:
         * `namedtuple`
         * `Counter`
         * `OrderedDict`
+    - `array.array`
     
     Convert the value back using `pybytes.to_value`
     """
     ...
 
-def to_value(bytes_obj: bytes) -> any:
+def to_value(bytes_obj: bytes, workers: int = 1, oob: bool = False) -> any:
     """
     Convert a bytes object created by `pybytes.from_value` back to its original value.
     
+    Arguments:
+    - `bytes_obj`: The bytes to convert.
+    - `workers`: The number of threads to spread copies of large buffers over, releasing the GIL meanwhile (optional).
+    - `oob`: Whether to map the segment of bytes with out-of-band buffers, which raise a `ValueError` otherwise. Only for bytes from a trusted source (optional).
+    
+    Any object supporting the buffer protocol (`bytes`, `bytearray`, `memoryview`, `mmap`, ...) is accepted.
+    The value is decoded directly from its buffer, without copying it first.
+    
     Example usage:
     
     >>> # The bytes object we got from `pybytes.from_value`
@@ -53,3 +73,244 @@ def to_value(bytes_obj: bytes) -> any:
     """
     ...
 
+class ListView:
+    """
+    A lazy view of a serialized list or tuple, created by `pybytes.view`.
+    
+    Items are only created once they're accessed. Nested lists, tuples and dicts are views as well.
+    Supports indexing, slicing (giving a list), `len`, iterating, and comparing to regular values.
+    """
+    
+    def decode(self) -> list | tuple:
+        """Create the full list or tuple the view stands for."""
+        ...
+
+class DictView:
+    """
+    A lazy view of a serialized dict, created by `pybytes.view`.
+    
+    Values are only created once they're accessed. Nested lists, tuples and dicts are views as well.
+    Supports indexing by key, `len`, iterating over the keys, `in`, and comparing to regular values.
+    """
+    
+    def get(self, key: any, default: any = None) -> any: ...
+    def keys(self) -> list: ...
+    def values(self) -> list: ...
+    def items(self) -> list: ...
+    
+    def decode(self) -> dict:
+        """Create the full dict the view stands for."""
+        ...
+
+class Schema:
+    """
+    A fixed layout for records of the same shape, like rows of a table held in dicts or namedtuples.
+    
+    The schema holds the fields and their types once, so that the encoded records only hold their values.
+    Ints (in 64 bits), floats and bools get a fixed width slot, strings and bytes are stored as they are,
+    and fields of any other type as regular bytes of `pybytes.from_value`. Every field can also be None.
+    The records are stored by column, so the values of a field sit next to each other.
+    
+    Example usage:
+    
+    >>> schema = pybytes.Schema({'id': int, 'name': str})
+    >>> bytes_obj = schema.encode_many([{'id': 1, 'name': 'first'}, {'id': 2, 'name': 'second'}])
+    >>> schema.decode_many(bytes_obj)
+    [{'id': 1, 'name': 'first'}, {'id': 2, 'name': 'second'}]
+    """
+    
+    fields: tuple
+    "The keys of the fields, or their names for namedtuples."
+    record_type: type | None
+    "The namedtuple type of the records, or None for dicts."
+    
+    def __init__(self, example_or_spec: dict | tuple | type) -> None:
+        """
+        Create a schema from an example record or a spec.
+        
+        Arguments:
+        - `example_or_spec`: An example dict or namedtuple, of which the values give the types of the fields.
+          Or a dict of only types, or a namedtuple type, of which the annotations (if any) give the types.
+        
+        Fields of which the type isn't `int`, `float`, `bool`, `str` or `bytes`, or that are None in the example, can hold any value.
+        """
+        ...
+    
+    def encode(self, record: dict | tuple) -> bytes:
+        """
+        Encode a record to bytes.
+        
+        Dicts need to have exactly the fields of the schema, and namedtuples (or tuples) as many items.
+        This raises a `TypeError` if a value doesn't have the type of its field, or None.
+        """
+        ...
+    
+    def decode(self, bytes_obj: bytes) -> dict | tuple:
+        """Decode the bytes of a single record, encoded by a schema with the same fields and types."""
+        ...
+    
+    def encode_many(self, records: list) -> bytes:
+        """Encode an iterable of records to bytes at once, which saves the header every record would have."""
+        ...
+    
+    def decode_many(self, bytes_obj: bytes) -> list:
+        """Decode the bytes of any number of records into a list."""
+        ...
+
+def view(bytes_obj: bytes, oob: bool = False) -> ListView | DictView | any:
+    """
+    Create a lazy view of a bytes object created by `pybytes.from_value`.
+    
+    For lists, tuples and dicts, this returns a view that only creates the items that are accessed.
+    Other values are converted directly, just like `pybytes.to_value` does, including `oob`.
+    The view reads directly from the buffer of the object, and keeps it exported while it exists.
+    
+    Example usage:
+    
+    >>> records = pybytes.view(bytes_obj)
+    >>> # Only this record and its name are created
+    >>> name = records[1234]['name']
+    """
+    ...
+
+
+def dump(value: any, file: any, chunk_size: int = 65536, refs: bool = False) -> int:
+    """
+    Convert any value to bytes written to a file, without holding all bytes in memory.
+    
+    Arguments:
+    - `value`: The value to convert.
+    - `file`: A binary file, or any object with a `write` method accepting bytes.
+    - `chunk_size`: The number of bytes to buffer before writing them to the file (optional).
+    - `refs`: Write repeated strings once, and refer back to them after that (optional).
+    
+    The bytes written are the same as those of `pybytes.from_value`, and this returns how many there are.
+    
+    Example usage:
+    
+    >>> with open('snapshot.sbs', 'wb') as file:
+    >>>     pybytes.dump(value, file)
+    """
+    ...
+
+def load(file: any, chunk_size: int = 65536) -> any:
+    """
+    Convert the bytes read from a file back to the value they were created from, without reading them all in memory.
+    
+    Arguments:
+    - `file`: A binary file, or any object with a `read` method returning bytes.
+    - `chunk_size`: The number of bytes to read from the file at once (optional).
+    
+    If the file can seek, it's left right after the value, so that multiple dumped values can be loaded from the same file.
+    
+    Example usage:
+    
+    >>> with open('snapshot.sbs', 'rb') as file:
+    >>>     value = pybytes.load(file)
+    """
+    ...
+
+def sfs_from_value(value: dict | list) -> bytearray:
+    """
+    Convert a dict or list to an SFS buffer, which allows reading and writing single items.
+    
+    Arguments:
+    - `value`: The dict or list to convert.
+    
+    The items are regular `pybytes.from_value` bytes, so they support the same datatypes.
+    Dict keys are compared by their serialized form.
+    
+    Convert the buffer back to the full value using `pybytes.to_value`.
+    
+    Example usage:
+    
+    >>> buffer = pybytes.sfs_from_value({'a': 1, 'b': [2, 3]})
+    """
+    ...
+
+def sfs_get_item(buffer: any, key: any) -> any:
+    """
+    Get one item of an SFS buffer, without decoding the other items.
+    
+    Arguments:
+    - `buffer`: The SFS buffer, any bytes-like object.
+    - `key`: The key of the item for dicts, or the index for lists.
+    
+    Raises a `KeyError` or `IndexError` if the item doesn't exist.
+    
+    Example usage:
+    
+    >>> pybytes.sfs_get_item(buffer, 'b')
+    [2, 3]
+    """
+    ...
+
+def sfs_set_item(buffer: any, key: any, value: any) -> None:
+    """
+    Set one item of an SFS buffer, without rewriting the other items.
+    
+    Arguments:
+    - `buffer`: The SFS buffer, a `bytearray` or any writable bytes-like object.
+    - `key`: The key of the item for dicts, or the index for lists.
+    - `value`: The new value of the item.
+    
+    New keys are added to dicts, while lists keep their length.
+    If the new value doesn't fit in the space of the old one, it's appended to the buffer.
+    A `bytearray` grows for that, other buffers raise a `BufferError` once they're full.
+    
+    Example usage:
+    
+    >>> pybytes.sfs_set_item(buffer, 'a', 'new value')
+    """
+    ...
+
+def release_buffers(bytes_obj: bytes) -> bool:
+    """
+    Release the shared memory segment of the out-of-band buffers of bytes created with `oob_threshold`.
+    
+    Arguments:
+    - `bytes_obj`: The bytes of which to release the buffers.
+    
+    Returns whether a segment was released, which is False if the bytes don't have one or it was already released.
+    Raises a `ValueError` if the bytes name a segment that wasn't created by `pybytes.from_value`, which is left alone.
+    Memoryviews that were already decoded stay valid, but decoding the bytes again raises a `FileNotFoundError`.
+    
+    Example usage:
+    
+    >>> bytes_obj = pybytes.from_value(b'x' * 65536, oob_threshold=4096)
+    >>> value = pybytes.to_value(bytes_obj, oob=True)
+    >>> pybytes.release_buffers(bytes_obj)
+    True
+    """
+    ...
+
+def enable_stats(enabled: bool = True) -> None:
+    """
+    Enable or disable counting the work done by the conversions, which is disabled by default.
+    
+    Arguments:
+    - `enabled`: Whether to count (optional).
+    
+    Every thread counts into its own counters, so this adds no contention between threads.
+    
+    """
+    ...
+
+def stats(reset: bool = False) -> dict:
+    """
+    Get the counts of the work done by the conversions of all threads, while the stats were enabled.
+    
+    Arguments:
+    - `reset`: Reset the counts to 0 after reading them (optional).
+    
+    Returns a dict with the number of `encodes` and `decodes`, the bytes they wrote and read (`bytes_out` and `bytes_in`),
+    and how often an encode had to grow its buffer (`reallocs`).
+    
+    Example usage:
+    
+    >>> pybytes.enable_stats()
+    >>> bytes_obj = pybytes.from_value([1, 2, 3])
+    >>> pybytes.stats()['encodes']
+    1
+    """
+    ...
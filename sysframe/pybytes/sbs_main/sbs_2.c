@@ -3,9 +3,17 @@
 #include <Python.h>
 #include <datetime.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
 
 #include "sbs_old/sbs_1.h"
 #include "sbs_2.h"
+#include "sfs_main/sfs_1.h"
+#include "srs_main/srs_1.h"
 
 /*
   ## Explanation of the SBS (Structured Bytes Stack) protocol
@@ -104,6 +112,8 @@
 #define EXT_M  255 // Reserved for if we ever happen to run out of a single byte to represent stuff
 #define PROT_1 254 // Protocol 1
 #define PROT_2 253 // Protocol 2
+#define PROT_Z 251 // A compressed frame holding the bytes of another protocol
+#define PROT_OOB 249 // A frame of bytes whose large buffers were written out-of-band, to a shared memory segment
 
 #define PROT_D PROT_2 // The default protocol
 
@@ -271,6 +281,24 @@
 // Literal NULL
 #define NULL_S 103
 
+// Dictionary with only string keys, written as a compact run of keys followed by the values
+#define SDICT_E  104 // Not written, as empty dicts use the regular empty dict datachar
+#define SDICT_1  105
+#define SDICT_2  106
+#define SDICT_D1 107
+#define SDICT_D2 108
+
+// Homogeneous numeric list, tuple or array, written as a single header followed by the raw items
+#define PACKED_S 109
+
+// Back-references to strings written earlier in the same bytes
+#define REFS_M 110 // Marks that the value after it may hold back-references, only written right after the protocol marker
+#define REF_1  111 // Reference with a 1 byte index
+#define REF_2  112 // Reference with a 2 byte index
+
+// A buffer written out-of-band, followed by its offset and size in the segment of the frame, 8 native bytes each
+#define OOB_S 113
+
 // # The return status codes
 
 typedef enum {
@@ -309,6 +337,373 @@ PyObject *chainmap_cl;
 PyObject *path_cl;
 PyObject *purepath_cl;
 
+// Array module class
+PyObject *array_cl;
+
+// Zlib module functions for compressed frames, imported once they're first needed
+static PyObject *zlib_compress = NULL;
+static PyObject *zlib_decompress = NULL;
+
+// Mmap module class for the segments of out-of-band buffers, imported once it's first needed
+static PyObject *mmap_cl = NULL;
+
+// # Type dispatch table
+
+/*
+  Picking the conversion function by the type name of a value takes a few
+  string comparisons per value, which adds up for containers with lots of
+  small items. So, the exact types we support are registered in a small
+  open-addressed hash table keyed on their type object, which maps them to
+  the kind of conversion to use. Subclasses aren't in the table, so they
+  still go through the type name based dispatch.
+
+*/
+
+typedef enum {
+    TK_UNKNOWN = 0, // Not registered, also used for empty entries
+    TK_STRING,
+    TK_INTEGER,
+    TK_FLOAT,
+    TK_COMPLEX,
+    TK_BOOLEAN,
+    TK_BYTES,
+    TK_BYTEARRAY,
+    TK_NONE,
+    TK_ELLIPSIS,
+    TK_LIST,
+    TK_TUPLE,
+    TK_NAMEDTUPLE, // Only from the type name based dispatch, as namedtuples are all different types
+    TK_DICT,
+    TK_SET,
+    TK_FROZENSET,
+    TK_RANGE,
+    TK_MEMORYVIEW,
+    TK_DATETIME, // Any of the datetime module types handled by 'from_datetime'
+    TK_DECIMAL,
+    TK_UUID,
+    TK_DEQUE,
+    TK_ODICT,
+    TK_COUNTER,
+    TK_CHAINMAP,
+    TK_PATH,
+    TK_PUREPATH,
+    TK_ARRAY,
+    TK_INCORRECT // Only from the type name based dispatch, for type names that don't match anything we support
+} TypeKind;
+
+typedef struct {
+    PyTypeObject *type; // Holds a reference, NULL for an empty entry
+    TypeKind kind;
+} TypeEntry;
+
+#define TYPE_TABLE_BITS 6 // The table holds 64 entries, so that it stays sparse for the ~30 types we register
+#define TYPE_TABLE_SIZE (1 << TYPE_TABLE_BITS)
+
+static TypeEntry type_table[TYPE_TABLE_SIZE];
+
+// Helper function to get the index that a type starts probing at
+static inline size_t type_table_index(PyTypeObject *type)
+{
+    // Fibonacci hashing, dropping the low bits that are the same for all aligned pointers
+    return (size_t)((((uintptr_t)type >> 4) * 0x9E3779B97F4A7C15ull) >> (64 - TYPE_TABLE_BITS));
+}
+
+// Get the kind of conversion registered for the exact type
+static inline TypeKind lookup_type_kind(PyTypeObject *type)
+{
+    for (size_t index = type_table_index(type);; index = (index + 1) & (TYPE_TABLE_SIZE - 1))
+    {
+        if (type_table[index].type == type) return type_table[index].kind;
+        if (type_table[index].type == NULL) return TK_UNKNOWN;
+    }
+}
+
+// Register the kind of conversion for an exact type. Returns -1 if it's not a type
+static inline int register_type_kind(PyObject *type, TypeKind kind)
+{
+    if (type == NULL || !PyType_Check(type)) return -1;
+
+    size_t index = type_table_index((PyTypeObject *)type);
+    while (type_table[index].type != NULL && type_table[index].type != (PyTypeObject *)type)
+        index = (index + 1) & (TYPE_TABLE_SIZE - 1);
+
+    if (type_table[index].type == NULL)
+    {
+        Py_INCREF(type);
+        type_table[index].type = (PyTypeObject *)type;
+    }
+    type_table[index].kind = kind;
+
+    return 0;
+}
+
+// Register all exact types we support, called once the module classes are imported
+static inline int init_type_table(void)
+{
+    const struct { PyObject *type; TypeKind kind; } builtins[] = {
+        {(PyObject *)&PyUnicode_Type, TK_STRING},
+        {(PyObject *)&PyLong_Type, TK_INTEGER},
+        {(PyObject *)&PyFloat_Type, TK_FLOAT},
+        {(PyObject *)&PyComplex_Type, TK_COMPLEX},
+        {(PyObject *)&PyBool_Type, TK_BOOLEAN},
+        {(PyObject *)&PyBytes_Type, TK_BYTES},
+        {(PyObject *)&PyByteArray_Type, TK_BYTEARRAY},
+        {(PyObject *)Py_TYPE(Py_None), TK_NONE},
+        {(PyObject *)Py_TYPE(Py_Ellipsis), TK_ELLIPSIS},
+        {(PyObject *)&PyList_Type, TK_LIST},
+        {(PyObject *)&PyTuple_Type, TK_TUPLE},
+        {(PyObject *)&PyDict_Type, TK_DICT},
+        {(PyObject *)&PySet_Type, TK_SET},
+        {(PyObject *)&PyFrozenSet_Type, TK_FROZENSET},
+        {(PyObject *)&PyRange_Type, TK_RANGE},
+        {(PyObject *)&PyMemoryView_Type, TK_MEMORYVIEW},
+        {(PyObject *)PyDateTimeAPI->DeltaType, TK_DATETIME},
+        {datetime_dt, TK_DATETIME},
+        {datetime_d, TK_DATETIME},
+        {datetime_t, TK_DATETIME},
+        {decimal_cl, TK_DECIMAL},
+        {uuid_cl, TK_UUID},
+        {deque_cl, TK_DEQUE},
+        {ordereddict_cl, TK_ODICT},
+        {counter_cl, TK_COUNTER},
+        {chainmap_cl, TK_CHAINMAP},
+        {array_cl, TK_ARRAY},
+    };
+
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+    {
+        if (register_type_kind(builtins[i].type, builtins[i].kind) == -1)
+        {
+            PyErr_SetString(PyExc_TypeError, "Could not register a supported type for serialization.");
+            return -1;
+        }
+    }
+
+    // Path and PurePath instances are of their platform specific subclasses
+    PyObject *pathlib_m = PyImport_ImportModule("pathlib");
+    if (pathlib_m == NULL)
+    {
+        PyErr_SetString(PyExc_ModuleNotFoundError, "Could not find module 'pathlib'.");
+        return -1;
+    }
+
+    const struct { const char *name; TypeKind kind; } paths[] = {
+        {"PosixPath", TK_PATH},
+        {"WindowsPath", TK_PATH},
+        {"PurePosixPath", TK_PUREPATH},
+        {"PureWindowsPath", TK_PUREPATH},
+    };
+
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+    {
+        PyObject *path_type = PyObject_GetAttrString(pathlib_m, paths[i].name);
+
+        // Paths we can't register still go through the type name based dispatch
+        if (path_type == NULL) PyErr_Clear();
+        else register_type_kind(path_type, paths[i].kind);
+
+        Py_XDECREF(path_type);
+    }
+
+    Py_DECREF(pathlib_m);
+
+    return 0;
+}
+
+// Drop the references held by the type table
+static inline void cleanup_type_table(void)
+{
+    for (size_t i = 0; i < TYPE_TABLE_SIZE; i++)
+    {
+        Py_XDECREF(type_table[i].type);
+        type_table[i].type = NULL;
+    }
+}
+
+// # Scratch buffers
+
+/*
+  Every from_value call writes to a buffer before copying it to the bytes
+  object it returns. Instead of allocating a new one every call, each
+  thread keeps the buffer of its last call around as scratch space for the
+  next one. Buffers that grew larger than SCRATCH_MAX_SIZE are freed instead,
+  so that a single large value doesn't pin its memory.
+
+*/
+
+#define SCRATCH_MAX_SIZE (1 << 20) // The max size of a buffer to keep around as scratch space
+
+typedef struct {
+    unsigned char *bytes; // NULL while the buffer is in use
+    size_t size;
+} ScratchBuffer;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static int scratch_ready = 0;
+
+// Free the scratch buffer of a thread when it exits
+static void free_scratch(void *arg)
+{
+    ScratchBuffer *scratch = (ScratchBuffer *)arg;
+
+    free(scratch->bytes);
+    free(scratch);
+}
+
+static void create_scratch_key(void)
+{
+    scratch_ready = pthread_key_create(&scratch_key, free_scratch) == 0;
+}
+
+// Take the scratch buffer of this thread, if it has one. Returns NULL if it doesn't or it's in use
+static inline unsigned char *take_scratch(size_t *size)
+{
+    ScratchBuffer *scratch = scratch_ready ? (ScratchBuffer *)pthread_getspecific(scratch_key) : NULL;
+    if (scratch == NULL || scratch->bytes == NULL) return NULL;
+
+    unsigned char *bytes = scratch->bytes;
+    *size = scratch->size;
+    scratch->bytes = NULL;
+
+    return bytes;
+}
+
+// Hand a buffer back as the scratch buffer of this thread, or free it if we can't keep it
+static inline void return_scratch(unsigned char *bytes, size_t size)
+{
+    ScratchBuffer *scratch = scratch_ready ? (ScratchBuffer *)pthread_getspecific(scratch_key) : NULL;
+
+    if (scratch == NULL && scratch_ready && size <= SCRATCH_MAX_SIZE)
+    {
+        scratch = (ScratchBuffer *)calloc(1, sizeof(ScratchBuffer));
+        if (scratch != NULL && pthread_setspecific(scratch_key, scratch) != 0)
+        {
+            free(scratch);
+            scratch = NULL;
+        }
+    }
+
+    // Keep the largest buffer, as long as it's not too large
+    if (scratch == NULL || size > SCRATCH_MAX_SIZE || (scratch->bytes != NULL && scratch->size >= size))
+    {
+        free(bytes);
+        return;
+    }
+
+    free(scratch->bytes);
+    scratch->bytes = bytes;
+    scratch->size = size;
+}
+
+// # Stats
+
+/*
+  The conversion functions can count the work they do, for finding out
+  where the time goes in production. Every thread counts into a block of
+  its own, so that threads never write to the same cache lines, and the
+  blocks are only summed when the stats are asked for. Blocks of threads
+  that exit are folded into the retired counts. While the stats are
+  disabled, counting costs a single check of the flag.
+
+*/
+
+typedef struct StatsBlock StatsBlock;
+struct StatsBlock {
+    SBSStats counts;
+    StatsBlock *prev, *next; // The blocks of the other live threads
+};
+
+static int stats_enabled = 0;
+static StatsBlock *stats_blocks = NULL;
+static SBSStats retired_stats;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static int stats_ready = 0;
+
+// Add the counts of one set of stats to another, resetting the source if `reset` is set
+static inline void add_stats(SBSStats *stats, SBSStats *source, int reset)
+{
+    uint64_t *to = (uint64_t *)stats;
+    uint64_t *from = (uint64_t *)source;
+
+    for (size_t i = 0; i < sizeof(SBSStats) / sizeof(uint64_t); i++)
+        to[i] += reset ? __atomic_exchange_n(&from[i], 0, __ATOMIC_RELAXED) : __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+}
+
+// Fold the block of a thread into the retired counts when it exits
+static void retire_stats(void *arg)
+{
+    StatsBlock *block = (StatsBlock *)arg;
+
+    pthread_mutex_lock(&stats_mutex);
+    add_stats(&retired_stats, &(block->counts), 0);
+
+    if (block->prev != NULL) block->prev->next = block->next;
+    else stats_blocks = block->next;
+    if (block->next != NULL) block->next->prev = block->prev;
+    pthread_mutex_unlock(&stats_mutex);
+
+    free(block);
+}
+
+static void create_stats_key(void)
+{
+    stats_ready = pthread_key_create(&stats_key, retire_stats) == 0;
+}
+
+// Get the stats block of this thread, creating it on first use. Returns NULL if it couldn't be created
+static inline SBSStats *thread_stats(void)
+{
+    if (!stats_ready) return NULL;
+
+    StatsBlock *block = (StatsBlock *)pthread_getspecific(stats_key);
+    if (block != NULL) return &(block->counts);
+
+    block = (StatsBlock *)calloc(1, sizeof(StatsBlock));
+    if (block == NULL) return NULL;
+
+    if (pthread_setspecific(stats_key, block) != 0)
+    {
+        free(block);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&stats_mutex);
+    block->next = stats_blocks;
+    if (stats_blocks != NULL) stats_blocks->prev = block;
+    stats_blocks = block;
+    pthread_mutex_unlock(&stats_mutex);
+
+    return &(block->counts);
+}
+
+// Add to a counter of this thread, if the stats are enabled. The adds are atomic as they can race with a reset
+#define COUNT_STAT(field, amount) do { \
+        if (__atomic_load_n(&stats_enabled, __ATOMIC_RELAXED)) \
+        { \
+            SBSStats *stats_ = thread_stats(); \
+            if (stats_ != NULL) __atomic_fetch_add(&(stats_->field), (uint64_t)(amount), __ATOMIC_RELAXED); \
+        } \
+    } while (0)
+
+void sbs_enable_stats(int enabled)
+{
+    __atomic_store_n(&stats_enabled, enabled != 0, __ATOMIC_RELAXED);
+}
+
+void sbs_get_stats(SBSStats *stats, int reset)
+{
+    memset(stats, 0, sizeof(SBSStats));
+
+    pthread_mutex_lock(&stats_mutex);
+    add_stats(stats, &retired_stats, reset);
+    for (StatsBlock *block = stats_blocks; block != NULL; block = block->next)
+        add_stats(stats, &(block->counts), reset);
+    pthread_mutex_unlock(&stats_mutex);
+}
+
 // # Initialization and cleanup functions
 
 int sbs2_init(void)
@@ -324,6 +719,12 @@ int sbs2_init(void)
     // Init the other protocols
     sbs1_init();
 
+    // Create the key for the scratch buffers of threads
+    pthread_once(&scratch_once, create_scratch_key);
+
+    // Create the key for the stats blocks of threads
+    pthread_once(&stats_once, create_stats_key);
+
     // Import the datetime module
     PyDateTime_IMPORT;
 
@@ -469,6 +870,31 @@ int sbs2_init(void)
         return -1;
     }
 
+    // Get the array module
+    PyObject *array_m = PyImport_ImportModule("array");
+    if (array_m == NULL)
+    {
+        PyErr_SetString(PyExc_ModuleNotFoundError, "Could not find module 'array'.");
+        return -1;
+    }
+
+    // Get the required attribute
+    array_cl = PyObject_GetAttrString(array_m, "array");
+
+    Py_DECREF(array_m);
+
+    if (array_cl == NULL)
+    {
+        PyErr_SetString(PyExc_AttributeError, "Could not find attribute 'array' in module 'array'.");
+        return -1;
+    }
+
+    // Register the exact types for the type dispatch table
+    if (init_type_table() == -1) return -1;
+
+    // Ready the types of the lazy views
+    if (PyType_Ready(&ListViewType) < 0 || PyType_Ready(&DictViewType) < 0) return -1;
+
     return 1;
 }
 
@@ -487,18 +913,274 @@ void sbs2_cleanup(void)
     Py_XDECREF(chainmap_cl);
     Py_XDECREF(path_cl);
     Py_XDECREF(purepath_cl);
+    Py_XDECREF(array_cl);
+    Py_CLEAR(zlib_compress);
+    Py_CLEAR(zlib_decompress);
+    Py_CLEAR(mmap_cl);
+
+    cleanup_type_table();
+
+    // Free the scratch buffer of this thread, the other threads free theirs when they exit
+    size_t scratch_size;
+    free(take_scratch(&scratch_size));
+}
+
+// # Parallel copies
+
+/*
+  Creating and reading Python objects needs the GIL, so the conversions
+  themselves can't be spread over threads. What can be spread is copying
+  the bytes of large buffers (bytes, bytearrays, memoryviews and arrays),
+  which makes for most of the time spent on values holding big ones, and
+  then copying the finished buffer to the bytes object we return. Packing
+  large lists of numbers can be spread too, as that only reads the raw
+  numbers from the items while we keep holding the GIL.
+
+  With more than one worker, copies of at least PARALLEL_MIN_SIZE bytes
+  are split into slices that are copied by the workers at once. The same
+  goes for packing the items of large lists and tuples of numbers, see
+  from_packed.
+
+  Copies made while we're going over a value keep holding the GIL. We
+  only hold borrowed references to most of what we copy from, and the
+  containers we're in the middle of (and their cached sizes) are only
+  safe as long as no other thread can run. Another thread could drop
+  the last reference to a bytes object, or clear the list holding it.
+  The GIL is only released when nothing of the value can change under
+  us: for the copy of the finished buffer to the bytes object we return,
+  for a root value that we hold through a Py_buffer, and when decoding,
+  as the bytes are held through a Py_buffer and the values we create
+  aren't visible to anyone yet.
+
+*/
+
+#define PARALLEL_MIN_SIZE  (4 << 20) // The min size of a copy to spread over the workers
+#define PARALLEL_MIN_SLICE (1 << 20) // The min size of the slice of a worker
+#define PARALLEL_MAX_WORKERS 64      // The max number of workers to spread a single job over
+
+/*
+  The workers are the threads of a pool shared by all conversions. They
+  are started once they're first needed, and kept around after that, as
+  starting a thread for every copy costs about as much as it saves.
+
+  A job is split into tasks that the caller and the workers claim one
+  after another, so that it gets done even if some of the workers could
+  not be started. Only one job runs on the pool at a time. Callers that
+  need the pool while it's in use just run their tasks themselves.
+
+*/
+
+// Run the task with the given index of a job
+typedef void (*PoolTask)(void *job, int index);
+
+static struct {
+    pthread_mutex_t mutex; // Guards the fields below
+    pthread_cond_t work;   // Signalled when a job is posted
+    pthread_cond_t done;   // Signalled when the last task of a job is done
+    pthread_mutex_t busy;  // Held by the caller whose job runs on the pool
+    PoolTask run;          // The function that runs the tasks of the job
+    void *job;             // The job that the tasks belong to
+    int next;              // The index of the next task to claim
+    int count;             // The number of tasks of the job
+    int pending;           // The number of tasks that aren't done yet
+    int threads;           // The number of workers that were started
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_MUTEX_INITIALIZER};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// Claim and run tasks of the job until none are left, should be called while holding the mutex of the pool
+static void run_pool_tasks(void)
+{
+    while (pool.next < pool.count)
+    {
+        int index = pool.next++;
+        PoolTask run = pool.run;
+        void *job = pool.job;
+
+        pthread_mutex_unlock(&(pool.mutex));
+        run(job, index);
+        pthread_mutex_lock(&(pool.mutex));
+
+        if (--pool.pending == 0) pthread_cond_signal(&(pool.done));
+    }
+}
+
+static void *run_pool_worker(void *arg)
+{
+    pthread_mutex_lock(&(pool.mutex));
+
+    while (1)
+    {
+        while (pool.next >= pool.count) pthread_cond_wait(&(pool.work), &(pool.mutex));
+        run_pool_tasks();
+    }
+
+    return NULL;
+}
+
+// Forget the workers in a forked child, as they only run in the parent, which might've held the locks while forking too
+static void reset_pool(void)
+{
+    pthread_mutex_init(&(pool.mutex), NULL);
+    pthread_cond_init(&(pool.work), NULL);
+    pthread_cond_init(&(pool.done), NULL);
+    pthread_mutex_init(&(pool.busy), NULL);
+
+    pool.next = pool.count = pool.pending = pool.threads = 0;
+}
+
+static void register_pool_reset(void)
+{
+    pthread_atfork(NULL, NULL, reset_pool);
+}
+
+// Run the tasks of a job on up to `workers` threads, counting our own
+static void run_parallel(PoolTask run, void *job, int count, int workers)
+{
+    // Reset the pool in forked children once it's been used
+    pthread_once(&pool_once, register_pool_reset);
+
+    if (workers <= 1 || pthread_mutex_trylock(&(pool.busy)) != 0)
+    {
+        for (int i = 0; i < count; i++) run(job, i);
+        return;
+    }
+
+    pthread_mutex_lock(&(pool.mutex));
+
+    // Start the workers that we're missing, those that fail to start just leave more tasks to us
+    while (pool.threads < workers - 1 && pool.threads < PARALLEL_MAX_WORKERS - 1)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, run_pool_worker, NULL) != 0) break;
+
+        pthread_detach(thread);
+        pool.threads++;
+    }
+
+    pool.run = run;
+    pool.job = job;
+    pool.next = 0;
+    pool.count = count;
+    pool.pending = count;
+    pthread_cond_broadcast(&(pool.work));
+
+    run_pool_tasks();
+    while (pool.pending > 0) pthread_cond_wait(&(pool.done), &(pool.mutex));
+
+    pool.next = pool.count = 0;
+
+    pthread_mutex_unlock(&(pool.mutex));
+    pthread_mutex_unlock(&(pool.busy));
+}
+
+// A copy split into slices, one per task
+typedef struct {
+    unsigned char *dest;
+    const unsigned char *src;
+    size_t size;
+    size_t slice_size;
+    int slices;
+} CopyJob;
+
+static void copy_slice(void *arg, int index)
+{
+    CopyJob *job = (CopyJob *)arg;
+
+    // The last slice takes what's left
+    size_t start = (size_t)index * job->slice_size;
+    size_t size = index == job->slices - 1 ? job->size - start : job->slice_size;
+
+    memcpy(&(job->dest[start]), &(job->src[start]), size);
+}
+
+// Copy bytes, spread over up to `workers` threads if it's large enough, releasing the GIL meanwhile if `release_gil` is set. Should be called while holding the GIL
+static void copy_bytes(void *dest, const void *src, size_t size, int workers, int release_gil)
+{
+    if (workers > PARALLEL_MAX_WORKERS) workers = PARALLEL_MAX_WORKERS;
+    if ((size_t)workers > size / PARALLEL_MIN_SLICE) workers = (int)(size / PARALLEL_MIN_SLICE);
+
+    if (workers <= 1 || size < PARALLEL_MIN_SIZE)
+    {
+        memcpy(dest, src, size);
+        return;
+    }
+
+    // Round the slices to cache lines
+    CopyJob job = {(unsigned char *)dest, (const unsigned char *)src, size, (size / workers) & ~(size_t)63, workers};
+
+    PyThreadState *state = release_gil ? PyEval_SaveThread() : NULL;
+    run_parallel(copy_slice, &job, workers, workers);
+    if (state != NULL) PyEval_RestoreThread(state);
 }
 
 // # Helper functions for the from-conversion functions
 
+#define OOB_NAME_SIZE 64 // The max size of the name of a segment, including its NUL
+
+// The shared memory segment that large buffers are written to out-of-band, see the section on those
+typedef struct {
+    size_t threshold;     // The min size of a buffer to write out-of-band
+    int fd;               // The descriptor of the segment, or -1 until the first buffer creates it
+    char name[OOB_NAME_SIZE]; // The name of the segment
+    unsigned char *bytes; // The mapping of the segment
+    size_t size;          // The size of the segment and its mapping
+    size_t used;          // The number of bytes written to it
+} OOBSegment;
+
 // Struct that holds the values converted to C bytes
 typedef struct {
     Py_ssize_t offset;
     Py_ssize_t max_size;
     int nests;
     unsigned char *bytes;
+    SBSTarget *target; // The caller-supplied target to write to, or NULL to use our own allocation
+    PyObject *stream; // The file to flush the bytes to once the buffer is full, or NULL to keep them all in memory
+    int pins; // Set while we might still go back to bytes we wrote, so that they can't be flushed yet
+    Py_ssize_t flushed; // The number of bytes flushed to the stream so far
+    PyObject *refs; // The strings written so far mapped to their reference index, or NULL to not write back-references
+    int workers; // The number of threads to spread large copies and packing over, see copy_bytes and from_packed
+    int release_gil; // Set while copying from the buffer of the root value held through a Py_buffer, so that the copy can release the GIL
+    OOBSegment *oob; // The segment to write large buffers to out-of-band, or NULL to write them inline
 } ValueData;
 
+// Write bytes to the stream of the ValueData. Returns -1 with an error set on failure
+static inline int write_stream(ValueData *vd, const unsigned char *bytes, Py_ssize_t size)
+{
+    while (size > 0)
+    {
+        // The file gets a copy, as it might hold on to what it's given
+        PyObject *chunk = PyBytes_FromStringAndSize((const char *)bytes, size);
+        if (chunk == NULL) return -1;
+
+        PyObject *result = PyObject_CallMethod(vd->stream, "write", "O", chunk);
+        Py_DECREF(chunk);
+        if (result == NULL) return -1;
+
+        // Raw files might write less than they're given, and some files don't return a count at all
+        Py_ssize_t count = result == Py_None ? size : PyLong_AsSsize_t(result);
+        Py_DECREF(result);
+
+        if (count == -1 && PyErr_Occurred()) return -1;
+        if (count <= 0 || count > size) count = size;
+
+        bytes += count;
+        size -= count;
+        vd->flushed += count;
+    }
+
+    return 0;
+}
+
+// Flush the bytes written so far to the stream, and start over at the start of the buffer
+static inline int flush_vd(ValueData *vd)
+{
+    if (write_stream(vd, vd->bytes, vd->offset) == -1) return -1;
+
+    vd->offset = 0;
+    return 0;
+}
+
 // This function resizes the bytes of the ValueData when necessary
 static inline StatusCode auto_resize_vd(ValueData *vd, Py_ssize_t jump)
 {
@@ -512,19 +1194,39 @@ static inline StatusCode auto_resize_vd(ValueData *vd, Py_ssize_t jump)
     // Check if we need to reallocate for more space with the given jump
     if (vd->offset + jump > vd->max_size)
     {
-        // Update the max size
-        vd->max_size += jump + ALLOC_SIZE;
-        // Reallocate to the new max size
-        unsigned char *temp = (unsigned char *)realloc((void *)(vd->bytes), vd->max_size * sizeof(unsigned char));
-        if (temp == NULL)
+        // Flush what we've written so far if we're streaming, and only grow if the jump is larger than the buffer
+        if (vd->stream != NULL && vd->pins == 0)
+        {
+            // Any error set by the file takes precedence over the memory error
+            if (flush_vd(vd) == -1) return SC_NOMEMORY;
+            if (vd->offset + jump <= vd->max_size) return SC_SUCCESS;
+        }
+
+        // The new max size to grow to, doubling so that a run of small writes only reallocates a few times
+        Py_ssize_t max_size = vd->max_size * 2;
+        if (max_size < vd->offset + jump + ALLOC_SIZE) max_size = vd->offset + jump + ALLOC_SIZE;
+
+        COUNT_STAT(reallocs, 1);
+
+        // Let the target grow itself if we're writing to one
+        if (vd->target != NULL)
         {
-            // Free the already allocated bytes
-            free(vd->bytes);
-            return SC_NOMEMORY;
+            if (vd->target->grow(vd->target, (size_t)max_size) == -1) return SC_NOMEMORY;
+
+            // The target might have moved, so get the new bytes and size from it
+            vd->bytes = vd->target->bytes;
+            vd->max_size = (Py_ssize_t)vd->target->size;
+
+            return SC_SUCCESS;
         }
 
+        // Reallocate to the new max size, the bytes are freed by the caller on failure
+        unsigned char *temp = (unsigned char *)realloc((void *)(vd->bytes), max_size * sizeof(unsigned char));
+        if (temp == NULL) return SC_NOMEMORY;
+
         // Update the bytes to point to the new allocated bytes
         vd->bytes = temp;
+        vd->max_size = max_size;
     }
 
     // Return success
@@ -554,22 +1256,49 @@ static inline StatusCode increment_nests(ValueData *vd)
 }
 
 // Function to initiate the ValueData class
-static inline ValueData init_vd(PyObject *value, StatusCode *status)
+static inline ValueData init_vd(PyObject *value, size_t size_hint, StatusCode *status)
 {
     /*
-      This function creates a ValueData struct for us, and pre-allocates
-      an estimated size of the value plus the default alloc size to have
-      enough headroom, while still refraining from allocating either too
-      little, causing performance degradation due to frequent reallocs,
-      or too much, using up unnecessary memory space.
+      This function creates a ValueData struct for us, reusing the scratch
+      buffer of this thread if it has one. Otherwise, it pre-allocates the
+      size hint of the caller, or an estimated size of the value plus the
+      default alloc size. The estimate is shallow, but as the buffer grows
+      geometrically, underestimating only costs a few reallocs.
 
     */
 
-    // Attempt to estimate what the max possible byte size will be using sys.getsizeof
-    size_t max_size = (_PySys_GetSizeOf(value) * 2) + ALLOC_SIZE;
+    size_t max_size;
+    unsigned char *bytes = take_scratch(&max_size);
+
+    // Don't use the scratch buffer if it's smaller than the caller expects to need
+    if (bytes != NULL && max_size < size_hint)
+    {
+        free(bytes);
+        bytes = NULL;
+    }
+
+    if (bytes == NULL)
+    {
+        max_size = size_hint;
+
+        if (max_size == 0)
+        {
+            // Attempt to estimate what the max possible byte size will be using sys.getsizeof
+            max_size = (_PySys_GetSizeOf(value) * 2) + ALLOC_SIZE;
+
+            // Fall back to the default alloc size if the value doesn't report a size
+            if (PyErr_Occurred())
+            {
+                PyErr_Clear();
+                max_size = ALLOC_SIZE;
+            }
+        }
+
+        bytes = (unsigned char *)malloc(max_size * sizeof(unsigned char));
+    }
 
     // Create the struct itself
-    ValueData vd = {1, (Py_ssize_t)max_size, 0, (unsigned char *)malloc(max_size * sizeof(unsigned char))};
+    ValueData vd = {1, (Py_ssize_t)max_size, 0, bytes, NULL};
     if (vd.bytes == NULL)
     {
         // Set the status
@@ -720,6 +1449,10 @@ static inline StatusCode write_E12D(ValueData *vd, Py_ssize_t size, const unsign
 
     Py_ssize_t num_bytes = get_num_bytes(size);
 
+    // Large values are written straight to the stream when streaming, so they don't need space in the buffer
+    int direct = bytes != NULL && vd->stream != NULL && vd->pins == 0 && size > vd->max_size / 2;
+    Py_ssize_t value_size = (bytes != NULL && !direct) ? size : 0;
+
     // Check if we can use regular datachars or have to use the dynamic datachar
     switch (num_bytes)
     {
@@ -737,7 +1470,7 @@ static inline StatusCode write_E12D(ValueData *vd, Py_ssize_t size, const unsign
     case 2:
     {
         // Resize if necessary
-        if (auto_resize_vd(vd, num_bytes + size + 1) == SC_NOMEMORY) return SC_NOMEMORY;
+        if (auto_resize_vd(vd, num_bytes + value_size + 1) == SC_NOMEMORY) return SC_NOMEMORY;
 
         // Write the metadata and set the datachar to the empty one plus the offset, to get the 1 or 2 case datachar
         write_metadata(vd, empty + num_bytes, size, num_bytes);
@@ -749,14 +1482,14 @@ static inline StatusCode write_E12D(ValueData *vd, Py_ssize_t size, const unsign
         if (num_bytes < 256) // Smaller than 1 byte
         {
             // Resize if necessary
-            if (auto_resize_vd(vd, num_bytes + size + 1) == SC_NOMEMORY) return SC_NOMEMORY;
+            if (auto_resize_vd(vd, num_bytes + value_size + 1) == SC_NOMEMORY) return SC_NOMEMORY;
             // Write the dynamic metadata
             if (write_dynamic1_metadata(vd, (const unsigned char)(empty + 3), size, num_bytes) == SC_NOMEMORY) return SC_NOMEMORY;
         }
         else if (num_bytes < (255^255) - 1) // Smaller than 256 bytes
         {
             // Resize if necessary
-            if (auto_resize_vd(vd, num_bytes + size + 1) == SC_NOMEMORY) return SC_NOMEMORY;
+            if (auto_resize_vd(vd, num_bytes + value_size + 1) == SC_NOMEMORY) return SC_NOMEMORY;
             // Write the dynamic metadata
             if (write_dynamic2_metadata(vd, empty + 4, size, num_bytes) == SC_NOMEMORY) return SC_NOMEMORY;
         }
@@ -772,10 +1505,15 @@ static inline StatusCode write_E12D(ValueData *vd, Py_ssize_t size, const unsign
     }
 
     // Check if we should add the bytes
-    if (bytes != NULL)
+    if (direct)
+    {
+        // Write large values straight to the stream instead of through the buffer
+        if (flush_vd(vd) == -1 || write_stream(vd, bytes, size) == -1) return SC_EXCEPTION;
+    }
+    else if (bytes != NULL)
     {
         // Copy the bytes of the value to the bytes stack
-        memcpy(&(vd->bytes[vd->offset]), bytes, size);
+        copy_bytes(&(vd->bytes[vd->offset]), bytes, size, vd->workers, vd->release_gil);
         vd->offset += size;
     }
     
@@ -806,15 +1544,76 @@ static inline size_t bytes_to_size_t(const unsigned char *bytes, size_t length)
     return num;
 }
 
-// # The from-conversion functions
+// # Back-references
 
-static inline StatusCode from_string(ValueData *vd, PyObject *value) // VD is short for ValueData
-{
+/*
+  Payloads tend to repeat the same dict keys and enum-like strings over
+  and over. When back-references are enabled, every string of at least
+  REF_MIN_SIZE bytes gets the next index in a table the first time it's
+  written, and is written as a REF_1 or REF_2 datachar with that index
+  every time after that.
+
+  The table itself is never written. The decoder builds the same table by
+  adding every string of at least REF_MIN_SIZE bytes it converts, in the
+  same order, as strings are always converted in the order they're in
+  the bytes. Both sides stop adding strings once the table has REF_MAX
+  of them, so that every index fits in 2 bytes. The bytes start with the
+  REFS_M marker, so that the decoder knows to build the table.
+
+  The compact key runs of dicts with only string keys aren't written in
+  this mode, so that the keys go through the table as well.
+
+*/
+
+#define REF_MIN_SIZE 3     // Shorter strings are about as small as their reference
+#define REF_MAX      65536 // The max number of strings in the table, so that the indexes fit in 2 bytes
+
+// Write a reference to a string if it's in the table, or add it to the table. Returns SC_INCORRECT if the string should be written itself
+static inline StatusCode from_string_ref(ValueData *vd, PyObject *value)
+{
+    PyObject *index = PyDict_GetItemWithError(vd->refs, value);
+    if (index == NULL)
+    {
+        if (PyErr_Occurred()) return SC_EXCEPTION;
+
+        // Strings past the max aren't added, just like the decoder doesn't add them
+        Py_ssize_t num_refs = PyDict_GET_SIZE(vd->refs);
+        if (num_refs >= REF_MAX) return SC_INCORRECT;
+
+        index = PyLong_FromSsize_t(num_refs);
+        if (index == NULL) return SC_EXCEPTION;
+
+        int result = PyDict_SetItem(vd->refs, value, index);
+        Py_DECREF(index);
+
+        return result == -1 ? SC_EXCEPTION : SC_INCORRECT;
+    }
+
+    Py_ssize_t num = PyLong_AsSsize_t(index);
+    Py_ssize_t num_bytes = num < 256 ? 1 : 2;
+
+    if (auto_resize_vd(vd, 1 + num_bytes) == SC_NOMEMORY) return SC_NOMEMORY;
+
+    return write_metadata(vd, num_bytes == 1 ? REF_1 : REF_2, num, num_bytes);
+}
+
+// # The from-conversion functions
+
+static inline StatusCode from_string(ValueData *vd, PyObject *value) // VD is short for ValueData
+{
     if (!PyUnicode_Check(value)) return SC_INCORRECT;
     
     // Get the string as C bytes and get its size
     Py_ssize_t size;
     const char *bytes = PyUnicode_AsUTF8AndSize(value, &size);
+    if (bytes == NULL) return SC_EXCEPTION; // Strings with lone surrogates can't be encoded
+
+    // Write a reference instead if we've written the same string before
+    if (vd->refs != NULL && size >= REF_MIN_SIZE)
+    {
+        StatusCode status = from_string_ref(vd, value);
+        if (status != SC_INCORRECT) return status;
+    }
 
     // Write the data
     if (write_E12D(vd, size, (const unsigned char *)bytes, STR_E) == SC_NOMEMORY) return SC_NOMEMORY;
@@ -836,7 +1635,7 @@ static inline StatusCode from_integer(ValueData *vd, PyObject *value)
     if (!PyLong_Check(value)) return SC_INCORRECT;
 
     // Calculate number of bytes needed, including the sign bit
-    size_t num_bytes = Py_SIZE(value) > 0 ? (_PyLong_NumBits(value) + 8) / 8 : 1;
+    size_t num_bytes = Py_SIZE(value) != 0 ? (_PyLong_NumBits(value) + 8) / 8 : 1;
 
     // Determine datachar and dynamic length
     unsigned char datachar;
@@ -946,6 +1745,149 @@ static inline StatusCode from_boolean(ValueData *vd, PyObject *value)
     return SC_SUCCESS;
 }
 
+// # Out-of-band buffers
+
+/*
+  Large bytes, bytearrays and memoryviews can be written out-of-band,
+  to a shared memory segment of their own instead of to the bytes of
+  the value. The bytes then only hold an OOB_S datachar with the offset
+  and size of the buffer in the segment, and are wrapped in a PROT_OOB
+  frame that holds the name of the segment:
+
+    'PROT_OOB + NAME_LENGTH + NAME + PROT_D BYTES'
+
+  Converting the frame back maps the segment and creates the buffers as
+  read-only memoryviews of the mapping, so that they're never copied on
+  the receiving side. That's what makes it worth it for big buffers
+  that are passed between processes, as the bytes that are passed
+  around stay small no matter the size of the buffers.
+
+  Each conversion creates a single segment once it finds the first
+  buffer that's large enough, and grows it for the buffers after that.
+  The segment is only readable by our user, and starts with a header
+  that holds a magic number and the size of its buffers. The header is
+  written last, and both mapping and releasing a segment check it, so
+  that a frame can only ever name a complete segment of our own.
+  The segment outlives the bytes, as the receiver may be another
+  process, so it has to be released with 'release_oob_frame' once no
+  one needs the buffers anymore. Mappings that were already created
+  stay valid after that, until their memoryviews are gone.
+
+*/
+
+#define OOB_ALIGN 64 // The alignment of the buffers in the segment, so that they start at a cache line
+#define OOB_PREFIX "/sbs-oob-" // The prefix of the names of the segments
+#define OOB_MAGIC 0x31424f4f2d534253ULL // The magic number in the header of a segment, "SBS-OOB1"
+#define OOB_HEADER_SIZE OOB_ALIGN // The size reserved for the header, so that the first buffer stays aligned
+
+// The header at the start of a segment
+typedef struct {
+    uint64_t magic; // OOB_MAGIC, once every buffer was written
+    uint64_t size;  // The size of the segment, including the header
+} OOBHeader;
+
+// The number of segments created by this process, so that every segment gets a name of its own
+static unsigned long oob_counter = 0;
+
+// Create the segment of out-of-band buffers. Returns -1 with an error set on failure
+static int create_oob_segment(OOBSegment *oob)
+{
+    // Segments of other processes, or that weren't released by an earlier process with our pid, might already use the name
+    for (int attempt = 0; attempt < 16; attempt++)
+    {
+        snprintf(oob->name, sizeof(oob->name), OOB_PREFIX "%ld-%lu", (long)getpid(), oob_counter++);
+
+        oob->fd = shm_open(oob->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (oob->fd != -1 || errno != EEXIST) break;
+    }
+
+    if (oob->fd == -1)
+    {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+
+    // The buffers come after the header
+    oob->used = OOB_HEADER_SIZE;
+
+    return 0;
+}
+
+// Grow the segment so that it can hold at least `size` bytes. Returns -1 with an error set on failure
+static int grow_oob_segment(OOBSegment *oob, size_t size)
+{
+    size_t new_size = oob->size == 0 ? size : oob->size * 2;
+    if (new_size < size) new_size = size;
+
+    if (ftruncate(oob->fd, (off_t)new_size) == -1)
+    {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+
+    // The segment holds what we wrote to it, so map it again at its new size
+    unsigned char *bytes = (unsigned char *)mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, oob->fd, 0);
+    if (bytes == MAP_FAILED)
+    {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+
+    if (oob->bytes != NULL) munmap(oob->bytes, oob->size);
+
+    oob->bytes = bytes;
+    oob->size = new_size;
+
+    return 0;
+}
+
+// Close the segment, and remove it as well if `unlink` is set. Shrinks it to what was written to it otherwise
+static void close_oob_segment(OOBSegment *oob, int unlink)
+{
+    if (oob->fd == -1) return;
+
+    // The header goes in last, as it's what makes the segment valid to map
+    if (!unlink && oob->bytes != NULL)
+    {
+        OOBHeader header = {OOB_MAGIC, (uint64_t)oob->used};
+        memcpy(oob->bytes, &header, sizeof(header));
+    }
+
+    if (oob->bytes != NULL) munmap(oob->bytes, oob->size);
+    if (unlink) shm_unlink(oob->name);
+    // Shrinking it only saves memory, so it's fine if that fails
+    else if (oob->used < oob->size && ftruncate(oob->fd, (off_t)oob->used) == -1) errno = 0;
+
+    close(oob->fd);
+    oob->fd = -1;
+    oob->bytes = NULL;
+}
+
+// Write a buffer to the segment, and its OOB_S datachar to the bytes
+static inline StatusCode write_oob_buffer(ValueData *vd, const unsigned char *bytes, size_t size)
+{
+    OOBSegment *oob = vd->oob;
+    if (oob->fd == -1 && create_oob_segment(oob) == -1) return SC_EXCEPTION;
+
+    size_t offset = (oob->used + OOB_ALIGN - 1) & ~(size_t)(OOB_ALIGN - 1);
+    if (offset + size > oob->size && grow_oob_segment(oob, offset + size) == -1) return SC_EXCEPTION;
+
+    if (auto_resize_vd(vd, 17) == SC_NOMEMORY) return SC_NOMEMORY;
+
+    copy_bytes(&(oob->bytes[offset]), bytes, size, vd->workers, vd->release_gil);
+    oob->used = offset + size;
+
+    uint64_t location[2] = {(uint64_t)offset, (uint64_t)size};
+    vd->bytes[vd->offset] = OOB_S;
+    memcpy(&(vd->bytes[vd->offset + 1]), location, 16);
+    vd->offset += 17;
+
+    return SC_SUCCESS;
+}
+
+// Whether a buffer of `size` bytes should be written out-of-band
+#define IS_OOB(vd, size) ((vd)->oob != NULL && (size_t)(size) >= (vd)->oob->threshold)
+
 static inline StatusCode from_bytes(ValueData *vd, PyObject *value)
 {
     if (!PyBytes_Check(value)) return SC_INCORRECT;
@@ -961,6 +1903,9 @@ static inline StatusCode from_bytes(ValueData *vd, PyObject *value)
         return SC_EXCEPTION;
     }
 
+    // Write large bytes out-of-band if we're allowed to
+    if (IS_OOB(vd, size)) return write_oob_buffer(vd, (const unsigned char *)bytes, (size_t)size);
+
     // Write the data
     if (write_E12D(vd, size, (const unsigned char *)bytes, BYTES_E) == SC_NOMEMORY) return SC_NOMEMORY;
 
@@ -972,16 +1917,17 @@ static inline StatusCode from_bytearray(ValueData *vd, PyObject *value)
 {
     if (!PyByteArray_Check(value)) return SC_INCORRECT;
 
-    // Get the string as C bytes
-    const char *bytes = (const char *)PyByteArray_AsString(value);
-    // Get the size of the bytearray object
-    Py_ssize_t size = Py_SIZE(value);
+    // Hold the buffer of the bytearray, so that it can't be resized if the GIL is released while copying it
+    Py_buffer view;
+    if (PyObject_GetBuffer(value, &view, PyBUF_SIMPLE) == -1) return SC_EXCEPTION;
 
-    // Write the data
-    if (write_E12D(vd, size, (const unsigned char *)bytes, BYTEARR_E) == SC_NOMEMORY) return SC_NOMEMORY;
+    // Write the data, out-of-band if it's large enough and we're allowed to. The copy can release the GIL if this is the root value
+    vd->release_gil = vd->nests == 0;
+    StatusCode status = IS_OOB(vd, view.len) ? write_oob_buffer(vd, (const unsigned char *)view.buf, (size_t)view.len) : write_E12D(vd, view.len, (const unsigned char *)view.buf, BYTEARR_E);
+    vd->release_gil = 0;
 
-    // Return success
-    return SC_SUCCESS;
+    PyBuffer_Release(&view);
+    return status;
 }
 
 // Function for static values, like NoneType and Ellipsis
@@ -1126,19 +2072,13 @@ static inline StatusCode from_memoryview(ValueData *vd, PyObject *value)
         return SC_EXCEPTION;
     }
 
-    // Resize if necessary
-    if (auto_resize_vd(vd, 1 + view.len) == SC_NOMEMORY)
-    {
-        PyBuffer_Release(&view);
-        return SC_NOMEMORY;
-    }
-
-    // Write the data
-    if (write_E12D(vd, view.len, (const unsigned char *)view.buf, MEMVIEW_E) == SC_NOMEMORY) return SC_NOMEMORY;
+    // Write the data, out-of-band if it's large enough and we're allowed to. The copy can release the GIL if this is the root value
+    vd->release_gil = vd->nests == 0;
+    StatusCode status = IS_OOB(vd, view.len) ? write_oob_buffer(vd, (const unsigned char *)view.buf, (size_t)view.len) : write_E12D(vd, view.len, (const unsigned char *)view.buf, MEMVIEW_E);
+    vd->release_gil = 0;
 
     PyBuffer_Release(&view);
-
-    return SC_SUCCESS;
+    return status;
 }
 
 static inline StatusCode from_range(ValueData *vd, PyObject *value)
@@ -1189,6 +2129,235 @@ static inline StatusCode from_path(ValueData *vd, PyObject *value, const unsigne
     return SC_SUCCESS;
 }
 
+// # Functions for converting packed numeric values to bytes
+
+/*
+  Lists and tuples with only floats, only bools, or only ints that fit in
+  64 bits are common, and writing a datachar for each of their items wastes
+  a byte per item, plus a dispatch per item when converting them back. So,
+  once they hold at least PACKED_MIN_ITEMS items, they're written as a
+  single header followed by the raw items, like this:
+
+    [PACKED_S] [container] [typecode] [itemsize] [n] [n count bytes] [items]
+
+  The typecodes are those of the array module. Floats use 'd', bools use
+  '?', and ints use the smallest of 'b', 'h', 'i' and 'q' that fits all of
+  them. The items are in native byte order, just like the doubles of FLOAT_S.
+
+  Objects of the array module are written the same way with their own
+  typecode, which lets us copy their items without going over them.
+
+*/
+
+#define PACKED_MIN_ITEMS 8 // Below this, the header isn't worth it over the regular layout
+#define PACKED_CHUNK 4096  // The number of items to write per resize, so that streams can flush in between
+
+// The container kinds of packed values
+#define PACKED_LIST  0
+#define PACKED_TUPLE 1
+#define PACKED_ARRAY 2
+
+// Get the typecode and item size to pack the items with, or 0 if they can't be packed
+static inline char packed_typecode(PyObject **items, Py_ssize_t num_items, size_t *itemsize)
+{
+    if (num_items < PACKED_MIN_ITEMS) return 0;
+
+    // Only exact types, as subclasses wouldn't come back as themselves
+    PyTypeObject *type = Py_TYPE(items[0]);
+
+    if (type == &PyFloat_Type || type == &PyBool_Type)
+    {
+        for (Py_ssize_t i = 1; i < num_items; i++)
+            if (Py_TYPE(items[i]) != type) return 0;
+
+        *itemsize = type == &PyFloat_Type ? sizeof(double) : 1;
+        return type == &PyFloat_Type ? 'd' : '?';
+    }
+
+    if (type != &PyLong_Type) return 0;
+
+    // Get the range of the ints to pick the smallest item size
+    long long min = 0, max = 0;
+    for (Py_ssize_t i = 0; i < num_items; i++)
+    {
+        if (Py_TYPE(items[i]) != &PyLong_Type) return 0;
+
+        int overflow;
+        long long num = PyLong_AsLongLongAndOverflow(items[i], &overflow);
+        if (overflow != 0) return 0;
+
+        if (num < min) min = num;
+        if (num > max) max = num;
+    }
+
+    if (min >= INT8_MIN && max <= INT8_MAX)   { *itemsize = 1; return 'b'; }
+    if (min >= INT16_MIN && max <= INT16_MAX) { *itemsize = 2; return 'h'; }
+    if (min >= INT32_MIN && max <= INT32_MAX) { *itemsize = 4; return 'i'; }
+
+    *itemsize = 8;
+    return 'q';
+}
+
+// Get the byte of a bool item
+static inline unsigned char packed_bool(PyObject *item)
+{
+    return item == Py_True;
+}
+
+// Write the header of a packed value
+static inline StatusCode write_packed_header(ValueData *vd, const unsigned char container, char typecode, size_t itemsize, Py_ssize_t num_items)
+{
+    Py_ssize_t num_bytes = get_num_bytes(num_items);
+
+    if (auto_resize_vd(vd, 5 + num_bytes) == SC_NOMEMORY) return SC_NOMEMORY;
+
+    vd->bytes[vd->offset++] = PACKED_S;
+    vd->bytes[vd->offset++] = container;
+    vd->bytes[vd->offset++] = (unsigned char)typecode;
+    vd->bytes[vd->offset++] = (unsigned char)itemsize;
+
+    // The count, prefixed by the number of count bytes like the dynamic 1 method
+    vd->bytes[vd->offset++] = (unsigned char)num_bytes;
+    write_size_bytes(vd, num_items, num_bytes);
+
+    return SC_SUCCESS;
+}
+
+// Write the items from `start` up to `end` packed to `bytes`. Doesn't touch any refcounts, so it can run on the workers while the caller holds the GIL
+static void pack_items(PyObject **items, Py_ssize_t start, Py_ssize_t end, unsigned char *bytes, char typecode)
+{
+    // A plain loop per typecode, so that the compiler can unroll and vectorize them
+    #define PACK_ITEMS(ctype, convert) \
+        for (Py_ssize_t i = start; i < end; i++) \
+        { \
+            ctype num = (ctype)convert(items[i]); \
+            memcpy(&bytes[(i - start) * sizeof(ctype)], &num, sizeof(ctype)); \
+        } \
+        break;
+
+    switch (typecode)
+    {
+    case 'd': PACK_ITEMS(double, PyFloat_AS_DOUBLE)
+    case '?': PACK_ITEMS(unsigned char, packed_bool)
+    case 'b': PACK_ITEMS(int8_t, PyLong_AsLongLong)
+    case 'h': PACK_ITEMS(int16_t, PyLong_AsLongLong)
+    case 'i': PACK_ITEMS(int32_t, PyLong_AsLongLong)
+    default:  PACK_ITEMS(int64_t, PyLong_AsLongLong)
+    }
+
+    #undef PACK_ITEMS
+}
+
+#define PARALLEL_MIN_ITEMS (1 << 16) // The min number of items per worker to spread packing over the workers
+
+// Packing split into ranges of items, one per task
+typedef struct {
+    PyObject **items;
+    unsigned char *bytes;
+    Py_ssize_t num_items;
+    size_t itemsize;
+    char typecode;
+    int slices;
+} PackJob;
+
+static void pack_slice(void *arg, int index)
+{
+    PackJob *job = (PackJob *)arg;
+
+    // The last slice takes what's left
+    Py_ssize_t slice_items = job->num_items / job->slices;
+    Py_ssize_t start = index * slice_items;
+    Py_ssize_t end = index == job->slices - 1 ? job->num_items : start + slice_items;
+
+    pack_items(job->items, start, end, &(job->bytes[start * job->itemsize]), job->typecode);
+}
+
+// Try to write the items of a list or tuple packed. Returns SC_INCORRECT if they can't be packed, without writing anything
+static inline StatusCode from_packed(ValueData *vd, PyObject *value, const unsigned char container)
+{
+    Py_ssize_t num_items = PySequence_Fast_GET_SIZE(value);
+    PyObject **items = PySequence_Fast_ITEMS(value);
+
+    size_t itemsize;
+    char typecode = packed_typecode(items, num_items, &itemsize);
+    if (typecode == 0) return SC_INCORRECT;
+
+    if (write_packed_header(vd, container, typecode, itemsize, num_items) == SC_NOMEMORY) return SC_NOMEMORY;
+
+    // The items can't change as we go over them, as converting exact floats, bools and ints doesn't run any Python code, and we keep holding the GIL
+    Py_ssize_t workers = vd->workers < PARALLEL_MAX_WORKERS ? vd->workers : PARALLEL_MAX_WORKERS;
+    if (workers > num_items / PARALLEL_MIN_ITEMS) workers = num_items / PARALLEL_MIN_ITEMS;
+
+    // Without a stream to flush in between, pack large values by the workers all at once
+    if (workers > 1 && vd->stream == NULL)
+    {
+        if (auto_resize_vd(vd, num_items * itemsize) == SC_NOMEMORY) return SC_NOMEMORY;
+
+        PackJob job = {items, &(vd->bytes[vd->offset]), num_items, itemsize, typecode, (int)workers};
+        run_parallel(pack_slice, &job, (int)workers, (int)workers);
+
+        vd->offset += num_items * itemsize;
+        return SC_SUCCESS;
+    }
+
+    for (Py_ssize_t start = 0; start < num_items; start += PACKED_CHUNK)
+    {
+        Py_ssize_t end = num_items - start > PACKED_CHUNK ? start + PACKED_CHUNK : num_items;
+
+        if (auto_resize_vd(vd, (end - start) * itemsize) == SC_NOMEMORY) return SC_NOMEMORY;
+
+        pack_items(items, start, end, &(vd->bytes[vd->offset]), typecode);
+        vd->offset += (end - start) * itemsize;
+    }
+
+    return SC_SUCCESS;
+}
+
+static inline StatusCode from_array(ValueData *vd, PyObject *value)
+{
+    // Get the typecode to create the array with again
+    PyObject *typecode_obj = PyObject_GetAttrString(value, "typecode");
+    if (typecode_obj == NULL) return SC_EXCEPTION;
+
+    Py_ssize_t size;
+    const char *typecode = PyUnicode_AsUTF8AndSize(typecode_obj, &size);
+    if (typecode == NULL || size != 1)
+    {
+        Py_DECREF(typecode_obj);
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "Received an array with an invalid typecode.");
+        return SC_EXCEPTION;
+    }
+
+    char code = typecode[0];
+    Py_DECREF(typecode_obj);
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(value, &view, PyBUF_SIMPLE) == -1) return SC_EXCEPTION;
+
+    size_t itemsize = (size_t)view.itemsize;
+    Py_ssize_t num_items = view.len / view.itemsize;
+
+    StatusCode status = write_packed_header(vd, PACKED_ARRAY, code, itemsize, num_items);
+
+    // Copy the items in chunks when streaming so that the stream can flush in between, and in one go otherwise. The copies can release the GIL if this is the root value
+    vd->release_gil = vd->nests == 0;
+    Py_ssize_t chunk = vd->stream != NULL ? (Py_ssize_t)(PACKED_CHUNK * itemsize) : view.len;
+    for (Py_ssize_t start = 0; status == SC_SUCCESS && start < view.len; start += chunk)
+    {
+        Py_ssize_t length = view.len - start > chunk ? chunk : view.len - start;
+
+        if ((status = auto_resize_vd(vd, length)) != SC_SUCCESS) break;
+
+        copy_bytes(&(vd->bytes[vd->offset]), &(((const unsigned char *)view.buf)[start]), length, vd->workers, vd->release_gil);
+        vd->offset += length;
+    }
+
+    vd->release_gil = 0;
+    PyBuffer_Release(&view);
+
+    return status;
+}
+
 // # Functions for converting list type values to bytes and their helper functions
 
 // Pre-definition for the items in the iterables
@@ -1197,6 +2366,10 @@ static inline StatusCode from_any_value(ValueData *vd, PyObject *value);
 static inline StatusCode from_list(ValueData *vd, PyObject *value)
 {
     if (!PyList_Check(value)) return SC_INCORRECT;
+
+    // Write the items packed if they're all of the same numeric type
+    StatusCode packed = from_packed(vd, value, PACKED_LIST);
+    if (packed != SC_INCORRECT) return packed;
     
     // Increment the nest depth and return if it's too deep
     if (increment_nests(vd) == SC_NESTDEPTH) return SC_NESTDEPTH;
@@ -1226,6 +2399,10 @@ static inline StatusCode from_list(ValueData *vd, PyObject *value)
 static inline StatusCode from_tuple(ValueData *vd, PyObject *value)
 {
     // Already checked if it's a tuple
+
+    // Write the items packed if they're all of the same numeric type
+    StatusCode packed = from_packed(vd, value, PACKED_TUPLE);
+    if (packed != SC_INCORRECT) return packed;
     
     // Increment the nest depth and return if it's too deep
     if (increment_nests(vd) == SC_NESTDEPTH) return SC_NESTDEPTH;
@@ -1262,26 +2439,44 @@ static inline StatusCode from_iterable(ValueData *vd, PyObject *value, const uns
 
     // Increment the nest depth and return if it's too deep
     if (increment_nests(vd) == SC_NESTDEPTH) return SC_NESTDEPTH;
-    
-    // Create an iterator from the set so that we can count the items
-    PyObject *count_iter = PyObject_GetIter(value);
-    if (count_iter == NULL) return SC_INCORRECT;
-    
-    // This will hold the number of items in the iterator
-    Py_ssize_t num_items = 0;
 
-    // Quickly go over the iterator to get the number of items
-    while (PyIter_Next(count_iter) != NULL)
+    // Get the number of items without going over them, if we can
+    Py_ssize_t num_items = PyAnySet_Check(value) ? PySet_GET_SIZE(value) : PyObject_Size(value);
+
+    // This will hold the offset of the count to backpatch, 0 if we wrote the count upfront
+    Py_ssize_t count_offset = 0;
+
+    if (num_items >= 0)
     {
-        num_items++;
+        // Write the metadata
+        if (write_E12D(vd, num_items, NULL, empty) == SC_NOMEMORY) return SC_NOMEMORY;
     }
+    else
+    {
+        /*
+          The iterable doesn't have a length, so we reserve a fixed-width
+          count using the dynamic 1 method with 8 size bytes, and write the
+          actual count to it once we've gone over the items. The dynamic 1
+          method allows any length of size bytes, so this reads like any
+          other count.
 
-    Py_DECREF(count_iter);
+        */
 
-    // Write the metadata
-    if (write_E12D(vd, num_items, NULL, empty) == SC_NOMEMORY) return SC_NOMEMORY;
+        PyErr_Clear();
+
+        if (auto_resize_vd(vd, 2 + sizeof(uint64_t)) == SC_NOMEMORY) return SC_NOMEMORY;
+
+        // Keep the count in the buffer until we've backpatched it
+        vd->pins++;
+
+        vd->bytes[vd->offset++] = (const unsigned char)(empty + 3);
+        vd->bytes[vd->offset++] = (const unsigned char)sizeof(uint64_t);
+
+        count_offset = vd->offset;
+        vd->offset += sizeof(uint64_t);
+    }
 
-    // Get another iterator of the set to write the items
+    // Get an iterator to write the items
     PyObject *iter = PyObject_GetIter(value);
     if (iter == NULL)
     {
@@ -1290,20 +2485,51 @@ static inline StatusCode from_iterable(ValueData *vd, PyObject *value, const uns
     }
 
     // Go over the iterator and write the items
-    for (Py_ssize_t i = 0; i < num_items; i++)
+    Py_ssize_t written = 0;
+    PyObject *item;
+    while ((item = PyIter_Next(iter)) != NULL)
     {
-        // Get the item from the iterator
-        PyObject *item = PyIter_Next(iter);
+        // Stop if there are more items than we wrote as the count
+        if (count_offset == 0 && written == num_items)
+        {
+            Py_DECREF(item);
+            break;
+        }
+
         // Write it to the valuedata and get the status
         StatusCode status = from_any_value(vd, item);
         Py_DECREF(item);
 
         // Return the status code if it's not success
-        if (status != SC_SUCCESS) return status;
+        if (status != SC_SUCCESS)
+        {
+            Py_DECREF(iter);
+            return status;
+        }
+
+        written++;
     }
 
     Py_DECREF(iter);
 
+    // Check whether the iterator raised an error or changed size while we went over it
+    if (PyErr_Occurred()) return SC_EXCEPTION;
+    if (count_offset == 0 && written != num_items)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "An iterable changed size during serialization.");
+        return SC_EXCEPTION;
+    }
+
+    // Backpatch the count if we reserved it
+    if (count_offset != 0)
+    {
+        Py_ssize_t offset = vd->offset;
+        vd->offset = count_offset;
+        write_size_bytes(vd, written, sizeof(uint64_t));
+        vd->offset = offset;
+        vd->pins--;
+    }
+
     // Decrement the nest depth
     vd->nests--;
 
@@ -1345,50 +2571,46 @@ static inline StatusCode from_namedtuple(ValueData *vd, PyObject *value)
     return SC_SUCCESS;
 }
 
-// This function works for any dict type, so also with collections.OrderedDict for example
-static inline StatusCode from_dict_type(ValueData *vd, PyObject *value, const unsigned char empty)
+// Write the keys of a dict with only string keys as a compact run. Returns SC_INCORRECT if not all keys fit the run
+static inline StatusCode from_str_dict_keys(ValueData *vd, PyObject *value)
 {
-    if (!PyDict_Check(value)) return SC_INCORRECT;
-    
-    // Increment the nest depth and return if it's too deep
-    if (increment_nests(vd) == SC_NESTDEPTH) return SC_NESTDEPTH;
-
-    // Get the amount of item pairs in the dict
-    Py_ssize_t num_pairs = PyDict_Size(value);
+    /*
+      Every key in the run is written as a single size byte followed by
+      its UTF-8 bytes, instead of as a full string value with a datachar.
+      So, this only works for exact string keys shorter than 256 bytes.
 
-    // Write the metadata
-    if (write_E12D(vd, num_pairs, NULL, empty) == SC_NOMEMORY) return SC_NOMEMORY;
+    */
 
-    // Get the items of the dict in a list
-    PyObject *iter = PyDict_Items(value);
+    Py_ssize_t pos = 0;
+    PyObject *key, *val;
 
-    // Go over all items in the dict
-    for (Py_ssize_t i = 0; i < num_pairs; i++)
+    while (PyDict_Next(value, &pos, &key, &val))
     {
-        // Get the pair of the items, which is a tuple with the key on 0 and value on 1
-        PyObject *pair = PyList_GET_ITEM(iter, i);
+        if (!PyUnicode_CheckExact(key)) return SC_INCORRECT;
 
-        // Get the key and item from the pair tuple
-        PyObject *key = PyTuple_GET_ITEM(pair, 0);
-        PyObject *val = PyTuple_GET_ITEM(pair, 1);
+        Py_ssize_t size;
+        const char *bytes = PyUnicode_AsUTF8AndSize(key, &size);
 
-        // Write the key and item
-        StatusCode status;
-        if ((status = from_any_value(vd, key)) != SC_SUCCESS) return status;
-        if ((status = from_any_value(vd, val)) != SC_SUCCESS) return status;
-    }
+        if (bytes == NULL || size > 255)
+        {
+            PyErr_Clear();
+            return SC_INCORRECT;
+        }
 
-    Py_DECREF(iter);
+        if (auto_resize_vd(vd, 1 + size) == SC_NOMEMORY) return SC_NOMEMORY;
 
-    // Decrement the nest depth
-    vd->nests--;
+        vd->bytes[vd->offset++] = (unsigned char)size;
+        memcpy(&(vd->bytes[vd->offset]), bytes, size);
+        vd->offset += size;
+    }
 
     return SC_SUCCESS;
 }
 
-static inline StatusCode from_counter(ValueData *vd, PyObject *value)
+// This function works for any dict type, so also with collections.OrderedDict for example
+static inline StatusCode from_dict_type(ValueData *vd, PyObject *value, const unsigned char empty)
 {
-    if (!PyObject_IsInstance(value, counter_cl)) return SC_INCORRECT;
+    if (!PyDict_Check(value)) return SC_INCORRECT;
     
     // Increment the nest depth and return if it's too deep
     if (increment_nests(vd) == SC_NESTDEPTH) return SC_NESTDEPTH;
@@ -1396,29 +2618,144 @@ static inline StatusCode from_counter(ValueData *vd, PyObject *value)
     // Get the amount of item pairs in the dict
     Py_ssize_t num_pairs = PyDict_Size(value);
 
-    // Write the metadata
-    if (write_E12D(vd, num_pairs, NULL, COUNTER_E) == SC_NOMEMORY) return SC_NOMEMORY;
-
-    // Get the items of the dict in a list
-    PyObject *iter = PyDict_Items(value);
+    // OrderedDicts keep their own order, which isn't the order of the underlying dict
+    int ordered = empty == ODICT_E;
 
-    // Go over all items in the dict
-    for (Py_ssize_t i = 0; i < num_pairs; i++)
+    // Try to write the keys of regular dicts as a compact run first, unless they should go through the back-references
+    if (empty == DICT_E && num_pairs != 0 && vd->refs == NULL)
     {
-        // Get the items pair
-        PyObject *pair = PyList_GET_ITEM(iter, i);
+        // Keep the key run in the buffer until we know whether we have to go back to the start
+        vd->pins++;
+        Py_ssize_t start = vd->offset;
 
-        // Get the key and value from the pair tuple
-        PyObject *key = PyTuple_GET_ITEM(pair, 0);
-        PyObject *val = PyTuple_GET_ITEM(pair, 1);
+        if (write_E12D(vd, num_pairs, NULL, SDICT_E) == SC_NOMEMORY) return SC_NOMEMORY;
 
-        // Write the key and item
-        StatusCode status;
-        if ((status = from_any_value(vd, key)) != SC_SUCCESS) return status;
-        if ((status = from_integer(vd, val)) != SC_SUCCESS) return status; // The value can only be an integer in a counter
+        StatusCode status = from_str_dict_keys(vd, value);
+        vd->pins--;
+
+        if (status == SC_SUCCESS)
+        {
+            // Write the values in the same order as the keys
+            Py_ssize_t pos = 0, written = 0;
+            PyObject *key, *val;
+
+            while (PyDict_Next(value, &pos, &key, &val))
+            {
+                if ((status = from_any_value(vd, val)) != SC_SUCCESS) return status;
+                written++;
+            }
+
+            if (written != num_pairs)
+            {
+                PyErr_SetString(PyExc_RuntimeError, "A dict changed size during serialization.");
+                return SC_EXCEPTION;
+            }
+
+            vd->nests--;
+            return SC_SUCCESS;
+        }
+        else if (status != SC_INCORRECT) return status;
+
+        // Not all keys fit the run, so go back and write the dict as key-value pairs
+        vd->offset = start;
     }
 
-    Py_DECREF(iter);
+    // Write the metadata
+    if (write_E12D(vd, num_pairs, NULL, empty) == SC_NOMEMORY) return SC_NOMEMORY;
+
+    // This will hold the number of pairs we wrote
+    Py_ssize_t written = 0;
+    StatusCode status;
+
+    if (ordered)
+    {
+        // Iterate over the keys of OrderedDicts to get them in their own order
+        PyObject *iter = PyObject_GetIter(value);
+        if (iter == NULL) return SC_EXCEPTION;
+
+        PyObject *key;
+        while ((key = PyIter_Next(iter)) != NULL)
+        {
+            PyObject *val = PyDict_GetItemWithError(value, key);
+
+            // Write the key and item
+            status = val == NULL ? SC_EXCEPTION : from_any_value(vd, key);
+            if (status == SC_SUCCESS) status = from_any_value(vd, val);
+            Py_DECREF(key);
+
+            if (status != SC_SUCCESS)
+            {
+                Py_DECREF(iter);
+                return status;
+            }
+
+            written++;
+        }
+
+        Py_DECREF(iter);
+    }
+    else
+    {
+        // Go over all items in the dict, without creating any temporary objects for them
+        Py_ssize_t pos = 0;
+        PyObject *key, *val;
+
+        while (PyDict_Next(value, &pos, &key, &val))
+        {
+            // Write the key and item
+            if ((status = from_any_value(vd, key)) != SC_SUCCESS) return status;
+            if ((status = from_any_value(vd, val)) != SC_SUCCESS) return status;
+
+            written++;
+        }
+    }
+
+    // Check whether the iterator raised an error or the dict changed size while we went over it
+    if (PyErr_Occurred()) return SC_EXCEPTION;
+    if (written != num_pairs)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "A dict changed size during serialization.");
+        return SC_EXCEPTION;
+    }
+
+    // Decrement the nest depth
+    vd->nests--;
+
+    return SC_SUCCESS;
+}
+
+static inline StatusCode from_counter(ValueData *vd, PyObject *value)
+{
+    if (!PyObject_IsInstance(value, counter_cl)) return SC_INCORRECT;
+    
+    // Increment the nest depth and return if it's too deep
+    if (increment_nests(vd) == SC_NESTDEPTH) return SC_NESTDEPTH;
+
+    // Get the amount of item pairs in the dict
+    Py_ssize_t num_pairs = PyDict_Size(value);
+
+    // Write the metadata
+    if (write_E12D(vd, num_pairs, NULL, COUNTER_E) == SC_NOMEMORY) return SC_NOMEMORY;
+
+    // Go over all items in the dict, without creating any temporary objects for them
+    Py_ssize_t pos = 0, written = 0;
+    PyObject *key, *val;
+
+    while (PyDict_Next(value, &pos, &key, &val))
+    {
+        // Write the key and item
+        StatusCode status;
+        if ((status = from_any_value(vd, key)) != SC_SUCCESS) return status;
+        if ((status = from_integer(vd, val)) != SC_SUCCESS) return status; // The value can only be an integer in a counter
+
+        written++;
+    }
+
+    if (written != num_pairs)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "A dict changed size during serialization.");
+        return SC_EXCEPTION;
+    }
 
     // Decrement the nest depth
     vd->nests--;
@@ -1459,132 +2796,236 @@ static inline StatusCode from_chainmap(ValueData *vd, PyObject *value)
 
 // # The main from-value conversion functions
 
-static inline StatusCode from_any_value(ValueData *vd, PyObject *value)
+// Get the kind of conversion for a value of a type that's not in the type table, by its type name
+static inline TypeKind name_type_kind(PyObject *value)
 {
-    //printf("Typename: %s\n", Py_TYPE(value)->tp_name); // Print for getting the typename when adding new datatypes
-
-    // Check for NULL values
-    if (value == NULL)
-    {
-        return from_static_value(vd, NULL_S);
-    }
     // Check for special types that stand under tuples and types
-    else if (PyTuple_Check(value))
+    if (PyTuple_Check(value))
     {
-        // Check if it's an actual tuple
-        if (PyTuple_CheckExact(value))
-            return from_tuple(vd, value);
-        
         // Check if it has the fields attribute of a namedtuple
-        else if (PyObject_HasAttrString(value, "_fields"))
-            return from_namedtuple(vd, value);
+        if (PyObject_HasAttrString(value, "_fields"))
+            return TK_NAMEDTUPLE;
         
         // Unsupported tuple type
-        else return SC_UNSUPPORTED;
+        else return TK_UNKNOWN;
     }
-    else
-    {
-        // Get the datatype of the value
-        const char *datatype = Py_TYPE(value)->tp_name;
-        // Get the first character of the datatype
-        const char datachar = *datatype;
 
-        switch (datachar)
-        {
-        case 's': // String | Set
+    // Get the datatype of the value
+    const char *datatype = Py_TYPE(value)->tp_name;
+    // Get the first character of the datatype
+    const char datachar = *datatype;
+
+    switch (datachar)
+    {
+    case 's': // String | Set
+    {
+        // Check the 2nd character
+        switch (datatype[1])
         {
-            // Check the 2nd character
-            switch (datatype[1])
-            {
-            case 't': return from_string(vd, value);
-            case 'e': return from_iterable(vd, value, SET_E, (PyObject *)&PySet_Type);
-            default:  return SC_INCORRECT;
-            }
+        case 't': return TK_STRING;
+        case 'e': return TK_SET;
+        default:  return TK_INCORRECT;
         }
-        case 'i': return from_integer(vd, value);
-        case 'f':
+    }
+    case 'i': return TK_INTEGER;
+    case 'f':
+    {
+        switch (datatype[1])
         {
-            switch (datatype[1])
-            {
-            case 'l': return from_float(vd, value);
-            case 'r': return from_iterable(vd, value, FSET_E, (PyObject *)&PyFrozenSet_Type);
-            }
+        case 'l': return TK_FLOAT;
+        case 'r': return TK_FROZENSET;
         }
-        return from_float(vd, value);
-        case 'c': // Complex | Collections types
+    }
+    return TK_FLOAT;
+    case 'c': // Complex | Collections types
+    {
+        // Check if the datatype starts with 'collections'
+        if (strncmp(datatype, "collections.", strlen("collections.")) == 0)
         {
-            // Check if the datatype starts with 'collections'
-            if (strncmp(datatype, "collections.", strlen("collections.")) == 0)
+            // It's an item from the collections module. Switch over the first character that comes after the "collections." (idx 12)
+            const char new_datachar = datatype[12];
+            switch (new_datachar)
             {
-                // It's an item from the collections module. Switch over the first character that comes after the "collections." (idx 12)
-                const char new_datachar = datatype[12];
-                switch (new_datachar)
-                {
-                case 'd': return from_iterable(vd, value, DEQUE_E, deque_cl);
-                case 'O': return from_dict_type(vd, value, ODICT_E);
-                default:  return SC_UNSUPPORTED;
-                }
+            case 'd': return TK_DEQUE;
+            case 'O': return TK_ODICT;
+            default:  return TK_UNKNOWN;
             }
-            else return from_complex(vd, value);
         }
-        case 'b': // Boolean | bytes | bytearray (all start with a 'b')
+        else return TK_COMPLEX;
+    }
+    case 'b': // Boolean | bytes | bytearray (all start with a 'b')
+    {
+        // Check the 2nd datachar
+        switch (datatype[1])
         {
-            // Check the 2nd datachar
-            switch (datatype[1])
-            {
-            case 'o': return from_boolean(vd, value);
-            default:
-            {
-                // Check the 5th datachar because the 2nd, 3rd, and 4th are the same
-                switch (datatype[4])
-                {
-                case 's': return from_bytes(vd, value);
-                case 'a': return from_bytearray(vd, value);
-                default:  return SC_INCORRECT;
-                }
-            }
-            }
-        }
-        case 'N': return from_static_value(vd, NONE_S);
-        case 'e': return from_static_value(vd, ELLIPSIS_S);
-        case 'd': // DateTime objects | Decimal | Dict
+        case 'o': return TK_BOOLEAN;
+        default:
         {
-            switch (datatype[1])
+            // Check the 5th datachar because the 2nd, 3rd, and 4th are the same
+            switch (datatype[4])
             {
-            case 'a': return from_datetime(vd, value, datatype);
-            case 'e': return from_decimal(vd, value);
-            case 'i': return from_dict_type(vd, value, DICT_E);
-            default:  return SC_INCORRECT;
+            case 's': return TK_BYTES;
+            case 'a': return TK_BYTEARRAY;
+            default:  return TK_INCORRECT;
             }
         }
-        case 'U': return from_uuid(vd, value);
-        case 'm': return from_memoryview(vd, value);
-        case 'l': return from_list(vd, value);
-        case 'r': return from_range(vd, value);
-        case 'C':
+        }
+    }
+    case 'N': return TK_NONE;
+    case 'e': return TK_ELLIPSIS;
+    case 'd': // DateTime objects | Decimal | Dict
+    {
+        switch (datatype[1])
         {
-            switch (datatype[1])
-            {
-            case 'o': return from_counter(vd, value);
-            case 'h': return from_chainmap(vd, value);
-            default:  return SC_INCORRECT;
-            }
+        case 'a': return TK_DATETIME;
+        case 'e': return TK_DECIMAL;
+        case 'i': return TK_DICT;
+        default:  return TK_INCORRECT;
         }
-        case 'P':
+    }
+    case 'U': return TK_UUID;
+    case 'm': return TK_MEMORYVIEW;
+    case 'l': return TK_LIST;
+    case 'r': return TK_RANGE;
+    case 'C':
+    {
+        switch (datatype[1])
         {
-            switch (datatype[1])
-            {
-            case 'u': return from_path(vd, value, PPATH_E); // PurePosixPath | PureWindowsPath
-            case 'o': return from_path(vd, value, PATH_E);  // PosixPath
-            }
+        case 'o': return TK_COUNTER;
+        case 'h': return TK_CHAINMAP;
+        default:  return TK_INCORRECT;
         }
-        case 'W': return from_path(vd, value, PATH_E); // WindowsPath
-        default:  return SC_UNSUPPORTED;
+    }
+    case 'P':
+    {
+        switch (datatype[1])
+        {
+        case 'u': return TK_PUREPATH; // PurePosixPath | PureWindowsPath
+        case 'o': return TK_PATH;     // PosixPath
         }
     }
+    case 'W': return TK_PATH; // WindowsPath
+    default:  return TK_UNKNOWN;
+    }
 }
 
-PyObject *from_value(PyObject *value)
+static inline StatusCode from_any_value(ValueData *vd, PyObject *value)
+{
+    //printf("Typename: %s\n", Py_TYPE(value)->tp_name); // Print for getting the typename when adding new datatypes
+
+    // Check for NULL values
+    if (value == NULL)
+    {
+        return from_static_value(vd, NULL_S);
+    }
+
+    // Use the conversion registered for the exact type, and fall back to the type name for subclasses
+    TypeKind kind = lookup_type_kind(Py_TYPE(value));
+    if (kind == TK_UNKNOWN) kind = name_type_kind(value);
+
+    switch (kind)
+    {
+    case TK_STRING:     return from_string(vd, value);
+    case TK_INTEGER:    return from_integer(vd, value);
+    case TK_FLOAT:      return from_float(vd, value);
+    case TK_COMPLEX:    return from_complex(vd, value);
+    case TK_BOOLEAN:    return from_boolean(vd, value);
+    case TK_BYTES:      return from_bytes(vd, value);
+    case TK_BYTEARRAY:  return from_bytearray(vd, value);
+    case TK_NONE:       return from_static_value(vd, NONE_S);
+    case TK_ELLIPSIS:   return from_static_value(vd, ELLIPSIS_S);
+    case TK_LIST:       return from_list(vd, value);
+    case TK_TUPLE:      return from_tuple(vd, value);
+    case TK_NAMEDTUPLE: return from_namedtuple(vd, value);
+    case TK_DICT:       return from_dict_type(vd, value, DICT_E);
+    case TK_SET:        return from_iterable(vd, value, SET_E, (PyObject *)&PySet_Type);
+    case TK_FROZENSET:  return from_iterable(vd, value, FSET_E, (PyObject *)&PyFrozenSet_Type);
+    case TK_RANGE:      return from_range(vd, value);
+    case TK_MEMORYVIEW: return from_memoryview(vd, value);
+    case TK_DATETIME:   return from_datetime(vd, value, Py_TYPE(value)->tp_name);
+    case TK_DECIMAL:    return from_decimal(vd, value);
+    case TK_UUID:       return from_uuid(vd, value);
+    case TK_DEQUE:      return from_iterable(vd, value, DEQUE_E, deque_cl);
+    case TK_ODICT:      return from_dict_type(vd, value, ODICT_E);
+    case TK_COUNTER:    return from_counter(vd, value);
+    case TK_CHAINMAP:   return from_chainmap(vd, value);
+    case TK_PATH:       return from_path(vd, value, PATH_E);
+    case TK_PUREPATH:   return from_path(vd, value, PPATH_E);
+    case TK_ARRAY:      return from_array(vd, value);
+    case TK_INCORRECT:  return SC_INCORRECT;
+    default:            return SC_UNSUPPORTED;
+    }
+}
+
+// Function to set the error that belongs to a status code
+static inline void set_status_error(StatusCode status)
+{
+    // Check what error we encountered
+    switch (status)
+    {
+    case SC_INCORRECT:
+    case SC_UNSUPPORTED:
+    {
+        // Incorrect datatype, likely an unsupported one
+        PyErr_SetString(PyExc_ValueError, "Received an unsupported datatype.");
+        break;
+    }
+    case SC_NESTDEPTH:
+    {
+        // Exceeded the maximum nest depth
+        PyErr_SetString(PyExc_ValueError, "Exceeded the maximum value nest depth.");
+        break;
+    }
+    case SC_NOMEMORY:
+    {
+        // Not enough memory, unless a target already set a more specific error when growing
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_MemoryError, "Not enough memory space available for use.");
+        break;
+    }
+    case SC_EXCEPTION: break; // Error message is set by the returner
+    default:
+    {
+        // Something unknown went wrong
+        PyErr_SetString(PyExc_RuntimeError, "Something unexpected went wrong, and we couldn't quite catch what it was.");
+        break;
+    }
+    }
+}
+
+// Write the value after the protocol marker, with back-references if `refs` is set
+static inline StatusCode write_root(ValueData *vd, PyObject *value, int refs)
+{
+    // Write the NULL datachar for NULL values
+    if (value == NULL) return from_static_value(vd, NULL_S);
+
+    StatusCode status;
+    if (!refs) status = from_any_value(vd, value);
+    else
+    {
+        // Mark that the value holds back-references, and create the table for them
+        status = from_static_value(vd, REFS_M);
+        if (status != SC_SUCCESS) return status;
+
+        vd->refs = PyDict_New();
+        if (vd->refs == NULL) return SC_EXCEPTION;
+
+        status = from_any_value(vd, value);
+        Py_CLEAR(vd->refs);
+    }
+
+    // Count what was written, including what was already flushed when streaming
+    if (status == SC_SUCCESS)
+    {
+        COUNT_STAT(encodes, 1);
+        COUNT_STAT(bytes_out, vd->flushed + vd->offset);
+    }
+
+    return status;
+}
+
+// Convert a value to bytes, writing large buffers to the segment if it's not NULL
+static PyObject *from_value_segment(PyObject *value, size_t size_hint, int refs, int workers, OOBSegment *oob)
 {
     // Check if the value is NULL
     if (value == NULL)
@@ -1596,123 +3037,307 @@ PyObject *from_value(PyObject *value)
 
     // Initiate the ValueData
     StatusCode vd_status;
-    ValueData vd = init_vd(value, &vd_status);
+    ValueData vd = init_vd(value, size_hint, &vd_status);
 
     // Return on status error
-    if (vd_status == SC_EXCEPTION)
-        // Exception already set
+    if (vd_status != SC_SUCCESS)
+    {
+        set_status_error(vd_status);
         return NULL;
+    }
 
     // Write the value and get the status
-    StatusCode status = from_any_value(&vd, value);
+    vd.workers = workers;
+    vd.oob = oob;
+    StatusCode status = write_root(&vd, value, refs);
 
     // Check the status and throw an appropriate error if not success
     if (status == SC_SUCCESS)
     {
+        // Wrap the bytes in a frame with the name of the segment if any buffers were written to it
+        size_t name_length = oob != NULL && oob->fd != -1 ? strlen(oob->name) : 0;
+        size_t header_size = name_length == 0 ? 0 : 2 + name_length;
+
         // Convert it to a Python bytes object
-        PyObject *py_bytes = PyBytes_FromStringAndSize((const char *)(vd.bytes), vd.offset);
-        free(vd.bytes);
+        PyObject *py_bytes = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)header_size + vd.offset);
+        if (py_bytes != NULL)
+        {
+            unsigned char *bytes = (unsigned char *)PyBytes_AS_STRING(py_bytes);
+            if (header_size != 0)
+            {
+                bytes[0] = PROT_OOB;
+                bytes[1] = (unsigned char)name_length;
+                memcpy(&(bytes[2]), oob->name, name_length);
+            }
+
+            copy_bytes(&(bytes[header_size]), vd.bytes, (size_t)vd.offset, workers, 1);
+        }
+
+        return_scratch(vd.bytes, (size_t)vd.max_size);
         return py_bytes;
     }
     else
     {
-        free(vd.bytes);
-        // Check what error we encountered
-        switch (status)
-        {
-        case SC_INCORRECT:
-        case SC_UNSUPPORTED:
-        {
-            // Incorrect datatype, likely an unsupported one
-            PyErr_SetString(PyExc_ValueError, "Received an unsupported datatype.");
-            break;
-        }
-        case SC_NESTDEPTH:
-        {
-            // Exceeded the maximum nest depth
-            PyErr_SetString(PyExc_ValueError, "Exceeded the maximum value nest depth.");
-            break;
-        }
-        case SC_NOMEMORY:
-        {
-            // Not enough memory
-            PyErr_SetString(PyExc_MemoryError, "Not enough memory space available for use.");
-            break;
-        }
-        case SC_EXCEPTION: break; // Error message is set by the returner
-        default:
-        {
-            // Something unknown went wrong
-            PyErr_SetString(PyExc_RuntimeError, "Something unexpected went wrong, and we couldn't quite catch what it was.");
-            break;
-        }
-        }
-
+        return_scratch(vd.bytes, (size_t)vd.max_size);
+        set_status_error(status);
         return NULL;
     }
 }
 
-// # Helper functions for the to-conversion functions
-
-// This struct holds the bytes and its current offset
-typedef struct {
-    size_t offset;
-    size_t max_offset;
-    const unsigned char *bytes;
-} ByteData;
+PyObject *from_value_sized(PyObject *value, size_t size_hint, int refs, int workers)
+{
+    return from_value_segment(value, size_hint, refs, workers, NULL);
+}
 
-// Function to check whether the offset is still correct after going up by argument 'jump'. Returns -1 on failure
-static inline int ensure_offset(ByteData *bd, size_t jump)
+PyObject *from_value_oob(PyObject *value, size_t size_hint, int refs, int workers, size_t threshold)
 {
-    /*
-      This function will be used in all to-conversion functions to ensure the
-      max offset is not exceeded. It'll be used like this:
+    if (threshold == 0) return from_value_segment(value, size_hint, refs, workers, NULL);
 
-      `if (ensure_offset(bd, n) == -1) return NULL;`
+    OOBSegment oob = {threshold, -1};
+    PyObject *result = from_value_segment(value, size_hint, refs, workers, &oob);
 
-      Where `n` is the amount of bytes we will attempt to read later, the 'jump'.
+    // The segment stays around for whoever converts the bytes back, unless we failed to create them
+    close_oob_segment(&oob, result == NULL);
+
+    return result;
+}
+
+PyObject *from_value(PyObject *value)
+{
+    return from_value_sized(value, 0, 0, 1);
+}
+
+Py_ssize_t dump_value(PyObject *value, PyObject *file, size_t chunk_size, int refs)
+{
+    /*
+      This writes the value to the file in chunks of the given size, by
+      flushing the buffer whenever it's full instead of growing it. The
+      buffer only grows past the chunk size while we might still go back
+      to bytes we've written, or for values that have to be written in one
+      piece, so the memory used stays around the chunk size.
 
     */
 
-    // Check whether the offset plus the jump exceeds the max offset
-    if (bd->offset + jump > bd->max_offset)
+    if (chunk_size < ALLOC_SIZE) chunk_size = ALLOC_SIZE;
+
+    ValueData vd = {1, (Py_ssize_t)chunk_size, 0, (unsigned char *)malloc(chunk_size), NULL, file, 0, 0};
+    if (vd.bytes == NULL)
     {
-        // Set an error and return -1
-        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: offset exceeded max limit.");
+        set_status_error(SC_NOMEMORY);
         return -1;
     }
-    else
+
+    // Write the protocol byte
+    vd.bytes[0] = PROT_D;
+
+    // Write the value, or the NULL datachar for NULL values, and flush what's left
+    StatusCode status = write_root(&vd, value, refs);
+    if (status == SC_SUCCESS && flush_vd(&vd) == -1) status = SC_EXCEPTION;
+
+    free(vd.bytes);
+
+    if (status != SC_SUCCESS)
     {
-        // Return 1 to state nothing is wrong
-        return 1;
+        set_status_error(status);
+        return -1;
     }
+
+    // Return the number of bytes we wrote
+    return vd.flushed;
 }
 
-// Function for getting the size byte length of the dynamic 1 method
-static inline size_t D1_length(ByteData *bd)
+Py_ssize_t from_value_into(PyObject *value, SBSTarget *target, int refs)
 {
-    // Ensure offset for the first size byte
-    if (ensure_offset(bd, 1) == -1) return 0;
+    /*
+      This function writes the bytes directly to a target supplied by the
+      caller, like a mapped shared memory segment, instead of to our own
+      allocation. That saves copying the bytes over afterwards. The target
+      is grown through its grow function whenever we run out of space.
 
-    // Get the length of the length bytes from the 1st character away from the offset
-    size_t size_bytes_length = bytes_to_size_t(&(bd->bytes[++bd->offset]), 1);
-    return size_bytes_length;
-}
+    */
 
-// Function for getting the size byte length of the dynamic 2 method
-static inline size_t D2_length(ByteData *bd)
-{
-    // Ensure offset for the first size byte
-    if (ensure_offset(bd, 1) == -1) return 0;
+    // Make sure the target can at least hold the protocol marker
+    if (target->size < 1 && target->grow(target, ALLOC_SIZE) == -1)
+    {
+        set_status_error(SC_NOMEMORY);
+        return -1;
+    }
 
-    // Get the length of the length of the length bytes (sounds complicated, but explained in 'write_E12D' function)
-    size_t length = bytes_to_size_t(&(bd->bytes[++bd->offset]), 1);
+    // Create the ValueData around the target
+    ValueData vd = {1, (Py_ssize_t)target->size, 0, target->bytes, target};
 
-    // Ensure the offset for the 2nd size bytes
-    if (ensure_offset(bd, length) == -1) return 0;
+    // Write the protocol byte
+    vd.bytes[0] = PROT_D;
 
-    // Get the length of the length bytes
-    size_t size_bytes_length = bytes_to_size_t(&(bd->bytes[++bd->offset]), length);
+    // Write the value, or the NULL datachar for NULL values
+    StatusCode status = write_root(&vd, value, refs);
+
+    if (status != SC_SUCCESS)
+    {
+        set_status_error(status);
+        return -1;
+    }
+
+    // Return the number of bytes we wrote
+    return vd.offset;
+}
+
+// # Helper functions for the to-conversion functions
+
+// A file to read the bytes from on demand, instead of having them all in memory
+typedef struct {
+    PyObject *file;
+    unsigned char *buffer; // The window of bytes read from the file
+    size_t capacity;       // The allocated size of the buffer
+} ByteStream;
+
+// This struct holds the bytes and its current offset
+typedef struct {
+    size_t offset;
+    size_t max_offset;
+    const unsigned char *bytes;
+    ByteStream *stream; // The stream to read more bytes from once we reach the max offset, or NULL if we have all bytes
+    PyObject *refs; // The list of strings that back-references point to, or NULL if the bytes don't hold back-references
+    int workers; // The number of threads to spread large copies and packing over, see copy_bytes and from_packed
+    PyObject *oob; // A memoryview of the segment of out-of-band buffers, or NULL if the bytes aren't an out-of-band frame
+} ByteData;
+
+// Read more bytes from the stream so that the jump fits, dropping the ones before the offset. Returns -1 on failure
+static int fill_bd(ByteData *bd, size_t jump)
+{
+    /*
+      The to-conversion functions only ever read from the offset onwards,
+      and don't hold on to pointers into the bytes across calls to
+      `ensure_offset`, so we can move the bytes we still need to the start
+      of the buffer and fill it up behind them.
+
+    */
+
+    ByteStream *stream = bd->stream;
+
+    size_t kept = bd->max_offset - bd->offset;
+    memmove(stream->buffer, &(stream->buffer[bd->offset]), kept);
+    bd->offset = 0;
+    bd->max_offset = kept;
+
+    bd->bytes = stream->buffer;
+
+    // Fill up the buffer as far as the file lets us, until the jump fits
+    while (bd->max_offset < jump)
+    {
+        // Grow the buffer as the bytes come in instead of to the jump at once, as the jump comes from the bytes too, and the stream might not hold that many
+        if (bd->max_offset == stream->capacity)
+        {
+            size_t capacity = jump - stream->capacity < stream->capacity ? jump : stream->capacity * 2;
+            unsigned char *buffer = (unsigned char *)realloc(stream->buffer, capacity);
+            if (buffer == NULL)
+            {
+                PyErr_NoMemory();
+                return -1;
+            }
+
+            stream->buffer = buffer;
+            stream->capacity = capacity;
+            bd->bytes = buffer;
+        }
+
+        PyObject *chunk = PyObject_CallMethod(stream->file, "read", "n", (Py_ssize_t)(stream->capacity - bd->max_offset));
+        if (chunk == NULL) return -1;
+
+        Py_buffer view;
+        if (PyObject_GetBuffer(chunk, &view, PyBUF_SIMPLE) == -1)
+        {
+            Py_DECREF(chunk);
+            return -1;
+        }
+
+        size_t length = (size_t)view.len;
+        if (length > stream->capacity - bd->max_offset) length = stream->capacity - bd->max_offset;
+
+        memcpy(&(stream->buffer[bd->max_offset]), view.buf, length);
+        bd->max_offset += length;
+
+        PyBuffer_Release(&view);
+        Py_DECREF(chunk);
+
+        if (length == 0)
+        {
+            PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: the stream ended before the value did.");
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+// Function to check whether the offset is still correct after going up by argument 'jump'. Returns -1 on failure
+static inline int ensure_offset(ByteData *bd, size_t jump)
+{
+    /*
+      This function will be used in all to-conversion functions to ensure the
+      max offset is not exceeded. It'll be used like this:
+
+      `if (ensure_offset(bd, n) == -1) return NULL;`
+
+      Where `n` is the amount of bytes we will attempt to read later, the 'jump'.
+
+    */
+
+    // Check whether the offset plus the jump exceeds the max offset, without overflowing on absurd jumps
+    if (jump > bd->max_offset - bd->offset)
+    {
+        // Read more bytes if we're reading from a stream
+        if (bd->stream != NULL) return fill_bd(bd, jump);
+
+        // Set an error and return -1
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: offset exceeded max limit.");
+        return -1;
+    }
+    else
+    {
+        // Return 1 to state nothing is wrong
+        return 1;
+    }
+}
+
+// Check whether there are enough bytes left for `num_items` items, as every item takes at least one. Streams read that far ahead, so that we never allocate for more items than they hold
+static inline int ensure_items(ByteData *bd, size_t num_items)
+{
+    // The arrays of the items have to fit in memory too, without the size overflowing
+    if (num_items > PY_SSIZE_T_MAX / sizeof(PyObject *))
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: item count too large.");
+        return -1;
+    }
+
+    return ensure_offset(bd, num_items);
+}
+
+// Function for getting the size byte length of the dynamic 1 method
+static inline size_t D1_length(ByteData *bd)
+{
+    // Ensure offset for the datachar and the first size byte
+    if (ensure_offset(bd, 2) == -1) return 0;
+
+    // Get the length of the length bytes from the 1st character away from the offset
+    size_t size_bytes_length = bytes_to_size_t(&(bd->bytes[++bd->offset]), 1);
+    return size_bytes_length;
+}
+
+// Function for getting the size byte length of the dynamic 2 method
+static inline size_t D2_length(ByteData *bd)
+{
+    // Ensure offset for the datachar and the first size byte
+    if (ensure_offset(bd, 2) == -1) return 0;
+
+    // Get the length of the length of the length bytes (sounds complicated, but explained in 'write_E12D' function)
+    size_t length = bytes_to_size_t(&(bd->bytes[++bd->offset]), 1);
+
+    // Ensure the offset for the first size byte and the 2nd size bytes
+    if (ensure_offset(bd, length + 1) == -1) return 0;
+
+    // Get the length of the length bytes
+    size_t size_bytes_length = bytes_to_size_t(&(bd->bytes[++bd->offset]), length);
 
     // Update the offset to start at the value bytes
     bd->offset += length - 1;
@@ -1720,6 +3345,84 @@ static inline size_t D2_length(ByteData *bd)
     return size_bytes_length;
 }
 
+// Read the header of a packed value, leaving the offset at the first item. Returns -1 on failure
+static inline int read_packed_header(ByteData *bd, unsigned char *container, char *typecode, size_t *itemsize, size_t *num_items)
+{
+    // Ensure offset for the datachar, the container, typecode and item size, and the number of count bytes
+    if (ensure_offset(bd, 5) == -1) return -1;
+
+    size_t num_bytes = bd->bytes[bd->offset + 4];
+    if (num_bytes > sizeof(size_t))
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: size header too long.");
+        return -1;
+    }
+
+    if (ensure_offset(bd, 5 + num_bytes) == -1) return -1;
+
+    *container = bd->bytes[bd->offset + 1];
+    *typecode = (char)bd->bytes[bd->offset + 2];
+    *itemsize = bd->bytes[bd->offset + 3];
+    *num_items = bytes_to_size_t(&(bd->bytes[bd->offset + 5]), num_bytes);
+    bd->offset += 5 + num_bytes;
+
+    // Check whether the items fit the bytes, without overflowing on absurd counts
+    if (*itemsize == 0 || *num_items > SIZE_MAX / *itemsize)
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid packed item size.");
+        return -1;
+    }
+
+    return ensure_offset(bd, *num_items * *itemsize);
+}
+
+// Check whether the bytes are all ASCII, going over them a word at a time
+static inline int is_ascii(const unsigned char *bytes, size_t length)
+{
+    /*
+      This ORs the bytes together in words of 8 bytes, and checks whether
+      any of them has the high bit set. The inner loop has no branches, so
+      the compiler vectorizes it, and we only check for a non-ASCII byte
+      once per block to still stop early on those.
+
+    */
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        uint64_t bits = 0;
+        for (size_t j = 0; j < 32; j += 8)
+        {
+            uint64_t word;
+            memcpy(&word, &bytes[i + j], sizeof(uint64_t));
+            bits |= word;
+        }
+
+        if (bits & 0x8080808080808080ull) return 0;
+    }
+
+    unsigned char bits = 0;
+    for (; i < length; i++) bits |= bytes[i];
+
+    return (bits & 0x80) == 0;
+}
+
+// Decode UTF-8 bytes to a string, without validating every character of ASCII ones. Not inlined, to keep 'to_any_value' small
+static __attribute__((noinline)) PyObject *decode_str(const unsigned char *bytes, size_t length)
+{
+    // Single characters are cached by the UTF-8 decoder, so let it handle those
+    if (length <= 1 || !is_ascii(bytes, length))
+        return PyUnicode_DecodeUTF8((const char *)bytes, (Py_ssize_t)length, "strict");
+
+    // ASCII bytes are the exact data of a compact ASCII string
+    PyObject *value = PyUnicode_New((Py_ssize_t)length, 127);
+    if (value == NULL) return NULL;
+
+    memcpy(PyUnicode_1BYTE_DATA(value), bytes, length);
+
+    return value;
+}
+
 // # The to-conversion functions
 
 // Pre-definition of the global conversion function to use it in to-conversion functions
@@ -1747,20 +3450,61 @@ static inline PyObject *to_str_gen(ByteData *bd, size_t size_bytes_length)
 
     if (ensure_offset(bd, length) == -1) return NULL;
 
-    // Copy the value bytes into a PyBytes object
-    PyObject *item_bytes = PyBytes_FromStringAndSize((const char *)(&(bd->bytes[bd->offset])), length);
+    // Decode straight from the bytes
+    PyObject *value = decode_str(&(bd->bytes[bd->offset]), length);
 
     // Update the offset to start at the next item
     bd->offset += length;
 
-    // Get the value of the bytes
-    PyObject *value = PyUnicode_FromEncodedObject(item_bytes, "utf-8", "strict");
+    // Add it to the back-references the same way the encoder did. They're interned, as they're the strings likely to repeat
+    if (value != NULL && bd->refs != NULL && length >= REF_MIN_SIZE && PyList_GET_SIZE(bd->refs) < REF_MAX)
+    {
+        PyUnicode_InternInPlace(&value);
+        if (PyList_Append(bd->refs, value) == -1) Py_CLEAR(value);
+    }
+
+    return value;
+}
+
+// Get the string a back-reference points to
+static inline PyObject *to_ref_gen(ByteData *bd, size_t size_bytes_length)
+{
+    if (ensure_offset(bd, size_bytes_length + 1) == -1) return NULL;
+
+    size_t index = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
+    bd->offset += size_bytes_length;
+
+    if (bd->refs == NULL || index >= (size_t)PyList_GET_SIZE(bd->refs))
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid back-reference.");
+        return NULL;
+    }
 
-    Py_DECREF(item_bytes);
+    PyObject *value = PyList_GET_ITEM(bd->refs, index);
+    Py_INCREF(value);
 
     return value;
 }
 
+// Get a buffer written out-of-band, as a read-only memoryview of the mapped segment
+static inline PyObject *to_oob_s(ByteData *bd)
+{
+    if (ensure_offset(bd, 17) == -1) return NULL;
+
+    uint64_t location[2];
+    memcpy(location, &(bd->bytes[bd->offset + 1]), 16);
+    bd->offset += 17;
+
+    // The buffer has to be within the segment of the frame
+    if (bd->oob == NULL || location[0] > (uint64_t)PyObject_Length(bd->oob) || location[1] > (uint64_t)PyObject_Length(bd->oob) - location[0])
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid out-of-band buffer.");
+        return NULL;
+    }
+
+    return PySequence_GetSlice(bd->oob, (Py_ssize_t)location[0], (Py_ssize_t)(location[0] + location[1]));
+}
+
 // Generic function for ints
 static inline PyObject *to_int_gen(ByteData *bd, size_t length)
 {
@@ -1797,6 +3541,7 @@ static inline PyObject *to_bool_gen(ByteData *bd, PyObject *bool_value)
 
     // Increment once to skip over the datachar
     bd->offset++;
+    Py_INCREF(bool_value);
     return bool_value;
 }
 
@@ -1825,7 +3570,7 @@ static inline PyObject *to_none_s(ByteData *bd)
     if (ensure_offset(bd, 1) == -1) return NULL;
 
     bd->offset++;
-    return Py_None;
+    Py_RETURN_NONE;
 }
 
 static inline PyObject *to_ellipsis_s(ByteData *bd)
@@ -1833,6 +3578,7 @@ static inline PyObject *to_ellipsis_s(ByteData *bd)
     if (ensure_offset(bd, 1) == -1) return NULL;
 
     bd->offset++;
+    Py_INCREF(Py_Ellipsis);
     return Py_Ellipsis;
 }
 
@@ -1843,7 +3589,7 @@ static inline PyObject *to_bytes_e(ByteData *bd, int is_bytearray)
 
     bd->offset++;
     // Create and return an empty bytes object
-    return is_bytearray ? PyBytes_FromStringAndSize(NULL, 0) : PyByteArray_FromStringAndSize(NULL, 0);
+    return is_bytearray ? PyByteArray_FromStringAndSize(NULL, 0) : PyBytes_FromStringAndSize(NULL, 0);
 }
 
 // Generic method for bytes/bytearray conversion
@@ -1858,7 +3604,8 @@ static inline PyObject *to_bytes_gen(ByteData *bd, size_t size_bytes_length, int
     if (ensure_offset(bd, length) == -1) return NULL;
 
     // Get the actual value bytes using the length. Create a PyBytes object if is_bytearray is 0, else a PyByteArray
-    PyObject *item_bytes = is_bytearray == 0 ? PyBytes_FromStringAndSize((const char *)(&(bd->bytes[bd->offset])), length) : PyByteArray_FromStringAndSize((const char *)(&(bd->bytes[bd->offset])), length);
+    PyObject *item_bytes = is_bytearray == 0 ? PyBytes_FromStringAndSize(NULL, length) : PyByteArray_FromStringAndSize(NULL, length);
+    if (item_bytes != NULL) copy_bytes(is_bytearray == 0 ? PyBytes_AS_STRING(item_bytes) : PyByteArray_AS_STRING(item_bytes), &(bd->bytes[bd->offset]), length, bd->workers, 1);
     bd->offset += length;
 
     // Return the item bytes as it's supposed to be a bytes object
@@ -1868,24 +3615,22 @@ static inline PyObject *to_bytes_gen(ByteData *bd, size_t size_bytes_length, int
 // Generic method for datetime object conversion
 static inline PyObject *to_datetime_gen(ByteData *bd, PyObject *method)
 {
-    if (ensure_offset(bd, 1) == -1) return NULL;
+    if (ensure_offset(bd, 2) == -1) return NULL;
 
     // Get the length of the datetime bytes
     size_t length = bytes_to_size_t(&(bd->bytes[++bd->offset]), 1);
 
     if (ensure_offset(bd, length + 1) == -1) return NULL;
     
-    // Grab the iso string from the C bytes
-    PyObject *iso_bytes =  PyBytes_FromStringAndSize((const char *)(&(bd->bytes[++bd->offset])), length);
+    // Get the iso string back from the C bytes
+    PyObject *iso = PyUnicode_DecodeUTF8((const char *)(&(bd->bytes[++bd->offset])), (Py_ssize_t)length, "strict");
     bd->offset += length;
 
-    // Get the iso string back
-    PyObject *iso = PyUnicode_FromEncodedObject(iso_bytes, "utf-8", "strict");
+    if (iso == NULL) return NULL;
 
     // Convert the iso string back to a datetime object
     PyObject *datetime_obj = PyObject_CallMethod(method, "fromisoformat", "O", iso); // The parsed method is the class to call
 
-    Py_DECREF(iso_bytes);
     Py_DECREF(iso);
 
     return datetime_obj;
@@ -1893,6 +3638,8 @@ static inline PyObject *to_datetime_gen(ByteData *bd, PyObject *method)
 
 static inline PyObject *to_timedelta_s(ByteData *bd)
 {
+    if (ensure_offset(bd, 1 + (3 * sizeof(int))) == -1) return NULL;
+
     // These will hold the days, seconds, and microseconds from the timedelta object
     int days, seconds, microseconds;
 
@@ -1913,11 +3660,15 @@ static inline PyObject *to_uuid_s(ByteData *bd)
 {
     if (ensure_offset(bd, 33) == -1) return NULL;
 
-    // Convert the bytes back to a uuid object
-    PyObject* uuid = PyObject_CallFunction(uuid_cl, "O", PyUnicode_FromStringAndSize((const char *)(&(bd->bytes[++bd->offset])), 32)); // 32 because UUIDs are always of that length
+    // Get the hex string of the uuid, 32 because UUIDs are always of that length
+    PyObject *hex = PyUnicode_FromStringAndSize((const char *)(&(bd->bytes[++bd->offset])), 32);
+    if (hex == NULL) return NULL;
+
+    // Convert the hex string back to a uuid object
+    PyObject* uuid = PyObject_CallFunction(uuid_cl, "O", hex);
+    Py_DECREF(hex);
     if (uuid == NULL)
     {
-        Py_XDECREF(uuid);
         PyErr_SetString(PyExc_RuntimeError, "Failed to create UUID object.");
         return NULL;
     }
@@ -1931,6 +3682,7 @@ static inline PyObject *to_uuid_s(ByteData *bd)
 static inline PyObject *to_memoryview_e(ByteData *bd)
 {
     if (ensure_offset(bd, 1) == -1) return NULL;
+    bd->offset++;
 
     // Create and return an empty memoryview object using an empty bytes object
     PyObject *empty_obj = PyBytes_FromStringAndSize(NULL, 0);
@@ -1951,7 +3703,8 @@ static inline PyObject *to_memoryview_gen(ByteData *bd, size_t size_bytes_length
     if (ensure_offset(bd, length) == -1) return NULL;
 
     // Create a bytes object out of the memoryview buffer bytes
-    PyObject *buf_bytes = PyBytes_FromStringAndSize((const char *)(&(bd->bytes[bd->offset])), length);
+    PyObject *buf_bytes = PyBytes_FromStringAndSize(NULL, length);
+    if (buf_bytes != NULL) copy_bytes(PyBytes_AS_STRING(buf_bytes), &(bd->bytes[bd->offset]), length, bd->workers, 1);
 
     // Create a memoryview object out of the buffer
     PyObject *memoryview = PyMemoryView_FromObject(buf_bytes);
@@ -1980,11 +3733,11 @@ static inline PyObject *to_decimal_gen(ByteData *bd, size_t size_bytes_length)
 
     // Get the bytes of the decimal
     PyObject *decimal_str = PyUnicode_FromStringAndSize((const char *)(&(bd->bytes[bd->offset])), length);
+    if (decimal_str == NULL) return NULL;
 
     // Convert it to a decimal
-    PyObject *args = PyTuple_Pack(1, decimal_str);
     PyObject *decimal = PyObject_CallFunction(decimal_cl, "O", decimal_str);
-    Py_DECREF(args);
+    Py_DECREF(decimal_str);
     if (decimal == NULL) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to convert string to Decimal.");
         return NULL;
@@ -2005,6 +3758,15 @@ static inline PyObject *to_range_s(ByteData *bd)
     PyObject *stop  = to_any_value(bd);
     PyObject *step  = to_any_value(bd);
 
+    // Any of them might have failed on invalid bytes
+    if (start == NULL || stop == NULL || step == NULL)
+    {
+        Py_XDECREF(start);
+        Py_XDECREF(stop);
+        Py_XDECREF(step);
+        return NULL;
+    }
+
     // Create a range object with the attributes by calling the range class
     PyObject *range = PyObject_CallFunction((PyObject *)&PyRange_Type, "OOO", start, stop, step);
     if (range == NULL)
@@ -2065,6 +3827,110 @@ static inline PyObject *to_null(ByteData *bd)
     return NULL;
 }
 
+// # The packed value conversion functions
+
+// Convert the items of a packed array to an array object with a single copy
+static inline PyObject *to_packed_array(ByteData *bd, char typecode, size_t size)
+{
+    PyObject *array = PyObject_CallFunction(array_cl, "C", (int)typecode);
+    if (array == NULL) return NULL;
+
+    // Let the array copy the items straight out of the bytes
+    PyObject *items = PyMemoryView_FromMemory((char *)&(bd->bytes[bd->offset]), (Py_ssize_t)size, PyBUF_READ);
+    PyObject *result = items == NULL ? NULL : PyObject_CallMethod(array, "frombytes", "O", items);
+    Py_XDECREF(items);
+
+    if (result == NULL)
+    {
+        Py_DECREF(array);
+        return NULL;
+    }
+
+    Py_DECREF(result);
+    bd->offset += size;
+
+    return array;
+}
+
+static inline PyObject *to_packed_s(ByteData *bd)
+{
+    unsigned char container;
+    char typecode;
+    size_t itemsize, num_items;
+    if (read_packed_header(bd, &container, &typecode, &itemsize, &num_items) == -1) return NULL;
+
+    if (container == PACKED_ARRAY)
+    {
+        PyObject *array = to_packed_array(bd, typecode, num_items * itemsize);
+
+        // The item size of a typecode differs between platforms for some typecodes
+        if (array != NULL && (size_t)PyObject_Length(array) != num_items)
+        {
+            Py_DECREF(array);
+            PyErr_SetString(PyExc_ValueError, "Received an array with an item size that's not supported on this platform.");
+            return NULL;
+        }
+
+        return array;
+    }
+
+    // Lists and tuples only use the typecodes we pack them with
+    size_t expected;
+    switch (typecode)
+    {
+    case 'd': expected = sizeof(double); break;
+    case '?':
+    case 'b': expected = 1; break;
+    case 'h': expected = 2; break;
+    case 'i': expected = 4; break;
+    case 'q': expected = 8; break;
+    default:  expected = 0; break;
+    }
+
+    if (expected != itemsize || (container != PACKED_LIST && container != PACKED_TUPLE))
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid packed value header.");
+        return NULL;
+    }
+
+    PyObject *value = container == PACKED_LIST ? PyList_New(num_items) : PyTuple_New(num_items);
+    if (value == NULL) return NULL;
+
+    // Both lists and tuples start out with NULL items, which they can be deallocated with
+    PyObject **items = PySequence_Fast_ITEMS(value);
+    const unsigned char *bytes = &(bd->bytes[bd->offset]);
+
+    // A plain loop per typecode, like when packing the items
+    #define UNPACK_ITEMS(ctype, convert) \
+        for (size_t i = 0; i < num_items; i++) \
+        { \
+            ctype num; \
+            memcpy(&num, &bytes[i * sizeof(ctype)], sizeof(ctype)); \
+            if ((items[i] = convert(num)) == NULL) \
+            { \
+                Py_DECREF(value); \
+                return NULL; \
+            } \
+        } \
+        break;
+
+    switch (typecode)
+    {
+    case 'd': UNPACK_ITEMS(double, PyFloat_FromDouble)
+    case '?': UNPACK_ITEMS(unsigned char, PyBool_FromLong)
+    case 'b': UNPACK_ITEMS(int8_t, PyLong_FromLong)
+    case 'h': UNPACK_ITEMS(int16_t, PyLong_FromLong)
+    case 'i': UNPACK_ITEMS(int32_t, PyLong_FromLong)
+    default:  UNPACK_ITEMS(int64_t, PyLong_FromLongLong)
+    }
+
+    #undef UNPACK_ITEMS
+
+    bd->offset += num_items * itemsize;
+
+    return value;
+}
+
 // # The list type conversion functions and their helper functions
 
 static inline PyObject *to_list_e(ByteData *bd)
@@ -2084,8 +3950,11 @@ static inline PyObject *to_list_gen(ByteData *bd, size_t size_bytes_length)
     size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
     bd->offset += size_bytes_length;
 
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
     // Create a list with the amount of items we expect
     PyObject *list = PyList_New(num_items);
+    if (list == NULL) return NULL;
 
     // Go over each item and add them to the list
     for (size_t i = 0; i < num_items; i++)
@@ -2124,8 +3993,11 @@ static inline PyObject *to_tuple_gen(ByteData *bd, size_t size_bytes_length)
     size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
     bd->offset += size_bytes_length;
 
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
     // Create a tuple with the amount of items we expect
     PyObject *tuple = PyTuple_New(num_items);
+    if (tuple == NULL) return NULL;
 
     // Go over each item and add them to the tuple
     for (Py_ssize_t i = 0; i < (Py_ssize_t)num_items; i++)
@@ -2221,6 +4093,7 @@ static inline PyObject *to_iterable_gen(ByteData *bd, size_t size_bytes_length,
     }
     default: // Shouldn't be reached, but just to be sure
     {
+        Py_DECREF(list);
         PyErr_SetString(PyExc_RuntimeError, "Unexpectedly received an invalid iterable character.");
         return NULL;
     }
@@ -2247,8 +4120,11 @@ static inline PyObject *to_dict_gen(ByteData *bd, size_t size_bytes_length)
     size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
     bd->offset += size_bytes_length;
 
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
     // Create an empty dict object
     PyObject *dict = PyDict_New();
+    if (dict == NULL) return NULL;
 
     // Go over each pair and add them to the dict
     for (size_t i = 0; i < num_items; i++)
@@ -2267,13 +4143,73 @@ static inline PyObject *to_dict_gen(ByteData *bd, size_t size_bytes_length)
             return NULL;
         }
 
-        // Place the key-value pair in the dict
-        PyDict_SetItem(dict, key, value);
+        // Place the key-value pair in the dict, which fails if invalid bytes gave an unhashable key
+        int result = PyDict_SetItem(dict, key, value);
 
         Py_DECREF(key);
         Py_DECREF(value);
+
+        if (result == -1)
+        {
+            Py_DECREF(dict);
+            return NULL;
+        }
+    }
+
+    return dict;
+}
+
+static inline PyObject *to_str_dict_gen(ByteData *bd, size_t size_bytes_length)
+{
+    if (ensure_offset(bd, size_bytes_length + 1) == -1) return NULL;
+
+    // Get the number of pairs in the dict
+    size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
+    bd->offset += size_bytes_length;
+
+    // Every key takes at least its size byte, so check the count before allocating for it
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
+    PyObject **keys = PyMem_Malloc(num_items * sizeof(PyObject *));
+    if (keys == NULL) return PyErr_NoMemory();
+
+    // Read the run of keys. They're interned, as the same keys tend to show up in many dicts
+    size_t num_keys = 0;
+    for (; num_keys < num_items; num_keys++)
+    {
+        if (ensure_offset(bd, 1) == -1) break;
+        size_t size = bd->bytes[bd->offset];
+        if (ensure_offset(bd, 1 + size) == -1) break;
+
+        PyObject *key = decode_str(&(bd->bytes[bd->offset + 1]), size);
+        if (key == NULL) break;
+
+        PyUnicode_InternInPlace(&key);
+        keys[num_keys] = key;
+        bd->offset += 1 + size;
+    }
+
+    // Create an empty dict object, unless reading the keys failed
+    PyObject *dict = num_keys == num_items ? PyDict_New() : NULL;
+
+    // Go over each value and pair them with their key
+    for (size_t i = 0; dict != NULL && i < num_items; i++)
+    {
+        PyObject *value = to_any_value(bd);
+
+        if (value == NULL || PyDict_SetItem(dict, keys[i], value) == -1)
+        {
+            // The error message has already been set
+            Py_CLEAR(dict);
+        }
+
+        Py_XDECREF(value);
     }
 
+    for (size_t i = 0; i < num_keys; i++)
+        Py_DECREF(keys[i]);
+    PyMem_Free(keys);
+
     return dict;
 }
 
@@ -2294,8 +4230,11 @@ static inline PyObject *to_counter_gen(ByteData *bd, size_t size_bytes_length)
     size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
     bd->offset += size_bytes_length;
 
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
     // Create an empty dict
     PyObject *dict = PyDict_New();
+    if (dict == NULL) return NULL;
 
     // Go over each pair and add them to the dict
     for (size_t i = 0; i < num_items; i++)
@@ -2314,11 +4253,17 @@ static inline PyObject *to_counter_gen(ByteData *bd, size_t size_bytes_length)
             return NULL;
         }
 
-        // Place the key-value pair in the dict
-        PyDict_SetItem(dict, key, value);
+        // Place the key-value pair in the dict, which fails if invalid bytes gave an unhashable key
+        int result = PyDict_SetItem(dict, key, value);
 
         Py_DECREF(key);
         Py_DECREF(value);
+
+        if (result == -1)
+        {
+            Py_DECREF(dict);
+            return NULL;
+        }
     }
 
     // Create the Counter out of the dict
@@ -2345,8 +4290,11 @@ static inline PyObject *to_ordereddict_gen(ByteData *bd, size_t size_bytes_lengt
     size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
     bd->offset += size_bytes_length;
 
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
     // Create an empty dict
     PyObject *dict = PyDict_New();
+    if (dict == NULL) return NULL;
 
     // Go over each pair and add them to the dict
     for (size_t i = 0; i < num_items; i++)
@@ -2365,11 +4313,17 @@ static inline PyObject *to_ordereddict_gen(ByteData *bd, size_t size_bytes_lengt
             return NULL;
         }
 
-        // Place the key-value pair in the dict
-        PyDict_SetItem(dict, key, value);
+        // Place the key-value pair in the dict, which fails if invalid bytes gave an unhashable key
+        int result = PyDict_SetItem(dict, key, value);
 
         Py_DECREF(key);
         Py_DECREF(value);
+
+        if (result == -1)
+        {
+            Py_DECREF(dict);
+            return NULL;
+        }
     }
 
     // Create the OrderedDict out of the dict
@@ -2396,16 +4350,23 @@ static inline PyObject *to_chainmap_gen(ByteData *bd, size_t size_bytes_length)
     size_t num_items = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
     bd->offset += size_bytes_length;
 
+    if (ensure_items(bd, num_items) == -1) return NULL;
+
     // This will hold the maps
     PyObject *maps = PyTuple_New(num_items);
+    if (maps == NULL) return NULL;
 
     for (size_t i = 0; i < num_items; i++)
     {
         // Get the item of the current map
         PyObject *item = to_any_value(bd);
-        if (item == NULL) return NULL;
-
-        // Place the dict into the maps tuple
+        if (item == NULL)
+        {
+            Py_DECREF(maps);
+            return NULL;
+        }
+
+        // Place the dict into the maps tuple
         PyTuple_SET_ITEM(maps, i, item);
     }
 
@@ -2432,12 +4393,12 @@ static inline PyObject *to_namedtuple_e(ByteData *bd)
 
     // Create the namedtuple type
     PyObject *nt_type = PyObject_CallFunction(namedtuple_cl, "OO", name, empty_tuple);
-    // Create the namedtuple using that type
-    PyObject *namedtuple = PyObject_CallObject(nt_type, empty_tuple);
+    // Create the namedtuple using that type, unless invalid bytes gave an invalid name
+    PyObject *namedtuple = nt_type == NULL ? NULL : PyObject_CallObject(nt_type, empty_tuple);
 
     Py_DECREF(name);
     Py_DECREF(empty_tuple);
-    Py_DECREF(nt_type);
+    Py_XDECREF(nt_type);
 
     return namedtuple;
 }
@@ -2454,9 +4415,23 @@ static inline PyObject *to_namedtuple_gen(ByteData *bd, size_t size_bytes_length
     PyObject *name = to_any_value(bd);
     if (name == NULL) return NULL; // Error already set
 
+    if (ensure_items(bd, num_items) == -1)
+    {
+        Py_DECREF(name);
+        return NULL;
+    }
+
     // Go over the pairs and get the fields and items
     PyObject *fields = PyTuple_New(num_items);
     PyObject *items = PyTuple_New(num_items);
+    if (fields == NULL || items == NULL)
+    {
+        Py_DECREF(name);
+        Py_XDECREF(fields);
+        Py_XDECREF(items);
+        return NULL;
+    }
+
     for (Py_ssize_t i = 0; i < (Py_ssize_t)num_items; i++)
     {
         // Get the field and item
@@ -2467,6 +4442,9 @@ static inline PyObject *to_namedtuple_gen(ByteData *bd, size_t size_bytes_length
         {
             Py_XDECREF(field);
             Py_XDECREF(item);
+            Py_DECREF(name);
+            Py_DECREF(fields);
+            Py_DECREF(items);
             // Error already set
             return NULL;
         }
@@ -2478,19 +4456,21 @@ static inline PyObject *to_namedtuple_gen(ByteData *bd, size_t size_bytes_length
 
     // Create the namedtuple type
     PyObject *nt_type = PyObject_CallFunctionObjArgs(namedtuple_cl, name, fields, NULL);
-    // Create the namedtuple using that type
-    PyObject *namedtuple = PyObject_CallObject(nt_type, items);
+    // Create the namedtuple using that type, unless invalid bytes gave invalid fields
+    PyObject *namedtuple = nt_type == NULL ? NULL : PyObject_CallObject(nt_type, items);
 
     Py_DECREF(name);
     Py_DECREF(fields);
     Py_DECREF(items);
-    Py_DECREF(nt_type);
+    Py_XDECREF(nt_type);
 
     return namedtuple;
 }
 
 static inline PyObject *to_any_value(ByteData *bd)
 {
+    if (ensure_offset(bd, 1) == -1) return NULL;
+
     // Get the datachar of the current value and switch over it
     const unsigned char datachar = bd->bytes[bd->offset];
 
@@ -2667,6 +4647,21 @@ static inline PyObject *to_any_value(ByteData *bd)
         if (size_bytes_length == 0) return NULL;
         return to_iterable_gen(bd, size_bytes_length, FSET_E);
     }
+    case SDICT_E: return to_dict_e(bd);
+    case SDICT_1: return to_str_dict_gen(bd, 1);
+    case SDICT_2: return to_str_dict_gen(bd, 2);
+    case SDICT_D1:
+    {
+        size_t size_bytes_length = D1_length(bd);
+        if (size_bytes_length == 0) return NULL;
+        return to_str_dict_gen(bd, size_bytes_length);
+    }
+    case SDICT_D2:
+    {
+        size_t size_bytes_length = D2_length(bd);
+        if (size_bytes_length == 0) return NULL;
+        return to_str_dict_gen(bd, size_bytes_length);
+    }
     case DICT_E: return to_dict_e(bd);
     case DICT_1: return to_dict_gen(bd, 1);
     case DICT_2: return to_dict_gen(bd, 2);
@@ -2760,7 +4755,7 @@ static inline PyObject *to_any_value(ByteData *bd)
     }
     case PATH_E: return to_path_e(bd, path_cl);
     case PATH_1: return to_path_gen(bd, 1, path_cl);
-    case PATH_2: return to_path_gen(bd, 1, path_cl);
+    case PATH_2: return to_path_gen(bd, 2, path_cl);
     case PATH_D1:
     {
         size_t size_bytes_length = D1_length(bd);
@@ -2775,7 +4770,7 @@ static inline PyObject *to_any_value(ByteData *bd)
     }
     case PPATH_E: return to_path_e(bd, purepath_cl);
     case PPATH_1: return to_path_gen(bd, 1, purepath_cl);
-    case PPATH_2: return to_path_gen(bd, 1, purepath_cl);
+    case PPATH_2: return to_path_gen(bd, 2, purepath_cl);
     case PPATH_D1:
     {
         size_t size_bytes_length = D1_length(bd);
@@ -2788,6 +4783,10 @@ static inline PyObject *to_any_value(ByteData *bd)
         if (size_bytes_length == 0) return NULL;
         return to_path_gen(bd, size_bytes_length, purepath_cl);
     }
+    case PACKED_S: return to_packed_s(bd);
+    case REF_1: return to_ref_gen(bd, 1);
+    case REF_2: return to_ref_gen(bd, 2);
+    case OOB_S: return to_oob_s(bd);
     default:
     {
         // Invalid datachar received
@@ -2797,59 +4796,1214 @@ static inline PyObject *to_any_value(ByteData *bd)
     }
 }
 
-// # The main to-value conversion function
+// # The main to-value conversion functions
+
+// Convert the value after the protocol marker, building the table of back-references if it holds those
+static inline PyObject *to_root(ByteData *bd)
+{
+    if (ensure_offset(bd, 1) == -1) return NULL;
+    if (bd->bytes[bd->offset] != REFS_M) return to_any_value(bd);
+
+    bd->offset++;
+
+    bd->refs = PyList_New(0);
+    if (bd->refs == NULL) return NULL;
+
+    PyObject *value = to_any_value(bd);
+
+    Py_CLEAR(bd->refs);
+    return value;
+}
+
+// # Compressed frames
+
+/*
+  Bytes can be compressed as a whole into a frame of their own, which
+  starts with the PROT_Z marker, followed by a byte for the codec and 8
+  bytes for the size of the bytes once decompressed. Then follows the
+  compressed data:
+
+  [ PROT_Z ] [ codec ] [ size (8 bytes) ] [ compressed bytes ]
+
+  The only codec is zlib, through the zlib module so that we don't need
+  to link to anything. It's imported the first time it's needed.
+
+  The frame holds the bytes of a regular protocol, never another frame.
+  Bytes that are smaller than the threshold, or that don't get smaller
+  by compressing them, are returned as they are.
+
+*/
+
+#define CODEC_ZLIB 0 // Compressed with zlib
+
+#define FRAME_HEADER_SIZE 10 // The protocol marker, codec and size
+#define ZLIB_MAX_RATIO 1032  // The most that deflate can compress bytes by
+
+// Import the functions of the zlib module if we didn't yet. Returns -1 on failure
+static int import_zlib(void)
+{
+    if (zlib_decompress != NULL) return 0;
+
+    PyObject *zlib_m = PyImport_ImportModule("zlib");
+    if (zlib_m == NULL) return -1;
+
+    zlib_compress = PyObject_GetAttrString(zlib_m, "compress");
+    zlib_decompress = zlib_compress == NULL ? NULL : PyObject_GetAttrString(zlib_m, "decompress");
+    Py_DECREF(zlib_m);
+
+    if (zlib_decompress == NULL)
+    {
+        Py_CLEAR(zlib_compress);
+        return -1;
+    }
+
+    return 0;
+}
+
+PyObject *compress_value(PyObject *bytes, int level, size_t threshold)
+{
+    size_t size = (size_t)PyBytes_GET_SIZE(bytes);
+    if (level == 0 || size < threshold || size < FRAME_HEADER_SIZE || import_zlib() == -1)
+    {
+        if (PyErr_Occurred()) return NULL;
+
+        Py_INCREF(bytes);
+        return bytes;
+    }
+
+    PyObject *compressed = PyObject_CallFunction(zlib_compress, "Oi", bytes, level);
+    if (compressed == NULL) return NULL;
+
+    // Keep the bytes as they are if compressing them didn't save anything
+    size_t compressed_size = (size_t)PyBytes_GET_SIZE(compressed);
+    if (compressed_size + FRAME_HEADER_SIZE >= size)
+    {
+        Py_DECREF(compressed);
+        Py_INCREF(bytes);
+        return bytes;
+    }
+
+    PyObject *frame = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)(compressed_size + FRAME_HEADER_SIZE));
+    if (frame != NULL)
+    {
+        unsigned char *frame_bytes = (unsigned char *)PyBytes_AS_STRING(frame);
+        frame_bytes[0] = PROT_Z;
+        frame_bytes[1] = CODEC_ZLIB;
+        for (size_t i = 0; i < 8; i++) frame_bytes[2 + i] = (unsigned char)((uint64_t)size >> (i * 8));
+
+        memcpy(&(frame_bytes[FRAME_HEADER_SIZE]), PyBytes_AS_STRING(compressed), compressed_size);
+    }
+
+    Py_DECREF(compressed);
+    return frame;
+}
+
+// Decompress the bytes of a frame into a new bytes object
+static PyObject *decompress_frame(const unsigned char *bytes, size_t length)
+{
+    if (length < FRAME_HEADER_SIZE || bytes[1] != CODEC_ZLIB)
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid compressed frame.");
+        return NULL;
+    }
+
+    size_t size = bytes_to_size_t(&(bytes[2]), 8);
+    size_t compressed_size = length - FRAME_HEADER_SIZE;
+
+    if (import_zlib() == -1) return NULL;
+
+    // Let zlib allocate the full size up front, unless the frame claims more than it could possibly hold
+    size_t bufsize = size;
+    if (bufsize / ZLIB_MAX_RATIO > compressed_size + 1) bufsize = (compressed_size + 1) * ZLIB_MAX_RATIO;
+    if (bufsize > PY_SSIZE_T_MAX) bufsize = PY_SSIZE_T_MAX;
+
+    PyObject *data = PyMemoryView_FromMemory((char *)&(bytes[FRAME_HEADER_SIZE]), (Py_ssize_t)compressed_size, PyBUF_READ);
+    if (data == NULL) return NULL;
+
+    PyObject *decompressed = PyObject_CallFunction(zlib_decompress, "Oin", data, 15, (Py_ssize_t)bufsize);
+    Py_DECREF(data);
+
+    // Report corrupt data like any other invalid bytes, instead of as a zlib error
+    if (decompressed == NULL)
+    {
+        if (!PyErr_ExceptionMatches(PyExc_MemoryError))
+        {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid compressed frame.");
+        }
+        return NULL;
+    }
+
+    // A frame holds the bytes of a regular protocol, so nested frames aren't valid either
+    if ((size_t)PyBytes_GET_SIZE(decompressed) != size || size == 0 || PyBytes_AS_STRING(decompressed)[0] == (char)PROT_Z)
+    {
+        Py_DECREF(decompressed);
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid compressed frame.");
+        return NULL;
+    }
+
+    return decompressed;
+}
+
+// # Out-of-band frames
+
+/*
+  These are the frames of bytes that hold buffers written out-of-band,
+  see the section on those for how they're written. Converting them
+  back maps their segment read-only through the mmap module, so that
+  the memoryviews of the buffers keep the mapping alive on their own.
+
+  As the frame names the segment to map, and releasing it removes that
+  segment, they're only converted back if the caller explicitly allows
+  it. Even then, the name has to be one that we'd create, and the
+  segment has to start with a valid header before it's mapped or
+  removed, so that bytes can't get at any other segment.
+
+*/
+
+// Get the name of the segment of a frame. Returns -1 with an error set if the frame is invalid
+static int read_oob_name(const unsigned char *bytes, size_t length, char *name, size_t *header_size)
+{
+    const size_t prefix_length = sizeof(OOB_PREFIX) - 1;
+
+    size_t name_length = length < 2 ? 0 : bytes[1];
+    int valid = name_length > prefix_length && name_length < OOB_NAME_SIZE && length >= 2 + name_length && memcmp(&(bytes[2]), OOB_PREFIX, prefix_length) == 0;
+
+    // The prefix is followed by the pid and counter of the process that created it
+    for (size_t i = prefix_length; valid && i < name_length; i++)
+        valid = isdigit(bytes[2 + i]) || bytes[2 + i] == '-';
+
+    if (!valid)
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid out-of-band frame.");
+        return -1;
+    }
+
+    memcpy(name, &(bytes[2]), name_length);
+    name[name_length] = 0;
+    *header_size = 2 + name_length;
+
+    return 0;
+}
+
+// Open the segment of a frame, checking its header. Returns the descriptor and sets `size` to the size in the header, or -1 with an error set on failure
+static int open_oob_segment(const char *name, size_t *size)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        if (errno == ENOENT) PyErr_Format(PyExc_FileNotFoundError, "The out-of-band buffers of the bytes were already released. (Segment: %s)", name);
+        else PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+
+    // Only map the header if the segment is large enough to hold one, as it's undefined to access a mapping past the end of its file
+    struct stat info;
+    OOBHeader header = {0, 0};
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= OOB_HEADER_SIZE)
+    {
+        void *mapping = mmap(NULL, OOB_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            memcpy(&header, mapping, sizeof(header));
+            munmap(mapping, OOB_HEADER_SIZE);
+        }
+    }
+
+    if (header.magic != OOB_MAGIC || header.size < OOB_HEADER_SIZE || header.size > (uint64_t)info.st_size)
+    {
+        close(fd);
+        PyErr_Format(PyExc_ValueError, "Likely received an invalid bytes object: the segment of the out-of-band frame doesn't hold out-of-band buffers. (Segment: %s)", name);
+        return -1;
+    }
+
+    *size = (size_t)header.size;
+    return fd;
+}
+
+// Map the segment of a frame read-only, as a memoryview. Returns NULL with an error set on failure
+static PyObject *map_oob_segment(const char *name)
+{
+    if (mmap_cl == NULL)
+    {
+        PyObject *mmap_m = PyImport_ImportModule("mmap");
+        if (mmap_m == NULL) return NULL;
+
+        mmap_cl = PyObject_GetAttrString(mmap_m, "mmap");
+        Py_DECREF(mmap_m);
+
+        if (mmap_cl == NULL) return NULL;
+    }
+
+    size_t size;
+    int fd = open_oob_segment(name, &size);
+    if (fd == -1) return NULL;
+
+    // The mapping stays valid after closing the descriptor, and after the segment is released
+    PyObject *mapping = PyObject_CallFunction(mmap_cl, "iniii", fd, (Py_ssize_t)size, MAP_SHARED, PROT_READ, 0);
+    close(fd);
+    if (mapping == NULL) return NULL;
+
+    PyObject *view = PyMemoryView_FromObject(mapping);
+    Py_DECREF(mapping);
+
+    return view;
+}
+
+// Convert an out-of-band frame back to the value it used to be
+static PyObject *to_value_oob(const unsigned char *bytes, size_t length, int workers)
+{
+    char name[OOB_NAME_SIZE];
+    size_t header_size;
+    if (read_oob_name(bytes, length, name, &header_size) == -1) return NULL;
+
+    // The frame holds the default protocol, as it's the only one that writes buffers out-of-band
+    if (length == header_size || bytes[header_size] != PROT_D)
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid out-of-band frame.");
+        return NULL;
+    }
+
+    PyObject *segment = map_oob_segment(name);
+    if (segment == NULL) return NULL;
+
+    ByteData bd = {header_size + 1, length, bytes};
+    bd.workers = workers;
+    bd.oob = segment;
+
+    PyObject *result = to_root(&bd);
+    Py_DECREF(segment);
+
+    return result;
+}
+
+int release_oob_frame(const unsigned char *bytes, size_t length)
+{
+    if (length == 0 || bytes[0] != PROT_OOB) return 0;
+
+    char name[OOB_NAME_SIZE];
+    size_t header_size;
+    if (read_oob_name(bytes, length, name, &header_size) == -1) return -1;
+
+    // It's fine if the segment was already released, but it has to be one of ours otherwise
+    size_t size;
+    int fd = open_oob_segment(name, &size);
+    if (fd == -1)
+    {
+        if (!PyErr_ExceptionMatches(PyExc_FileNotFoundError)) return -1;
+
+        PyErr_Clear();
+        return 0;
+    }
+    close(fd);
+
+    if (shm_unlink(name) == -1)
+    {
+        if (errno == ENOENT) return 0;
+
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
 
-PyObject *to_value(PyObject *py_bytes)
+    return 1;
+}
+
+// Convert a C buffer to the value it used to be, spreading large copies over `workers` threads, and mapping the segments of out-of-band frames if `oob` is set
+static PyObject *to_value_workers(const unsigned char *bytes, size_t length, int workers, int oob)
 {
-    // Get the PyBytes object as a C string
-    const unsigned char *bytes = (const unsigned char *)PyBytes_AsString(py_bytes);
+    /*
+      This function decodes straight from the given buffer, without
+      copying it first. The caller has to make sure the buffer stays
+      valid (and unchanged) for as long as this function runs.
+
+    */
+
+    // Check whether we got at least the protocol marker
+    if (length == 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: no protocol marker found.");
+        return NULL;
+    }
 
     // Get the first character, being the protocol marker
     const unsigned char protocol = *bytes;
 
+    // Compressed frames are counted once they're decompressed, by the call below
+    if (protocol != PROT_Z)
+    {
+        COUNT_STAT(decodes, 1);
+        COUNT_STAT(bytes_in, length);
+    }
+
     // Decide what to do based on the protocol version
     switch (protocol)
     {
     case PROT_D: // The default SBS protocol
     {
-        // Get the length of this bytes object for memory allocation
-        Py_ssize_t bytes_length = PyBytes_Size(py_bytes);
+        // Create the bytedata struct, starting at offset 1 to exclude the protocol marker
+        ByteData bd = {1, length, bytes};
+        bd.workers = workers;
+
+        // Use and return the root conversion function
+        return to_root(&bd);
+    }
+    case PROT_1:
+    {
+        // The old protocol only accepts a bytes object, so create one for it
+        PyObject *py_bytes = PyBytes_FromStringAndSize((const char *)bytes, (Py_ssize_t)length);
+        if (py_bytes == NULL) return NULL;
 
-        // Create the bytedata struct
-        ByteData *bd = (ByteData *)malloc(sizeof(ByteData));
-        if (bd == NULL)
+        PyObject *result = to_value_prot1(py_bytes);
+        Py_DECREF(py_bytes);
+
+        return result;
+    }
+    case PROT_SFS_1: // A random-access SFS buffer, fully converted back
+    {
+        return sfs_to_value(bytes, length);
+    }
+    case PROT_SRS_1: // Records encoded by a schema, which only the schema can decode
+    {
+        PyErr_SetString(PyExc_ValueError, "The bytes hold records encoded by a schema, decode them with 'Schema.decode' or 'Schema.decode_many'.");
+        return NULL;
+    }
+    case PROT_Z: // A compressed frame, decoded from the decompressed bytes
+    {
+        PyObject *decompressed = decompress_frame(bytes, length);
+        if (decompressed == NULL) return NULL;
+
+        PyObject *result = to_value_workers((const unsigned char *)PyBytes_AS_STRING(decompressed), (size_t)PyBytes_GET_SIZE(decompressed), workers, oob);
+        Py_DECREF(decompressed);
+
+        return result;
+    }
+    case PROT_OOB: // A frame with out-of-band buffers, decoded from the bytes within it
+    {
+        if (!oob)
         {
-            PyErr_SetString(PyExc_MemoryError, "No available memory space.");
+            PyErr_SetString(PyExc_ValueError, "The bytes hold out-of-band buffers, which are only converted back if that's allowed with 'oob=True'.");
             return NULL;
         }
 
-        // Allocate the space for the bytes object
-        bd->bytes = (unsigned char *)malloc((size_t)bytes_length);
-        if (bd->bytes == NULL)
+        return to_value_oob(bytes, length, workers);
+    }
+    default: // Likely received an invalid bytes object
+    {
+        PyErr_Format(PyExc_ValueError, "Likely received an invalid bytes object: invalid protocol marker.");
+        return NULL;
+    }
+    }
+}
+
+PyObject *load_value(PyObject *file, size_t chunk_size)
+{
+    if (chunk_size < ALLOC_SIZE) chunk_size = ALLOC_SIZE;
+
+    ByteStream stream = {file, (unsigned char *)malloc(chunk_size), chunk_size};
+    if (stream.buffer == NULL) return PyErr_NoMemory();
+
+    // Start with an empty window, the first check for the protocol marker fills it
+    ByteData bd = {0, 0, stream.buffer, &stream};
+
+    PyObject *value = NULL;
+    if (ensure_offset(&bd, 1) != -1)
+    {
+        if (bd.bytes[0] == PROT_D)
         {
-            free(bd);
-            PyErr_SetString(PyExc_MemoryError, "No available memory space.");
-            return NULL;
+            bd.offset = 1;
+            value = to_root(&bd);
+            COUNT_STAT(decodes, 1);
         }
+        else
+            PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: invalid protocol marker, or a protocol that can't be streamed.");
+    }
 
-        // Write the bytes and offset to the bytedata
-        memcpy((unsigned char *)(bd->bytes), bytes, (size_t)bytes_length);
-        bd->offset = 1; // Start at offset 1 to exclude the prototype marker
-        bd->max_offset = (size_t)bytes_length; // Set the max offset to the bytes length
+    // Seek back over the bytes we read past the value, so that the file can hold more after it
+    size_t unread = bd.max_offset - bd.offset;
+    if (value != NULL && unread > 0)
+    {
+        PyObject *result = PyObject_CallMethod(file, "seek", "ni", -(Py_ssize_t)unread, 1);
 
-        // Use and return the to-any-value conversion function
-        PyObject *result = to_any_value(bd);
-        free((void *)(bd->bytes));
-        free(bd);
+        // Files that can't seek only hold a single value
+        if (result == NULL) PyErr_Clear();
+        Py_XDECREF(result);
+    }
 
-        return result;
+    free(stream.buffer);
+    return value;
+}
+
+PyObject *to_value_buf(const unsigned char *bytes, size_t length)
+{
+    return to_value_workers(bytes, length, 1, 0);
+}
+
+PyObject *to_value_buf_oob(const unsigned char *bytes, size_t length)
+{
+    return to_value_workers(bytes, length, 1, 1);
+}
+
+PyObject *to_value(PyObject *py_bytes, int workers, int oob)
+{
+    // Get the buffer of the object, this works for any object supporting the buffer protocol
+    Py_buffer view;
+    if (PyObject_GetBuffer(py_bytes, &view, PyBUF_SIMPLE) == -1)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a bytes-like object (supporting the buffer protocol).");
+        return NULL;
     }
-    case PROT_1: return to_value_prot1(py_bytes);
-    default: // Likely received an invalid bytes object
+
+    // Decode directly from the buffer, which stays exported so that it can't change if the GIL is released
+    PyObject *result = to_value_workers((const unsigned char *)view.buf, (size_t)view.len, workers, oob);
+
+    PyBuffer_Release(&view);
+    return result;
+}
+
+// # Lazy views
+
+/*
+  The to-conversion functions above create every nested value up front.
+  For big containers of which only a few items are needed, that's a lot
+  of wasted work. Views create them lazily instead.
+
+  A view is created for lists, tuples and dicts. It holds the offset of
+  the container and the number of items, read from its size header. On
+  the first access, it skip-scans over the items to find where each of
+  them starts. That only reads the size headers, so no Python objects
+  are created, except for the keys of dicts as we need those to look
+  items up. The items themselves are created once they're accessed, and
+  nested lists, tuples and dicts become views as well.
+
+  All views over the same buffer share a memoryview of it, which keeps
+  the buffer exported (and so alive and unresizable) for as long as any
+  of the views are.
+
+*/
+
+// Read the size header of a value written by write_E12D, leaving the offset right after it. The variant is 0 to 4 for E, 1, 2, D1 and D2
+static inline int read_E12D(ByteData *bd, size_t variant, size_t *size)
+{
+    size_t size_bytes_length;
+
+    switch (variant)
     {
-        PyErr_Format(PyExc_ValueError, "Likely received an invalid bytes object: invalid protocol marker.");
+    case 0:
+    {
+        if (ensure_offset(bd, 1) == -1) return -1;
+        bd->offset++;
+        *size = 0;
+        return 0;
+    }
+    case 1:
+    case 2:
+    {
+        size_bytes_length = variant;
+        break;
+    }
+    case 3:
+    {
+        size_bytes_length = D1_length(bd);
+        if (size_bytes_length == 0) return -1;
+        break;
+    }
+    default:
+    {
+        size_bytes_length = D2_length(bd);
+        if (size_bytes_length == 0) return -1;
+        break;
+    }
+    }
+
+    // A size doesn't fit in more bytes than a size_t holds
+    if (size_bytes_length > sizeof(size_t))
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid bytes object: size header too long.");
+        return -1;
+    }
+
+    if (ensure_offset(bd, size_bytes_length + 1) == -1) return -1;
+
+    *size = bytes_to_size_t(&(bd->bytes[++bd->offset]), size_bytes_length);
+    bd->offset += size_bytes_length;
+    return 0;
+}
+
+// Skip over a value with a size header followed by that many bytes
+static inline int skip_bytes(ByteData *bd, size_t variant)
+{
+    size_t length;
+    if (read_E12D(bd, variant, &length) == -1 || ensure_offset(bd, length) == -1) return -1;
+
+    bd->offset += length;
+    return 0;
+}
+
+static int skip_value(ByteData *bd);
+
+// Skip over a value with a size header followed by that many items, `per_item` values each
+static inline int skip_items(ByteData *bd, size_t variant, size_t per_item)
+{
+    size_t num_items;
+    if (read_E12D(bd, variant, &num_items) == -1 || ensure_items(bd, num_items) == -1) return -1;
+
+    for (size_t i = 0; i < num_items * per_item; ++i)
+        if (skip_value(bd) == -1) return -1;
+
+    return 0;
+}
+
+// Skip over the value at the offset without creating it. Returns -1 on invalid bytes
+static int skip_value(ByteData *bd)
+{
+    if (ensure_offset(bd, 1) == -1) return -1;
+
+    const unsigned char datachar = bd->bytes[bd->offset];
+    size_t jump = 0;
+
+    switch (datachar)
+    {
+    case STR_E: case STR_1: case STR_2: case STR_D1: case STR_D2:
+        return skip_bytes(bd, datachar - STR_E);
+    case BYTES_E: case BYTES_1: case BYTES_2: case BYTES_D1: case BYTES_D2:
+        return skip_bytes(bd, datachar - BYTES_E);
+    case BYTEARR_E: case BYTEARR_1: case BYTEARR_2: case BYTEARR_D1: case BYTEARR_D2:
+        return skip_bytes(bd, datachar - BYTEARR_E);
+    case MEMVIEW_E: case MEMVIEW_1: case MEMVIEW_2: case MEMVIEW_D1: case MEMVIEW_D2:
+        return skip_bytes(bd, datachar - MEMVIEW_E);
+    // Decimals don't have an empty datachar, so their variants start at 1
+    case DECIMAL_1: case DECIMAL_2: case DECIMAL_D1: case DECIMAL_D2:
+        return skip_bytes(bd, datachar - DECIMAL_1 + 1);
+    case PATH_E: case PATH_1: case PATH_2: case PATH_D1: case PATH_D2:
+        return skip_bytes(bd, datachar - PATH_E);
+    case PPATH_E: case PPATH_1: case PPATH_2: case PPATH_D1: case PPATH_D2:
+        return skip_bytes(bd, datachar - PPATH_E);
+
+    case LIST_E: case LIST_1: case LIST_2: case LIST_D1: case LIST_D2:
+        return skip_items(bd, datachar - LIST_E, 1);
+    case TUPLE_E: case TUPLE_1: case TUPLE_2: case TUPLE_D1: case TUPLE_D2:
+        return skip_items(bd, datachar - TUPLE_E, 1);
+    case SET_E: case SET_1: case SET_2: case SET_D1: case SET_D2:
+        return skip_items(bd, datachar - SET_E, 1);
+    case FSET_E: case FSET_1: case FSET_2: case FSET_D1: case FSET_D2:
+        return skip_items(bd, datachar - FSET_E, 1);
+    case DEQUE_E: case DEQUE_1: case DEQUE_2: case DEQUE_D1: case DEQUE_D2:
+        return skip_items(bd, datachar - DEQUE_E, 1);
+    case CHAINMAP_E: case CHAINMAP_1: case CHAINMAP_2: case CHAINMAP_D1: case CHAINMAP_D2:
+        return skip_items(bd, datachar - CHAINMAP_E, 1);
+    case DICT_E: case DICT_1: case DICT_2: case DICT_D1: case DICT_D2:
+        return skip_items(bd, datachar - DICT_E, 2);
+    case COUNTER_E: case COUNTER_1: case COUNTER_2: case COUNTER_D1: case COUNTER_D2:
+        return skip_items(bd, datachar - COUNTER_E, 2);
+    case ODICT_E: case ODICT_1: case ODICT_2: case ODICT_D1: case ODICT_D2:
+        return skip_items(bd, datachar - ODICT_E, 2);
+
+    case SDICT_E: case SDICT_1: case SDICT_2: case SDICT_D1: case SDICT_D2:
+    {
+        size_t num_items;
+        if (read_E12D(bd, datachar - SDICT_E, &num_items) == -1 || ensure_items(bd, num_items) == -1) return -1;
+
+        // The run of keys, each being a size byte and the string bytes
+        for (size_t i = 0; i < num_items; ++i)
+        {
+            if (ensure_offset(bd, 1) == -1 || ensure_offset(bd, 1 + bd->bytes[bd->offset]) == -1) return -1;
+            bd->offset += 1 + bd->bytes[bd->offset];
+        }
+
+        for (size_t i = 0; i < num_items; ++i)
+            if (skip_value(bd) == -1) return -1;
+
+        return 0;
+    }
+    case NTUPLE_E:
+    {
+        // Only the name follows
+        bd->offset++;
+        return skip_value(bd);
+    }
+    case NTUPLE_1: case NTUPLE_2: case NTUPLE_D1: case NTUPLE_D2:
+    {
+        size_t num_items;
+        if (read_E12D(bd, datachar - NTUPLE_E, &num_items) == -1 || ensure_items(bd, num_items) == -1) return -1;
+
+        // The name, and the field and item of each pair
+        for (size_t i = 0; i < 1 + num_items * 2; ++i)
+            if (skip_value(bd) == -1) return -1;
+
+        return 0;
+    }
+    case PACKED_S:
+    {
+        // The header ensures the items fit
+        unsigned char container;
+        char typecode;
+        size_t itemsize, num_items;
+        if (read_packed_header(bd, &container, &typecode, &itemsize, &num_items) == -1) return -1;
+
+        bd->offset += num_items * itemsize;
+        return 0;
+    }
+    case RANGE_S:
+    {
+        // The start, stop and step follow
+        bd->offset++;
+        for (int i = 0; i < 3; ++i)
+            if (skip_value(bd) == -1) return -1;
+
+        return 0;
+    }
+
+    case INT_1: case INT_2: case INT_3: case INT_4: case INT_5:
+    {
+        jump = 1 + (datachar - INT_1 + 1);
+        break;
+    }
+    case INT_D1:
+    {
+        if (ensure_offset(bd, 2) == -1) return -1;
+        jump = 2 + bd->bytes[bd->offset + 1];
+        break;
+    }
+    case INT_D2:
+    {
+        // Leaves the offset at the last size byte
+        size_t length = D2_length(bd);
+        if (length == 0) return -1;
+        jump = 1 + length;
+        break;
+    }
+    case DATETIME_DT: case DATETIME_D: case DATETIME_T:
+    {
+        if (ensure_offset(bd, 2) == -1) return -1;
+        jump = 2 + bd->bytes[bd->offset + 1];
+        break;
+    }
+    case REF_1:       jump = 2; break;
+    case REF_2:       jump = 3; break;
+    case OOB_S:       jump = 17; break;
+    case FLOAT_S:     jump = 1 + sizeof(double); break;
+    case COMPLEX_S:   jump = 1 + 2 * sizeof(double); break;
+    case DATETIME_TD: jump = 1 + 3 * sizeof(int); break;
+    case UUID_S:      jump = 33; break;
+    case BOOL_T:
+    case BOOL_F:
+    case NONE_S:
+    case ELLIPSIS_S:  jump = 1; break;
+    default:
+    {
+        PyErr_Format(PyExc_ValueError, "Likely received an invalid bytes object: fetched an invalid datatype representative. (Rep. code: %i)", (int)datachar);
+        return -1;
+    }
+    }
+
+    if (ensure_offset(bd, jump) == -1) return -1;
+
+    bd->offset += jump;
+    return 0;
+}
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;            // The memoryview of the buffer, shared by all views over it
+    const unsigned char *bytes; // The bytes of the buffer
+    size_t length;              // The length of the buffer
+    size_t offset;              // The offset of the datachar of the container
+    size_t start;               // The offset of the first item, right after the size header
+    size_t count;               // The number of items
+    size_t *offsets;            // The offsets of the items (the values, for dicts), NULL until scanned
+    PyObject **items;           // The items created so far
+    PyObject *keys;             // For dicts, the keys mapped to the index of their item
+    PyObject *key_list;         // For dicts, the keys in their original order
+} ViewObject;
+
+static void View_dealloc(ViewObject *self)
+{
+    if (self->items != NULL)
+    {
+        for (size_t i = 0; i < self->count; ++i)
+            Py_XDECREF(self->items[i]);
+        PyMem_Free(self->items);
+    }
+
+    PyMem_Free(self->offsets);
+    Py_XDECREF(self->keys);
+    Py_XDECREF(self->key_list);
+    Py_XDECREF(self->owner);
+    PyObject_Free(self);
+}
+
+// Create a view of the value at the offset if it's a list, tuple or dict, or the value itself otherwise
+static PyObject *make_view(PyObject *owner, const unsigned char *bytes, size_t length, size_t offset)
+{
+    ByteData bd = {offset, length, bytes, NULL};
+    if (ensure_offset(&bd, 1) == -1) return NULL;
+
+    const unsigned char datachar = bytes[offset];
+    PyTypeObject *type;
+    size_t variant;
+
+    // Empty containers are just as cheap to create directly
+    switch (datachar)
+    {
+    case LIST_1: case LIST_2: case LIST_D1: case LIST_D2:
+        type = &ListViewType; variant = datachar - LIST_E; break;
+    case TUPLE_1: case TUPLE_2: case TUPLE_D1: case TUPLE_D2:
+        type = &ListViewType; variant = datachar - TUPLE_E; break;
+    case DICT_1: case DICT_2: case DICT_D1: case DICT_D2:
+        type = &DictViewType; variant = datachar - DICT_E; break;
+    case SDICT_1: case SDICT_2: case SDICT_D1: case SDICT_D2:
+        type = &DictViewType; variant = datachar - SDICT_E; break;
+    default:
+        return to_any_value(&bd);
+    }
+
+    size_t count;
+    if (read_E12D(&bd, variant, &count) == -1 || ensure_items(&bd, count) == -1) return NULL;
+
+    ViewObject *self = PyObject_New(ViewObject, type);
+    if (self == NULL) return NULL;
+
+    Py_INCREF(owner);
+    self->owner = owner;
+    self->bytes = bytes;
+    self->length = length;
+    self->offset = offset;
+    self->start = bd.offset;
+    self->count = count;
+    self->offsets = NULL;
+    self->items = NULL;
+    self->keys = NULL;
+    self->key_list = NULL;
+
+    return (PyObject *)self;
+}
+
+// Scan over the items to find their offsets, and read the keys of dicts
+static int scan_view(ViewObject *self)
+{
+    if (self->offsets != NULL) return 0;
+
+    // The count was checked against the length of the buffer, so these allocations are bounded by it
+    size_t *offsets = PyMem_Malloc((self->count ? self->count : 1) * sizeof(size_t));
+    PyObject **items = PyMem_Calloc(self->count ? self->count : 1, sizeof(PyObject *));
+    PyObject *keys = NULL;
+    PyObject *key_list = NULL;
+
+    if (offsets == NULL || items == NULL)
+    {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    ByteData bd = {self->start, self->length, self->bytes, NULL};
+    const unsigned char datachar = self->bytes[self->offset];
+
+    if (Py_TYPE(self) == &DictViewType)
+    {
+        keys = PyDict_New();
+        key_list = PyList_New((Py_ssize_t)self->count);
+        if (keys == NULL || key_list == NULL) goto error;
+
+        int compact = datachar >= SDICT_E && datachar <= SDICT_D2;
+
+        for (size_t i = 0; i < self->count; ++i)
+        {
+            PyObject *key;
+
+            if (compact)
+            {
+                // The keys come first, each being a size byte and the string bytes
+                if (ensure_offset(&bd, 1) == -1) goto error;
+                size_t size = bd.bytes[bd.offset];
+                if (ensure_offset(&bd, 1 + size) == -1) goto error;
+
+                key = decode_str(&(bd.bytes[bd.offset + 1]), size);
+                if (key == NULL) goto error;
+
+                PyUnicode_InternInPlace(&key);
+                bd.offset += 1 + size;
+            }
+            else
+            {
+                // The keys sit right before their value
+                key = to_any_value(&bd);
+                if (key == NULL) goto error;
+
+                offsets[i] = bd.offset;
+                if (skip_value(&bd) == -1)
+                {
+                    Py_DECREF(key);
+                    goto error;
+                }
+            }
+
+            // The list steals the reference, and the dict takes its own
+            PyList_SET_ITEM(key_list, (Py_ssize_t)i, key);
+
+            PyObject *index = PyLong_FromSize_t(i);
+            if (index == NULL || PyDict_SetItem(keys, key, index) == -1)
+            {
+                Py_XDECREF(index);
+                goto error;
+            }
+            Py_DECREF(index);
+        }
+
+        // The values of compact dicts come after the run of keys
+        for (size_t i = 0; compact && i < self->count; ++i)
+        {
+            offsets[i] = bd.offset;
+            if (skip_value(&bd) == -1) goto error;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < self->count; ++i)
+        {
+            offsets[i] = bd.offset;
+            if (skip_value(&bd) == -1) goto error;
+        }
+    }
+
+    // Only set them once everything succeeded, as creating the keys might have run other code
+    self->offsets = offsets;
+    self->items = items;
+    self->keys = keys;
+    self->key_list = key_list;
+    return 0;
+
+error:
+    PyMem_Free(offsets);
+    PyMem_Free(items);
+    Py_XDECREF(keys);
+    Py_XDECREF(key_list);
+    return -1;
+}
+
+// Get the item at an index, creating it on the first access
+static PyObject *view_item(ViewObject *self, size_t index)
+{
+    if (scan_view(self) == -1) return NULL;
+
+    if (self->items[index] == NULL)
+    {
+        self->items[index] = make_view(self->owner, self->bytes, self->length, self->offsets[index]);
+        if (self->items[index] == NULL) return NULL;
+    }
+
+    Py_INCREF(self->items[index]);
+    return self->items[index];
+}
+
+// Create the full value of the view, just like to_value would
+static PyObject *View_decode(ViewObject *self, PyObject *Py_UNUSED(ignored))
+{
+    ByteData bd = {self->offset, self->length, self->bytes, NULL};
+    return to_any_value(&bd);
+}
+
+static Py_ssize_t View_length(ViewObject *self)
+{
+    return (Py_ssize_t)self->count;
+}
+
+static PyObject *View_richcompare(PyObject *self, PyObject *other, int op)
+{
+    if (op != Py_EQ && op != Py_NE) Py_RETURN_NOTIMPLEMENTED;
+
+    // Compare the full values, as that's what the view stands for
+    PyObject *value = View_decode((ViewObject *)self, NULL);
+    if (value == NULL) return NULL;
+
+    PyObject *other_value;
+    if (Py_TYPE(other) == &ListViewType || Py_TYPE(other) == &DictViewType)
+        other_value = View_decode((ViewObject *)other, NULL);
+    else
+    {
+        Py_INCREF(other);
+        other_value = other;
+    }
+
+    PyObject *result = other_value == NULL ? NULL : PyObject_RichCompare(value, other_value, op);
+
+    Py_DECREF(value);
+    Py_XDECREF(other_value);
+    return result;
+}
+
+static PyObject *View_repr(ViewObject *self)
+{
+    return PyUnicode_FromFormat("<%s of %zu items>", Py_TYPE(self)->tp_name, self->count);
+}
+
+// ## List views
+
+static PyObject *ListView_item(ViewObject *self, Py_ssize_t index)
+{
+    if (index < 0 || (size_t)index >= self->count)
+    {
+        PyErr_SetString(PyExc_IndexError, "View index out of range.");
+        return NULL;
+    }
+
+    return view_item(self, (size_t)index);
+}
+
+static PyObject *ListView_subscript(ViewObject *self, PyObject *key)
+{
+    if (PyIndex_Check(key))
+    {
+        Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if (index == -1 && PyErr_Occurred()) return NULL;
+
+        // Allow negative indexes, just like regular lists
+        if (index < 0) index += (Py_ssize_t)self->count;
+        return ListView_item(self, index);
+    }
+
+    if (!PySlice_Check(key))
+    {
+        PyErr_SetString(PyExc_TypeError, "View indices must be integers or slices.");
+        return NULL;
+    }
+
+    Py_ssize_t start, stop, step;
+    if (PySlice_Unpack(key, &start, &stop, &step) == -1) return NULL;
+    Py_ssize_t length = PySlice_AdjustIndices((Py_ssize_t)self->count, &start, &stop, step);
+
+    // Slices give a list of the items, which are still views for nested containers
+    PyObject *list = PyList_New(length);
+    if (list == NULL) return NULL;
+
+    for (Py_ssize_t i = 0; i < length; ++i)
+    {
+        PyObject *item = view_item(self, (size_t)(start + i * step));
+        if (item == NULL)
+        {
+            Py_DECREF(list);
+            return NULL;
+        }
+
+        PyList_SET_ITEM(list, i, item);
+    }
+
+    return list;
+}
+
+static PySequenceMethods ListView_sequence = {
+    .sq_length = (lenfunc)View_length,
+    .sq_item = (ssizeargfunc)ListView_item,
+};
+
+static PyMappingMethods ListView_mapping = {
+    .mp_length = (lenfunc)View_length,
+    .mp_subscript = (binaryfunc)ListView_subscript,
+};
+
+static PyMethodDef ListView_methods[] = {
+    {"decode", (PyCFunction)View_decode, METH_NOARGS, "Create the full list or tuple the view stands for."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject ListViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "pybytes.ListView",
+    .tp_doc = "A lazy view of a serialized list or tuple, creating its items once they're accessed.",
+    .tp_basicsize = sizeof(ViewObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)View_dealloc,
+    .tp_repr = (reprfunc)View_repr,
+    .tp_richcompare = View_richcompare,
+    .tp_as_sequence = &ListView_sequence,
+    .tp_as_mapping = &ListView_mapping,
+    .tp_methods = ListView_methods,
+};
+
+// ## Dict views
+
+// Find the index of the item of a key. Returns 1 if found, 0 if not, or -1 on error
+static int find_view_key(ViewObject *self, PyObject *key, size_t *index)
+{
+    if (scan_view(self) == -1) return -1;
+
+    PyObject *found = PyDict_GetItemWithError(self->keys, key);
+    if (found == NULL) return PyErr_Occurred() ? -1 : 0;
+
+    *index = PyLong_AsSize_t(found);
+    return 1;
+}
+
+static PyObject *DictView_subscript(ViewObject *self, PyObject *key)
+{
+    size_t index;
+    int found = find_view_key(self, key, &index);
+
+    if (found == -1) return NULL;
+    if (found == 0)
+    {
+        PyErr_SetObject(PyExc_KeyError, key);
         return NULL;
     }
+
+    return view_item(self, index);
+}
+
+static int DictView_contains(ViewObject *self, PyObject *key)
+{
+    size_t index;
+    return find_view_key(self, key, &index);
+}
+
+static PyObject *DictView_iter(ViewObject *self)
+{
+    if (scan_view(self) == -1) return NULL;
+
+    return PyObject_GetIter(self->key_list);
+}
+
+static PyObject *DictView_get(ViewObject *self, PyObject *args)
+{
+    PyObject *key;
+    PyObject *default_value = Py_None;
+
+    if (!PyArg_ParseTuple(args, "O|O", &key, &default_value)) return NULL;
+
+    size_t index;
+    int found = find_view_key(self, key, &index);
+
+    if (found == -1) return NULL;
+    if (found == 0)
+    {
+        Py_INCREF(default_value);
+        return default_value;
     }
+
+    return view_item(self, index);
+}
+
+static PyObject *DictView_keys(ViewObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (scan_view(self) == -1) return NULL;
+
+    return PyList_GetSlice(self->key_list, 0, (Py_ssize_t)self->count);
 }
 
+// Get the values, or the pairs of keys and values if `pairs` is set
+static PyObject *dict_view_values(ViewObject *self, int pairs)
+{
+    if (scan_view(self) == -1) return NULL;
+
+    PyObject *list = PyList_New((Py_ssize_t)self->count);
+    if (list == NULL) return NULL;
+
+    for (size_t i = 0; i < self->count; ++i)
+    {
+        PyObject *item = view_item(self, i);
+        if (item != NULL && pairs)
+        {
+            PyObject *pair = PyTuple_Pack(2, PyList_GET_ITEM(self->key_list, (Py_ssize_t)i), item);
+            Py_DECREF(item);
+            item = pair;
+        }
+
+        if (item == NULL)
+        {
+            Py_DECREF(list);
+            return NULL;
+        }
+
+        PyList_SET_ITEM(list, (Py_ssize_t)i, item);
+    }
+
+    return list;
+}
+
+static PyObject *DictView_values(ViewObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return dict_view_values(self, 0);
+}
+
+static PyObject *DictView_items(ViewObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return dict_view_values(self, 1);
+}
+
+static PySequenceMethods DictView_sequence = {
+    .sq_contains = (objobjproc)DictView_contains,
+};
+
+static PyMappingMethods DictView_mapping = {
+    .mp_length = (lenfunc)View_length,
+    .mp_subscript = (binaryfunc)DictView_subscript,
+};
+
+static PyMethodDef DictView_methods[] = {
+    {"get", (PyCFunction)DictView_get, METH_VARARGS, "Get the item of a key, or the default if it doesn't exist."},
+    {"keys", (PyCFunction)DictView_keys, METH_NOARGS, "Get a list of the keys."},
+    {"values", (PyCFunction)DictView_values, METH_NOARGS, "Get a list of the items."},
+    {"items", (PyCFunction)DictView_items, METH_NOARGS, "Get a list of the pairs of keys and items."},
+    {"decode", (PyCFunction)View_decode, METH_NOARGS, "Create the full dict the view stands for."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject DictViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "pybytes.DictView",
+    .tp_doc = "A lazy view of a serialized dict, creating its items once they're accessed.",
+    .tp_basicsize = sizeof(ViewObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)View_dealloc,
+    .tp_repr = (reprfunc)View_repr,
+    .tp_richcompare = View_richcompare,
+    .tp_iter = (getiterfunc)DictView_iter,
+    .tp_as_sequence = &DictView_sequence,
+    .tp_as_mapping = &DictView_mapping,
+    .tp_methods = DictView_methods,
+};
+
+PyObject *view_value(PyObject *buffer, int oob)
+{
+    // The memoryview keeps the buffer exported for as long as the views exist
+    PyObject *owner = PyMemoryView_FromObject(buffer);
+    if (owner == NULL) return NULL;
+
+    Py_buffer *view = PyMemoryView_GET_BUFFER(owner);
+    if (!PyBuffer_IsContiguous(view, 'C'))
+    {
+        Py_DECREF(owner);
+        PyErr_SetString(PyExc_ValueError, "Expected a contiguous bytes-like object.");
+        return NULL;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)view->buf;
+    size_t length = (size_t)view->len;
+
+    // Views of compressed frames are views of the decompressed bytes, which they keep alive
+    if (length != 0 && bytes[0] == PROT_Z)
+    {
+        PyObject *decompressed = decompress_frame(bytes, length);
+        Py_DECREF(owner);
+        if (decompressed == NULL) return NULL;
+
+        PyObject *result = view_value(decompressed, oob);
+        Py_DECREF(decompressed);
+
+        return result;
+    }
+
+    // Other protocols don't support views, so just convert those fully. The same goes for back-references, as they need every string before them
+    int lazy = length != 0 && bytes[0] == PROT_D && (length == 1 || bytes[1] != REFS_M);
+    if (lazy)
+    {
+        COUNT_STAT(decodes, 1);
+        COUNT_STAT(bytes_in, length);
+    }
+    PyObject *result = lazy ? make_view(owner, bytes, length, 1) : to_value_workers(bytes, length, 1, oob);
+
+    Py_DECREF(owner);
+    return result;
+}
@@ -6,7 +6,6 @@
 
 // Includes
 #include <Python.h>
-#include <datetime.h>
 #include <ctype.h>
 
 // Datetime module classes
@@ -20,6 +19,16 @@ extern PyObject *decimal_cl;
 // Namedtuple module class
 extern PyObject *namedtuple_cl;
 
+// A caller-supplied target to serialize into
+typedef struct SBSTarget SBSTarget;
+struct SBSTarget {
+    unsigned char *bytes; // The buffer to write to
+    size_t size;          // The size of the buffer
+    // Grow the buffer to hold at least `size` bytes and update the fields above. Returns -1 with an error set on failure
+    int (*grow)(SBSTarget *target, size_t size);
+    void *context;        // Free to use by the owner of the target
+};
+
 // Initialize the SBS module
 int sbs2_init(void);
 // Cleanup the SBS module
@@ -27,7 +36,47 @@ void sbs2_cleanup(void);
 
 // Convert a value to bytes
 PyObject *from_value(PyObject *value);
-// Convert a bytes object to the value it used to be
-PyObject *to_value(PyObject *bytes);
+// Convert a value to bytes, pre-allocating `size_hint` bytes to write to if it's not 0, with back-references to repeated strings if `refs` is set, and spreading large copies over `workers` threads
+PyObject *from_value_sized(PyObject *value, size_t size_hint, int refs, int workers);
+// Convert a value like from_value_sized, writing bytes, bytearrays and memoryviews of at least `threshold` bytes out-of-band to a shared memory segment if it's not 0
+PyObject *from_value_oob(PyObject *value, size_t size_hint, int refs, int workers, size_t threshold);
+// Release the segment of the out-of-band buffers of bytes, if it's one with a valid header. Returns 1 if it was released, 0 if the bytes don't have one (anymore), or -1 on error
+int release_oob_frame(const unsigned char *bytes, size_t length);
+// Convert a value to bytes written directly to a target. Returns the number of bytes written, or -1 on error
+Py_ssize_t from_value_into(PyObject *value, SBSTarget *target, int refs);
+// Convert a value to bytes written to a file in chunks. Returns the number of bytes written, or -1 on error
+Py_ssize_t dump_value(PyObject *value, PyObject *file, size_t chunk_size, int refs);
+// Convert a bytes-like object to the value it used to be, spreading large copies over `workers` threads, and mapping the segments of out-of-band frames if `oob` is set
+PyObject *to_value(PyObject *bytes, int workers, int oob);
+// Convert the bytes read from a file in chunks to the value they used to be
+PyObject *load_value(PyObject *file, size_t chunk_size);
+// Convert a C buffer to the value it used to be, without copying it
+PyObject *to_value_buf(const unsigned char *bytes, size_t length);
+// Same as above, but also maps the segments of out-of-band frames. Only for bytes from a source that's trusted to name the segments to map
+PyObject *to_value_buf_oob(const unsigned char *bytes, size_t length);
+// The default min size of bytes to compress
+#define COMPRESS_THRESHOLD 4096
+// Compress the bytes of a value into a frame at a zlib level of 1 to 9, or get the same bytes back if `level` is 0 or they're smaller than `threshold`
+PyObject *compress_value(PyObject *bytes, int level, size_t threshold);
+// Create a lazy view of a bytes-like object, only creating the items of lists, tuples and dicts once they're accessed. Maps the segments of out-of-band frames if `oob` is set
+PyObject *view_value(PyObject *buffer, int oob);
+
+// The counts of the work done by the conversion functions, summed over all threads
+typedef struct {
+    uint64_t encodes;   // Values converted to bytes
+    uint64_t decodes;   // Values converted back from bytes
+    uint64_t bytes_out; // Bytes written by the encodes
+    uint64_t bytes_in;  // Bytes read by the decodes, after decompressing
+    uint64_t reallocs;  // Times an encode had to grow its buffer
+} SBSStats;
+
+// Enable or disable counting the work done by the conversion functions, which is disabled by default
+void sbs_enable_stats(int enabled);
+// Get the counts of all threads, resetting them to 0 if `reset` is set
+void sbs_get_stats(SBSStats *stats, int reset);
+
+// The types of the lazy views
+extern PyTypeObject ListViewType;
+extern PyTypeObject DictViewType;
 
 #endif // SBS_2_H
\ No newline at end of file
@@ -1,5 +1,15 @@
+#define PY_SSIZE_T_CLEAN
+
+#include <Python.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbs_main/sbs_2.h"
+#include "sfs_1.h"
+
 /*
-  ## Explanation for the SFS (Simple File System) protocol # (PREVIEW, DOES NOT EXIST YET!)
+  ## Explanation for the SFS (Simple File System) protocol
 
   # Quick note
 
@@ -7,9 +17,6 @@
   explained here. Those are explained in 'sbs_X.c' (X can vary, it
   should be the file placed directly under sysframe/pybytes).
 
-  Also, this protocol is not yet implemented. Still working on
-  the SBS protocol.
-
 
   # What is the 'Simple File System' protocol?
 
@@ -17,12 +24,762 @@
   That being, a file system. Unlike regular serialization methods,
   a file system does not have to read the entire storage to read,
   modify, or add a file. Just like this protocol, which allows us
-  to read and modify an index without having to do omething with
-  the other values. Of course it will also be possible to get the
-  entire list/dict back as a regular value.
+  to read and modify an index without having to do something with
+  the other values. Of course it's also possible to get the entire
+  list/dict back as a regular value.
 
   This provides advantages in overhead compared to the full conversion
   of a value with regular serialization. This is particularly useful
-  when a container type
+  when a container is shared (for example through membridge) and only
+  one of its items changes at a time.
+
+
+  # The layout
+
+  An SFS buffer consists of a header, an index, and the entries:
+
+  [ header (48 bytes) ][ ... entries and the index ... ]
+
+  The header holds the protocol marker (PROT_SFS_1, so the regular
+  to-value functions can tell it apart from SBS bytes), the kind of
+  container, the number of items, the capacity and offset of the
+  index, the number of bytes used, and the number of those bytes
+  that aren't referenced anymore (the garbage).
+
+  The index has a slot per item, holding the hash, offset and size
+  of the key, and the offset, size and space of the value. The key
+  and value are regular SBS bytes, including the protocol marker, so
+  they're encoded and decoded with the regular SBS functions.
+
+  For lists, slot X simply belongs to item X, and there's no key.
+  For dicts, the index is an open-addressing hash table over the SBS
+  bytes of the keys (so keys are compared by their serialized form),
+  using linear probing. A slot with a value offset of 0 is empty, as
+  that offset is always part of the header.
+
+
+  # Modifying items
+
+  When an item gets a new value that fits in the space of the old
+  value, it's written over the old value. Only those bytes and the
+  slot are touched then. Otherwise, the value is appended to the end
+  with some extra space to grow into, and the old value becomes
+  garbage. New keys in a dict are appended the same way.
+
+  When the index of a dict gets too full, a new index with double the
+  capacity is appended, and the old index becomes garbage. So the
+  index doesn't have to stay at the start of the buffer. The header
+  just points to where it is.
+
+  When the buffer needs to grow while at least half of it is garbage,
+  it's compacted first. This rewrites the whole buffer without the
+  garbage, keeping the keys in their original (insertion) order.
+
+  All numbers are stored in the native byte order and aren't aligned,
+  so they're only read and written through memcpy.
+
+*/
+
+// # Definitions
+
+// The kinds of containers
+#define SFS_DICT 0
+#define SFS_LIST 1
+
+typedef struct {
+    unsigned char marker;      // The protocol marker
+    unsigned char kind;        // The kind of container
+    unsigned char reserved[6]; // Reserved for future use, always zero
+    uint64_t count;            // The number of items
+    uint64_t capacity;         // The number of slots in the index
+    uint64_t index_offset;     // The offset of the index
+    uint64_t used;             // The number of bytes used, including the header
+    uint64_t garbage;          // The number of used bytes that aren't referenced anymore
+} SFSHeader;
+
+typedef struct {
+    uint64_t hash;         // The hash of the key bytes
+    uint64_t key_offset;   // The offset of the key bytes
+    uint64_t key_size;     // The size of the key bytes
+    uint64_t value_offset; // The offset of the value bytes, 0 if the slot is empty
+    uint64_t value_size;   // The size of the value bytes
+    uint64_t value_space;  // The space available for the value bytes
+} SFSSlot;
+
+#define HEADER_SIZE sizeof(SFSHeader)
+#define SLOT_SIZE sizeof(SFSSlot)
+
+// The minimum capacity of the index of a dict
+#define MIN_CAPACITY 8
+
+// # Helper functions
+
+static inline void invalid_sfs(void)
+{
+    PyErr_SetString(PyExc_ValueError, "Likely received an invalid SFS buffer.");
+}
+
+// FNV-1a hash over the bytes of a key
+static inline uint64_t hash_bytes(const unsigned char *bytes, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// Whether a dict index of `capacity` slots is too full for `count` items, keeping at least a quarter free for short probes
+static inline int index_too_full(uint64_t count, uint64_t capacity)
+{
+    return count * 4 > capacity * 3;
+}
+
+// Get the capacity of a dict index that holds `count` items with enough free slots
+static inline uint64_t dict_capacity(uint64_t count)
+{
+    uint64_t capacity = MIN_CAPACITY;
+    while (index_too_full(count, capacity)) capacity *= 2;
+
+    return capacity;
+}
+
+// Read and validate the header of an SFS buffer of `length` bytes
+static inline int read_header(const unsigned char *bytes, size_t length, SFSHeader *header)
+{
+    if (length < HEADER_SIZE || bytes[0] != PROT_SFS_1)
+    {
+        PyErr_SetString(PyExc_ValueError, "Likely received an invalid SFS buffer: no SFS protocol marker found.");
+        return -1;
+    }
+
+    memcpy(header, bytes, HEADER_SIZE);
+
+    // Check that everything the header points to lies within the used bytes
+    if (header->kind > SFS_LIST ||
+        header->used > length || header->used < HEADER_SIZE ||
+        header->capacity > (header->used - HEADER_SIZE) / SLOT_SIZE ||
+        header->index_offset < HEADER_SIZE ||
+        header->index_offset > header->used - header->capacity * SLOT_SIZE ||
+        header->count > header->capacity ||
+        header->garbage > header->used ||
+        (header->kind == SFS_DICT && (header->capacity == 0 || (header->capacity & (header->capacity - 1)) != 0)))
+    {
+        invalid_sfs();
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline void write_header(unsigned char *bytes, const SFSHeader *header)
+{
+    memcpy(bytes, header, HEADER_SIZE);
+}
+
+static inline void get_slot(const unsigned char *bytes, const SFSHeader *header, uint64_t position, SFSSlot *slot)
+{
+    memcpy(slot, bytes + header->index_offset + position * SLOT_SIZE, SLOT_SIZE);
+}
+
+static inline void put_slot(unsigned char *bytes, const SFSHeader *header, uint64_t position, const SFSSlot *slot)
+{
+    memcpy(bytes + header->index_offset + position * SLOT_SIZE, slot, SLOT_SIZE);
+}
+
+// Check whether the key and value of a slot lie within the used bytes
+static inline int check_slot(const SFSHeader *header, const SFSSlot *slot)
+{
+    if (slot->value_space < slot->value_size ||
+        slot->value_space > header->used || slot->value_offset > header->used - slot->value_space ||
+        slot->key_size > header->used || slot->key_offset > header->used - slot->key_size)
+    {
+        invalid_sfs();
+        return -1;
+    }
+
+    return 0;
+}
+
+// Find the slot of a key in a dict. Returns 1 if found, 0 if not with the position set to a free slot, or -1 on error
+static inline int find_key(const unsigned char *bytes, const SFSHeader *header, const unsigned char *key, size_t key_size, uint64_t hash, uint64_t *position, SFSSlot *slot)
+{
+    uint64_t mask = header->capacity - 1;
+
+    // The probes are bounded by the capacity, so even a corrupted index can't loop forever
+    for (uint64_t probe = 0; probe < header->capacity; ++probe)
+    {
+        uint64_t index = (hash + probe) & mask;
+        get_slot(bytes, header, index, slot);
+
+        if (slot->value_offset == 0)
+        {
+            *position = index;
+            return 0;
+        }
+
+        if (slot->hash == hash && slot->key_size == key_size)
+        {
+            if (check_slot(header, slot) == -1) return -1;
+
+            if (memcmp(bytes + slot->key_offset, key, key_size) == 0)
+            {
+                *position = index;
+                return 1;
+            }
+        }
+    }
+
+    // The index is full, which only happens with a corrupted buffer
+    invalid_sfs();
+    return -1;
+}
+
+/*
+  Find the slot of an item by its key (or index, for lists). For dicts,
+  the key is serialized and handed back through `key_bytes`, so we can
+  write it as a new entry if it's not found. The caller has to release
+  it. If `key_bytes` already points to the serialized key, that's used
+  instead. Returns 1 if found, 0 if not, or -1 on error.
+
+*/
+static int locate_item(const unsigned char *bytes, const SFSHeader *header, PyObject *key, PyObject **key_bytes, uint64_t *hash, uint64_t *position, SFSSlot *slot)
+{
+    // Use the bytes of the key if the caller already has them
+    PyObject *given = *key_bytes;
+    *key_bytes = NULL;
+
+    if (header->kind == SFS_LIST)
+    {
+        if (!PyLong_Check(key))
+        {
+            PyErr_SetString(PyExc_TypeError, "SFS list indices must be integers.");
+            return -1;
+        }
+
+        Py_ssize_t index = PyLong_AsSsize_t(key);
+        if (index == -1 && PyErr_Occurred()) return -1;
+
+        // Allow negative indexes, just like regular lists
+        if (index < 0) index += (Py_ssize_t)header->count;
+
+        if (index < 0 || (uint64_t)index >= header->count)
+        {
+            PyErr_SetString(PyExc_IndexError, "SFS list index out of range.");
+            return -1;
+        }
+
+        *position = (uint64_t)index;
+        get_slot(bytes, header, *position, slot);
+
+        if (slot->value_offset == 0 || check_slot(header, slot) == -1)
+        {
+            invalid_sfs();
+            return -1;
+        }
+
+        return 1;
+    }
+
+    if (given != NULL) Py_INCREF(given);
+    *key_bytes = given != NULL ? given : from_value(key);
+    if (*key_bytes == NULL) return -1;
+
+    const unsigned char *key_buf = (const unsigned char *)PyBytes_AS_STRING(*key_bytes);
+    size_t key_size = (size_t)PyBytes_GET_SIZE(*key_bytes);
+
+    *hash = hash_bytes(key_buf, key_size);
+    return find_key(bytes, header, key_buf, key_size, *hash, position, slot);
+}
+
+// Make sure the target can hold `size` more bytes after the used bytes
+static inline int reserve_bytes(SBSTarget *target, const SFSHeader *header, size_t size)
+{
+    if (header->used + size <= target->size) return 0;
+
+    return target->grow(target, header->used + size);
+}
+
+// Append bytes to the used bytes, which should have been reserved. Returns the offset they were written to
+static inline uint64_t append_bytes(SBSTarget *target, SFSHeader *header, const void *bytes, size_t size)
+{
+    uint64_t offset = header->used;
+    memcpy(target->bytes + offset, bytes, size);
+    header->used += size;
+
+    return offset;
+}
+
+// A slot with its position in the index, for sorting the entries
+typedef struct {
+    uint64_t position;
+    SFSSlot slot;
+} SFSEntry;
+
+static int compare_entries(const void *a, const void *b)
+{
+    uint64_t first = ((const SFSEntry *)a)->slot.key_offset;
+    uint64_t second = ((const SFSEntry *)b)->slot.key_offset;
+
+    return (first > second) - (first < second);
+}
+
+/*
+  Collect the filled slots of the index. For dicts, they're sorted by
+  the offset of their key, which is the order they were inserted in.
+  For lists, they're already in the right order.
+
+*/
+static SFSEntry *collect_entries(const unsigned char *bytes, const SFSHeader *header)
+{
+    SFSEntry *entries = (SFSEntry *)malloc((header->count ? header->count : 1) * sizeof(SFSEntry));
+    if (entries == NULL)
+    {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    uint64_t count = 0;
+    for (uint64_t position = 0; position < header->capacity; ++position)
+    {
+        SFSSlot slot;
+        get_slot(bytes, header, position, &slot);
+
+        if (slot.value_offset == 0) continue;
+
+        if (count == header->count || check_slot(header, &slot) == -1)
+        {
+            free(entries);
+            invalid_sfs();
+            return NULL;
+        }
+
+        entries[count].position = position;
+        entries[count].slot = slot;
+        ++count;
+    }
+
+    if (count != header->count)
+    {
+        free(entries);
+        invalid_sfs();
+        return NULL;
+    }
+
+    if (header->kind == SFS_DICT) qsort(entries, count, sizeof(SFSEntry), compare_entries);
+
+    return entries;
+}
+
+/*
+  Rewrite the buffer without the garbage. The index keeps its capacity
+  and slot positions, so a position found before compacting still
+  belongs to the same item afterwards. The values lose their spare
+  space, as that's part of what we're getting rid of.
+
+*/
+static int compact_buffer(SBSTarget *target, SFSHeader *header)
+{
+    SFSEntry *entries = collect_entries(target->bytes, header);
+    if (entries == NULL) return -1;
+
+    // The compacted buffer is never bigger than the current one
+    unsigned char *buffer = (unsigned char *)malloc(header->used);
+    if (buffer == NULL)
+    {
+        free(entries);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    SFSHeader compacted = *header;
+    compacted.index_offset = HEADER_SIZE;
+    compacted.used = HEADER_SIZE + header->capacity * SLOT_SIZE;
+    compacted.garbage = 0;
+
+    memset(buffer + HEADER_SIZE, 0, header->capacity * SLOT_SIZE);
+
+    for (uint64_t i = 0; i < header->count; ++i)
+    {
+        SFSSlot slot = entries[i].slot;
+
+        if (slot.key_size != 0)
+        {
+            memcpy(buffer + compacted.used, target->bytes + slot.key_offset, slot.key_size);
+            slot.key_offset = compacted.used;
+            compacted.used += slot.key_size;
+        }
+
+        memcpy(buffer + compacted.used, target->bytes + slot.value_offset, slot.value_size);
+        slot.value_offset = compacted.used;
+        slot.value_space = slot.value_size;
+        compacted.used += slot.value_size;
+
+        put_slot(buffer, &compacted, entries[i].position, &slot);
+    }
+
+    write_header(buffer, &compacted);
+    memcpy(target->bytes, buffer, compacted.used);
+    *header = compacted;
+
+    free(buffer);
+    free(entries);
+    return 0;
+}
+
+// Make sure the target can hold `size` more bytes, compacting it first if at least half of it is garbage
+static inline int make_room(SBSTarget *target, SFSHeader *header, size_t size)
+{
+    if (header->used + size <= target->size) return 0;
+
+    if (header->garbage > header->used / 2)
+    {
+        if (compact_buffer(target, header) == -1) return -1;
+        write_header(target->bytes, header);
+    }
+
+    return reserve_bytes(target, header, size);
+}
+
+// Append a new index with double the capacity to a dict, and move the filled slots over to it
+static int grow_index(SBSTarget *target, SFSHeader *header)
+{
+    uint64_t capacity = header->capacity * 2;
+    size_t index_size = capacity * SLOT_SIZE;
+
+    if (make_room(target, header, index_size) == -1) return -1;
+
+    SFSHeader grown = *header;
+    grown.capacity = capacity;
+    grown.index_offset = header->used;
+    grown.used = header->used + index_size;
+    grown.garbage = header->garbage + header->capacity * SLOT_SIZE;
+
+    memset(target->bytes + grown.index_offset, 0, index_size);
+
+    uint64_t mask = capacity - 1;
+    for (uint64_t position = 0; position < header->capacity; ++position)
+    {
+        SFSSlot slot;
+        get_slot(target->bytes, header, position, &slot);
+
+        if (slot.value_offset == 0) continue;
+
+        // Keys are unique, so take the first free slot
+        uint64_t index = slot.hash & mask;
+        while (1)
+        {
+            SFSSlot other;
+            get_slot(target->bytes, &grown, index, &other);
+            if (other.value_offset == 0) break;
+            index = (index + 1) & mask;
+        }
+
+        put_slot(target->bytes, &grown, index, &slot);
+    }
+
+    *header = grown;
+    write_header(target->bytes, header);
+    return 0;
+}
+
+// # The conversion functions
+
+Py_ssize_t sfs_from_value(PyObject *value, SBSTarget *target)
+{
+    SFSHeader header;
+    memset(&header, 0, HEADER_SIZE);
+    header.marker = PROT_SFS_1;
+
+    if (PyDict_CheckExact(value))
+    {
+        header.kind = SFS_DICT;
+        header.capacity = dict_capacity((uint64_t)PyDict_GET_SIZE(value));
+    }
+    else if (PyList_CheckExact(value))
+    {
+        header.kind = SFS_LIST;
+        header.capacity = (uint64_t)PyList_GET_SIZE(value);
+    }
+    else
+    {
+        PyErr_Format(PyExc_TypeError, "SFS only supports dicts and lists, got '%s'.", Py_TYPE(value)->tp_name);
+        return -1;
+    }
+
+    size_t index_size = header.capacity * SLOT_SIZE;
+    if (reserve_bytes(target, &header, HEADER_SIZE + index_size) == -1) return -1;
+
+    header.index_offset = HEADER_SIZE;
+    header.used = HEADER_SIZE + index_size;
+    memset(target->bytes + HEADER_SIZE, 0, index_size);
+
+    if (header.kind == SFS_LIST)
+    {
+        // The list might change size while its items are converted, so don't go past the capacity
+        for (Py_ssize_t i = 0; i < PyList_GET_SIZE(value) && (uint64_t)i < header.capacity; ++i)
+        {
+            PyObject *value_bytes = from_value(PyList_GET_ITEM(value, i));
+            if (value_bytes == NULL) return -1;
+
+            size_t value_size = (size_t)PyBytes_GET_SIZE(value_bytes);
+            if (reserve_bytes(target, &header, value_size) == -1)
+            {
+                Py_DECREF(value_bytes);
+                return -1;
+            }
+
+            SFSSlot slot = {0, 0, 0, 0, value_size, value_size};
+            slot.value_offset = append_bytes(target, &header, PyBytes_AS_STRING(value_bytes), value_size);
+            Py_DECREF(value_bytes);
+
+            put_slot(target->bytes, &header, (uint64_t)i, &slot);
+            ++header.count;
+        }
+
+        // Items that were removed meanwhile are left out of the list, leaving their slots unused
+        header.garbage += (header.capacity - header.count) * SLOT_SIZE;
+        header.capacity = header.count;
+    }
+    else
+    {
+        Py_ssize_t pos = 0;
+        PyObject *key, *item;
+
+        while (PyDict_Next(value, &pos, &key, &item))
+        {
+            // Keeping a reference as converting the value might run code that changes the dict
+            Py_INCREF(item);
+
+            uint64_t hash, position;
+            SFSSlot slot;
+            PyObject *key_bytes = NULL;
+
+            int found = locate_item(target->bytes, &header, key, &key_bytes, &hash, &position, &slot);
+            PyObject *value_bytes = found == -1 ? NULL : from_value(item);
+            Py_DECREF(item);
+
+            if (value_bytes == NULL)
+            {
+                Py_XDECREF(key_bytes);
+                return -1;
+            }
+
+            size_t key_size = (size_t)PyBytes_GET_SIZE(key_bytes);
+            size_t value_size = (size_t)PyBytes_GET_SIZE(value_bytes);
+
+            if (reserve_bytes(target, &header, key_size + value_size) == -1)
+            {
+                Py_DECREF(key_bytes);
+                Py_DECREF(value_bytes);
+                return -1;
+            }
+
+            if (found == 1)
+            {
+                // Different keys with the same serialized form end up in the same item
+                header.garbage += slot.value_space;
+            }
+            else
+            {
+                slot.hash = hash;
+                slot.key_size = key_size;
+                slot.key_offset = append_bytes(target, &header, PyBytes_AS_STRING(key_bytes), key_size);
+                ++header.count;
+            }
+
+            slot.value_size = value_size;
+            slot.value_space = value_size;
+            slot.value_offset = append_bytes(target, &header, PyBytes_AS_STRING(value_bytes), value_size);
+
+            Py_DECREF(key_bytes);
+            Py_DECREF(value_bytes);
+
+            put_slot(target->bytes, &header, position, &slot);
+
+            // The dict might have grown while its items were converted
+            if (index_too_full(header.count, header.capacity) && grow_index(target, &header) == -1) return -1;
+        }
+    }
+
+    write_header(target->bytes, &header);
+    return (Py_ssize_t)header.used;
+}
+
+PyObject *sfs_to_value(const unsigned char *bytes, size_t length)
+{
+    SFSHeader header;
+    if (read_header(bytes, length, &header) == -1) return NULL;
+
+    SFSEntry *entries = collect_entries(bytes, &header);
+    if (entries == NULL) return NULL;
+
+    PyObject *result = header.kind == SFS_LIST ? PyList_New((Py_ssize_t)header.count) : PyDict_New();
+    if (result == NULL)
+    {
+        free(entries);
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < header.count; ++i)
+    {
+        const SFSSlot *slot = &(entries[i].slot);
+
+        PyObject *item = to_value_buf(bytes + slot->value_offset, slot->value_size);
+        if (item == NULL)
+        {
+            Py_DECREF(result);
+            free(entries);
+            return NULL;
+        }
+
+        if (header.kind == SFS_LIST)
+        {
+            // Steals the reference to the item
+            PyList_SET_ITEM(result, (Py_ssize_t)i, item);
+            continue;
+        }
+
+        PyObject *key = to_value_buf(bytes + slot->key_offset, slot->key_size);
+        if (key == NULL || PyDict_SetItem(result, key, item) == -1)
+        {
+            Py_XDECREF(key);
+            Py_DECREF(item);
+            Py_DECREF(result);
+            free(entries);
+            return NULL;
+        }
+
+        Py_DECREF(key);
+        Py_DECREF(item);
+    }
+
+    free(entries);
+    return result;
+}
+
+// # The item functions
+
+int sfs_find_item(const unsigned char *bytes, size_t length, PyObject *key, size_t *offset, size_t *size)
+{
+    SFSHeader header;
+    if (read_header(bytes, length, &header) == -1) return -1;
+
+    uint64_t hash, position;
+    SFSSlot slot;
+    PyObject *key_bytes = NULL;
+
+    int found = locate_item(bytes, &header, key, &key_bytes, &hash, &position, &slot);
+    Py_XDECREF(key_bytes);
+
+    if (found == -1) return -1;
+    if (found == 0)
+    {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return -1;
+    }
+
+    *offset = (size_t)slot.value_offset;
+    *size = (size_t)slot.value_size;
+    return 0;
+}
+
+PyObject *sfs_get_item(const unsigned char *bytes, size_t length, PyObject *key)
+{
+    size_t offset, size;
+    if (sfs_find_item(bytes, length, key, &offset, &size) == -1) return NULL;
+
+    return to_value_buf(bytes + offset, size);
+}
+
+Py_ssize_t sfs_set_item(SBSTarget *target, size_t length, PyObject *key, PyObject *value)
+{
+    PyObject *value_bytes = from_value(value);
+    if (value_bytes == NULL) return -1;
+
+    Py_ssize_t result = sfs_set_item_bytes(target, length, key, NULL, value_bytes);
+    Py_DECREF(value_bytes);
+
+    return result;
+}
+
+Py_ssize_t sfs_set_item_bytes(SBSTarget *target, size_t length, PyObject *key, PyObject *key_bytes, PyObject *value_bytes)
+{
+    SFSHeader header;
+    if (read_header(target->bytes, length, &header) == -1) return -1;
+
+    uint64_t hash, position;
+    SFSSlot slot;
+
+    int found = locate_item(target->bytes, &header, key, &key_bytes, &hash, &position, &slot);
+    if (found == -1) return -1;
+
+    const char *value_buf = PyBytes_AS_STRING(value_bytes);
+    size_t value_size = (size_t)PyBytes_GET_SIZE(value_bytes);
+
+    // Nothing was modified until here, so the buffer stays valid on errors above
+    Py_ssize_t result = -1;
+
+    if (found == 1 && value_size <= slot.value_space)
+    {
+        // The new value fits in the space of the old one, so only rewrite this item
+        memcpy(target->bytes + slot.value_offset, value_buf, value_size);
+        slot.value_size = value_size;
+        put_slot(target->bytes, &header, position, &slot);
+
+        result = (Py_ssize_t)header.used;
+        goto done;
+    }
+
+    if (found == 0 && index_too_full(header.count + 1, header.capacity))
+    {
+        if (grow_index(target, &header) == -1) goto done;
+
+        // The free slot is somewhere else in the new index
+        const unsigned char *key_buf = (const unsigned char *)PyBytes_AS_STRING(key_bytes);
+        if (find_key(target->bytes, &header, key_buf, (size_t)PyBytes_GET_SIZE(key_bytes), hash, &position, &slot) == -1) goto done;
+    }
+
+    // Leave some space for the value to grow into, so it isn't moved on every growing update
+    size_t value_space = value_size + value_size / 4;
+    size_t key_size = found == 0 ? (size_t)PyBytes_GET_SIZE(key_bytes) : 0;
+
+    if (make_room(target, &header, key_size + value_space) == -1) goto done;
+
+    // Compacting moves the entries around, but the position of the slot stays the same
+    SFSSlot current;
+    get_slot(target->bytes, &header, position, &current);
+
+    if (found == 1)
+    {
+        slot = current;
+        header.garbage += slot.value_space;
+    }
+    else
+    {
+        slot.hash = hash;
+        slot.key_size = key_size;
+        slot.key_offset = append_bytes(target, &header, PyBytes_AS_STRING(key_bytes), key_size);
+        ++header.count;
+    }
+
+    slot.value_offset = append_bytes(target, &header, value_buf, value_size);
+    slot.value_size = value_size;
+    slot.value_space = value_space;
+
+    // Zero the spare space, so the buffer doesn't contain leftovers from the target
+    memset(target->bytes + header.used, 0, value_space - value_size);
+    header.used += value_space - value_size;
+
+    put_slot(target->bytes, &header, position, &slot);
+    write_header(target->bytes, &header);
+
+    result = (Py_ssize_t)header.used;
 
-*/
\ No newline at end of file
+done:
+    Py_XDECREF(key_bytes);
+    return result;
+}
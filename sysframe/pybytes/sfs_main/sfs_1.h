@@ -0,0 +1,29 @@
+#ifndef SFS_1_H
+#define SFS_1_H
+
+// Python define statement
+#define PY_SSIZE_T_CLEAN
+
+// Includes
+#include <Python.h>
+
+// The SBS definitions, including the target to write to
+#include "sbs_main/sbs_2.h"
+
+// The protocol marker of SFS buffers, next to the SBS protocol markers
+#define PROT_SFS_1 252
+
+// Convert a dict or list to an SFS buffer written to a target. Returns the number of bytes written, or -1 on error
+Py_ssize_t sfs_from_value(PyObject *value, SBSTarget *target);
+// Convert an SFS buffer back to the dict or list it used to be
+PyObject *sfs_to_value(const unsigned char *bytes, size_t length);
+// Find the SBS bytes of the value of an item in an SFS buffer. Returns 0 and sets the offset and size, or -1 on error
+int sfs_find_item(const unsigned char *bytes, size_t length, PyObject *key, size_t *offset, size_t *size);
+// Get the value of an item in an SFS buffer, without decoding the other items
+PyObject *sfs_get_item(const unsigned char *bytes, size_t length, PyObject *key);
+// Set the value of an item in an SFS buffer of `length` bytes, only rewriting that item. Returns the new length, or -1 on error
+Py_ssize_t sfs_set_item(SBSTarget *target, size_t length, PyObject *key, PyObject *value);
+// Same as above with the value, and optionally the key, already converted with from_value, so that no Python code runs while the buffer is written
+Py_ssize_t sfs_set_item_bytes(SBSTarget *target, size_t length, PyObject *key, PyObject *key_bytes, PyObject *value_bytes);
+
+#endif // SFS_1_H
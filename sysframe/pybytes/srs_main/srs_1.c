@@ -0,0 +1,799 @@
+#define PY_SSIZE_T_CLEAN
+
+#include <Python.h>
+#include <structmember.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbs_main/sbs_2.h"
+#include "srs_1.h"
+
+/*
+  ## Explanation for the SRS (Schema Record Serialization) protocol
+
+  # Quick note
+
+  In this file and the explanation, terms may be used that are not
+  explained here. Those are explained in 'sbs_X.c' (X can vary, it
+  should be the file placed directly under sysframe/pybytes).
+
+
+  # What is the 'Schema Record Serialization' protocol?
+
+  Regular SBS bytes describe themselves: every value starts with its
+  datatype, and every dict writes all of its keys. That's wasted work
+  and space for records that all have the same shape, like rows of a
+  table held in dicts or namedtuples. A schema holds that shape once,
+  being the keys of the fields and the type of every field, so that
+  the records themselves only hold their values.
+
+  A schema is created from an example record, or from a spec holding
+  the types of the fields instead of their values. Records are then
+  encoded and decoded without looking up how to write every value,
+  only checking that it has the type of its field.
+
+
+  # The layout
+
+  The bytes hold any number of records, stored by column:
+
+  [ header (9 bytes) ][ null bitmaps ][ column 0 ][ column 1 ] ...
+
+  The header holds the protocol marker (PROT_SRS_1, so the regular
+  to-value functions can tell it apart from SBS bytes), the id of the
+  schema, which is a hash of the fields and their types, and the
+  number of records. Decoding with a schema of another id fails.
+
+  Every record has a null bitmap with a bit per field, set if its
+  value is None. This way, every field can be None besides its type.
+
+  Ints, floats and bools have a fixed width slot in their column of
+  8, 8 and 1 bytes. The columns of strings, bytes and fields of any
+  other type first hold the 4-byte sizes of the values of all records,
+  followed by their data. Strings are stored as UTF-8, and values of
+  other types as regular SBS bytes. As the values of a field sit next
+  to each other, the columns compress well and can be read as a whole.
+
+  All numbers are stored in the native byte order and aren't aligned,
+  so they're only read and written through memcpy.
+
+*/
+
+// # Definitions
+
+// The kinds of fields
+#define FIELD_ANY   0 // Any value, stored as SBS bytes
+#define FIELD_INT   1 // An int that fits in 64 bits
+#define FIELD_FLOAT 2
+#define FIELD_BOOL  3
+#define FIELD_STR   4
+#define FIELD_BYTES 5
+
+// The header holds the protocol marker, the 4-byte id of the schema and the 4-byte number of records
+#define HEADER_SIZE 9
+#define MAX_RECORDS UINT32_MAX
+
+// Records of a schema without fields take no space, so their count is the only thing bounding the list we decode into
+#define MAX_EMPTY_RECORDS (1 << 16)
+
+// The width of the slots of a field in its column, the variable sized fields store their size in it
+static inline size_t field_width(unsigned char kind)
+{
+    switch (kind)
+    {
+    case FIELD_INT:
+    case FIELD_FLOAT: return 8;
+    case FIELD_BOOL: return 1;
+    default: return 4;
+    }
+}
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *fields;      // The keys of the fields, or their names for namedtuples
+    PyObject *record_type; // The namedtuple type of the records, NULL for dicts
+    PyObject *template;    // A dict of the fields set to None, copied for every decoded dict as that's presized already
+    unsigned char *kinds;  // The kind of every field
+    Py_ssize_t count;      // The number of fields
+    size_t bitmap_size;    // The size of the null bitmap of a record
+    uint32_t id;           // The hash of the fields and their kinds
+} SchemaObject;
+
+// # Helper functions
+
+static inline void invalid_srs(void)
+{
+    PyErr_SetString(PyExc_ValueError, "Likely received invalid bytes: not encoded by a schema, or cut off.");
+}
+
+// Get the kind of field for values of a type
+static inline unsigned char kind_of_type(PyObject *type)
+{
+    // Bools are checked first, as they're ints as well
+    if (type == (PyObject *)&PyBool_Type) return FIELD_BOOL;
+    if (type == (PyObject *)&PyLong_Type) return FIELD_INT;
+    if (type == (PyObject *)&PyFloat_Type) return FIELD_FLOAT;
+    if (type == (PyObject *)&PyUnicode_Type) return FIELD_STR;
+    if (type == (PyObject *)&PyBytes_Type) return FIELD_BYTES;
+
+    return FIELD_ANY;
+}
+
+// Hash the fields and kinds of a schema into its id, so that bytes of another schema aren't decoded by it
+static inline int hash_schema(SchemaObject *self)
+{
+    PyObject *bytes = from_value(self->fields);
+    if (bytes == NULL) return -1;
+
+    // FNV-1a over the serialized fields, the kinds and whether the records are namedtuples
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const unsigned char *fields = (const unsigned char *)PyBytes_AS_STRING(bytes);
+
+    for (Py_ssize_t i = 0; i < PyBytes_GET_SIZE(bytes); i++)
+        hash = (hash ^ fields[i]) * 0x100000001b3ULL;
+    for (Py_ssize_t i = 0; i < self->count; i++)
+        hash = (hash ^ self->kinds[i]) * 0x100000001b3ULL;
+    hash = (hash ^ (self->record_type != NULL)) * 0x100000001b3ULL;
+
+    Py_DECREF(bytes);
+
+    self->id = (uint32_t)(hash ^ (hash >> 32));
+    return 0;
+}
+
+// Get the kinds of the fields of a namedtuple type from its annotations, if it has those. Fields without one can hold any value
+static inline int kinds_from_annotations(SchemaObject *self, PyObject *type)
+{
+    PyObject *annotations = PyObject_GetAttrString(type, "__annotations__");
+    if (annotations == NULL)
+    {
+        PyErr_Clear();
+        memset(self->kinds, FIELD_ANY, (size_t)self->count);
+        return 0;
+    }
+
+    for (Py_ssize_t i = 0; i < self->count; i++)
+    {
+        PyObject *annotation = PyDict_Check(annotations) ? PyDict_GetItemWithError(annotations, PyTuple_GET_ITEM(self->fields, i)) : NULL;
+        if (annotation == NULL && PyErr_Occurred())
+        {
+            Py_DECREF(annotations);
+            return -1;
+        }
+
+        self->kinds[i] = annotation == NULL ? FIELD_ANY : kind_of_type(annotation);
+    }
+
+    Py_DECREF(annotations);
+    return 0;
+}
+
+// Get the fields of a namedtuple type. Returns NULL if it isn't one, with an error set if it's a tuple type without fields
+static inline PyObject *namedtuple_fields(PyObject *type)
+{
+    if (!PyType_Check(type) || !PyType_IsSubtype((PyTypeObject *)type, &PyTuple_Type)) return NULL;
+
+    PyObject *fields = PyObject_GetAttrString(type, "_fields");
+    if (fields == NULL) return NULL;
+
+    PyObject *tuple = PySequence_Tuple(fields);
+    Py_DECREF(fields);
+
+    return tuple;
+}
+
+// Get the value of a field of a record, as a borrowed reference
+static inline PyObject *get_record_field(SchemaObject *self, PyObject *record, Py_ssize_t index)
+{
+    if (self->record_type != NULL) return PyTuple_GET_ITEM(record, index);
+
+    PyObject *key = PyTuple_GET_ITEM(self->fields, index);
+    PyObject *value = PyDict_GetItemWithError(record, key);
+
+    if (value == NULL && !PyErr_Occurred())
+        PyErr_Format(PyExc_ValueError, "The record is missing the field %R of the schema.", key);
+
+    return value;
+}
+
+// Check whether a record has the shape of the schema, before any of its fields are read
+static inline int check_record(SchemaObject *self, PyObject *record)
+{
+    // Namedtuples of other types (or plain tuples) could have other fields in the same places
+    if (self->record_type != NULL ? !PyObject_TypeCheck(record, (PyTypeObject *)self->record_type) : !PyDict_Check(record))
+    {
+        PyErr_Format(PyExc_TypeError, "Expected a '%s' record, got a '%s'.", self->record_type != NULL ? ((PyTypeObject *)self->record_type)->tp_name : "dict", Py_TYPE(record)->tp_name);
+        return -1;
+    }
+
+    // A dict with as many items as fields can't have other keys once all fields are found
+    Py_ssize_t size = self->record_type != NULL ? PyTuple_GET_SIZE(record) : PyDict_GET_SIZE(record);
+    if (size != self->count)
+    {
+        PyErr_Format(PyExc_ValueError, "The record has %zd items instead of the %zd fields of the schema.", size, self->count);
+        return -1;
+    }
+
+    return 0;
+}
+
+// # Encoding
+
+// A buffer that grows while the columns are written to it
+typedef struct {
+    unsigned char *bytes;
+    size_t size;
+    size_t capacity;
+} SRSBuffer;
+
+// Make sure the buffer has space for `extra` more bytes
+static inline int reserve_buffer(SRSBuffer *buffer, size_t extra)
+{
+    if (buffer->size + extra <= buffer->capacity) return 0;
+
+    // Double the capacity, so that a column of small values only reallocates a few times
+    size_t capacity = buffer->capacity * 2;
+    if (capacity < buffer->size + extra) capacity = buffer->size + extra;
+
+    unsigned char *temp = (unsigned char *)realloc(buffer->bytes, capacity);
+    if (temp == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    buffer->bytes = temp;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+// Append the data of a variable sized value, and write its size in its slot of the column
+static inline int append_value(SRSBuffer *buffer, size_t slot, const void *data, size_t size)
+{
+    if (size > UINT32_MAX)
+    {
+        PyErr_SetString(PyExc_OverflowError, "The values of a schema can be up to 4 GiB in size.");
+        return -1;
+    }
+
+    if (reserve_buffer(buffer, size) == -1) return -1;
+
+    uint32_t size_32 = (uint32_t)size;
+    memcpy(buffer->bytes + slot, &size_32, 4);
+    memcpy(buffer->bytes + buffer->size, data, size);
+    buffer->size += size;
+
+    return 0;
+}
+
+// Write the slot of a value in the column that starts at `column`
+static inline int write_field(SchemaObject *self, SRSBuffer *buffer, unsigned char kind, size_t column, Py_ssize_t record, PyObject *value, Py_ssize_t index)
+{
+    unsigned char *slot = buffer->bytes + column + record * field_width(kind);
+
+    switch (kind)
+    {
+    case FIELD_INT:
+    {
+        if (!PyLong_CheckExact(value)) break;
+
+        int overflow;
+        long long number = PyLong_AsLongLongAndOverflow(value, &overflow);
+        if (overflow != 0)
+        {
+            PyErr_Format(PyExc_OverflowError, "The value of field %R doesn't fit in 64 bits.", PyTuple_GET_ITEM(self->fields, index));
+            return -1;
+        }
+
+        int64_t number_64 = (int64_t)number;
+        memcpy(slot, &number_64, 8);
+        return 0;
+    }
+    case FIELD_FLOAT:
+    {
+        if (!PyFloat_CheckExact(value)) break;
+
+        double number = PyFloat_AS_DOUBLE(value);
+        memcpy(slot, &number, 8);
+        return 0;
+    }
+    case FIELD_BOOL:
+    {
+        if (!PyBool_Check(value)) break;
+
+        *slot = value == Py_True;
+        return 0;
+    }
+    case FIELD_STR:
+    {
+        if (!PyUnicode_CheckExact(value)) break;
+
+        // This uses the UTF-8 form the string caches, so repeated strings are only encoded once
+        Py_ssize_t size;
+        const char *utf8 = PyUnicode_AsUTF8AndSize(value, &size);
+        if (utf8 == NULL) return -1;
+
+        return append_value(buffer, column + record * 4, utf8, (size_t)size);
+    }
+    case FIELD_BYTES:
+    {
+        if (!PyBytes_CheckExact(value)) break;
+
+        return append_value(buffer, column + record * 4, PyBytes_AS_STRING(value), (size_t)PyBytes_GET_SIZE(value));
+    }
+    default:
+    {
+        PyObject *bytes = from_value(value);
+        if (bytes == NULL) return -1;
+
+        int result = append_value(buffer, column + record * 4, PyBytes_AS_STRING(bytes), (size_t)PyBytes_GET_SIZE(bytes));
+        Py_DECREF(bytes);
+
+        return result;
+    }
+    }
+
+    PyErr_Format(PyExc_TypeError, "The value of field %R has type '%s', which doesn't match the type of the field in the schema.", PyTuple_GET_ITEM(self->fields, index), Py_TYPE(value)->tp_name);
+    return -1;
+}
+
+// Encode records into the bytes of a schema, one column after another
+static PyObject *encode_records(SchemaObject *self, PyObject **records, Py_ssize_t count)
+{
+    if ((uint64_t)count > MAX_RECORDS)
+    {
+        PyErr_SetString(PyExc_OverflowError, "Can't encode more than 2^32 - 1 records at once.");
+        return NULL;
+    }
+
+    for (Py_ssize_t r = 0; r < count; r++)
+        if (check_record(self, records[r]) == -1) return NULL;
+
+    // Start with the space of the header, the bitmaps and the slots of the fields
+    size_t fixed_size = self->bitmap_size;
+    for (Py_ssize_t f = 0; f < self->count; f++)
+        fixed_size += field_width(self->kinds[f]);
+
+    if (fixed_size == 0 && count > MAX_EMPTY_RECORDS)
+    {
+        PyErr_SetString(PyExc_OverflowError, "Can't encode more than 2^16 records of a schema without fields at once.");
+        return NULL;
+    }
+
+    SRSBuffer buffer = {NULL, 0, 0};
+    if (reserve_buffer(&buffer, HEADER_SIZE + fixed_size * (size_t)count) == -1) return NULL;
+
+    uint32_t count_32 = (uint32_t)count;
+    buffer.bytes[0] = PROT_SRS_1;
+    memcpy(buffer.bytes + 1, &(self->id), 4);
+    memcpy(buffer.bytes + 5, &count_32, 4);
+
+    // Clear the bitmaps, the bits of None values are set below
+    unsigned char *bitmaps = buffer.bytes + HEADER_SIZE;
+    memset(bitmaps, 0, self->bitmap_size * (size_t)count);
+    buffer.size = HEADER_SIZE + self->bitmap_size * (size_t)count;
+
+    for (Py_ssize_t f = 0; f < self->count; f++)
+    {
+        unsigned char kind = self->kinds[f];
+        size_t column_size = field_width(kind) * (size_t)count;
+
+        if (reserve_buffer(&buffer, column_size) == -1) goto error;
+
+        // The slots come first, the data of variable sized values is appended after them
+        size_t column = buffer.size;
+        memset(buffer.bytes + column, 0, column_size);
+        buffer.size += column_size;
+
+        for (Py_ssize_t r = 0; r < count; r++)
+        {
+            PyObject *value = get_record_field(self, records[r], f);
+            if (value == NULL) goto error;
+
+            if (value == Py_None)
+            {
+                buffer.bytes[HEADER_SIZE + r * self->bitmap_size + f / 8] |= 1 << (f % 8);
+                continue;
+            }
+
+            if (write_field(self, &buffer, kind, column, r, value, f) == -1) goto error;
+        }
+    }
+
+    PyObject *result = PyBytes_FromStringAndSize((const char *)buffer.bytes, (Py_ssize_t)buffer.size);
+    free(buffer.bytes);
+    return result;
+
+error:
+    free(buffer.bytes);
+    return NULL;
+}
+
+// # Decoding
+
+// Create the value of a field from its slot and data. Returns NULL on error
+static inline PyObject *read_field(unsigned char kind, const unsigned char *slot, const unsigned char *data, size_t size)
+{
+    switch (kind)
+    {
+    case FIELD_INT:
+    {
+        int64_t number;
+        memcpy(&number, slot, 8);
+        return PyLong_FromLongLong((long long)number);
+    }
+    case FIELD_FLOAT:
+    {
+        double number;
+        memcpy(&number, slot, 8);
+        return PyFloat_FromDouble(number);
+    }
+    case FIELD_BOOL: return PyBool_FromLong(*slot);
+    case FIELD_STR: return PyUnicode_DecodeUTF8((const char *)data, (Py_ssize_t)size, NULL);
+    case FIELD_BYTES: return PyBytes_FromStringAndSize((const char *)data, (Py_ssize_t)size);
+    default: return to_value_buf(data, size);
+    }
+}
+
+// Create an empty record, of which the fields are set one column after another
+static inline PyObject *new_record(SchemaObject *self)
+{
+    if (self->record_type == NULL) return PyDict_Copy(self->template);
+
+    // Create the namedtuple like `tuple.__new__` does, its items are set below. This skips the `__new__` of the namedtuple, which runs Python code
+    PyTypeObject *type = (PyTypeObject *)self->record_type;
+    return type->tp_alloc(type, self->count);
+}
+
+// Set a field of a record, stealing the reference to the value
+static inline int set_record_field(SchemaObject *self, PyObject *record, Py_ssize_t index, PyObject *value)
+{
+    if (self->record_type != NULL)
+    {
+        PyTuple_SET_ITEM(record, index, value);
+        return 0;
+    }
+
+    int result = PyDict_SetItem(record, PyTuple_GET_ITEM(self->fields, index), value);
+    Py_DECREF(value);
+
+    return result;
+}
+
+// Decode the bytes of a schema into a list of records
+static PyObject *decode_records(SchemaObject *self, const unsigned char *bytes, size_t length)
+{
+    if (length < HEADER_SIZE || bytes[0] != PROT_SRS_1)
+    {
+        invalid_srs();
+        return NULL;
+    }
+
+    uint32_t id, count_32;
+    memcpy(&id, bytes + 1, 4);
+    memcpy(&count_32, bytes + 5, 4);
+
+    if (id != self->id)
+    {
+        PyErr_SetString(PyExc_ValueError, "The bytes were encoded by a schema with other fields or types.");
+        return NULL;
+    }
+
+    // Check that at least the fixed size slots of all records fit, before creating any of them
+    size_t record_size = self->bitmap_size;
+    for (Py_ssize_t f = 0; f < self->count; f++)
+        record_size += field_width(self->kinds[f]);
+
+    // Without fields, the records don't take any bytes that the count could be checked against
+    size_t count = count_32;
+    if (record_size == 0 ? length != HEADER_SIZE || count > MAX_EMPTY_RECORDS : count > (length - HEADER_SIZE) / record_size)
+    {
+        invalid_srs();
+        return NULL;
+    }
+
+    PyObject *records = PyList_New((Py_ssize_t)count);
+    if (records == NULL) return NULL;
+
+    for (size_t r = 0; r < count; r++)
+    {
+        PyObject *record = new_record(self);
+        if (record == NULL) goto error;
+
+        PyList_SET_ITEM(records, r, record);
+    }
+
+    const unsigned char *bitmaps = bytes + HEADER_SIZE;
+    size_t offset = HEADER_SIZE + self->bitmap_size * count;
+
+    for (Py_ssize_t f = 0; f < self->count; f++)
+    {
+        unsigned char kind = self->kinds[f];
+        size_t width = field_width(kind);
+        int sized = kind == FIELD_STR || kind == FIELD_BYTES || kind == FIELD_ANY;
+
+        // The data of the variable sized values of the previous columns comes before these slots
+        if (width * count > length - offset)
+        {
+            invalid_srs();
+            goto error;
+        }
+
+        const unsigned char *column = bytes + offset;
+        offset += width * count;
+
+        for (size_t r = 0; r < count; r++)
+        {
+            PyObject *value;
+            uint32_t size = 0;
+
+            if (bitmaps[r * self->bitmap_size + f / 8] & (1 << (f % 8)))
+            {
+                Py_INCREF(Py_None);
+                value = Py_None;
+            }
+            else
+            {
+                if (sized) memcpy(&size, column + r * 4, 4);
+                if ((size_t)size > length - offset)
+                {
+                    invalid_srs();
+                    goto error;
+                }
+
+                value = read_field(kind, column + r * width, bytes + offset, size);
+                offset += size;
+            }
+
+            if (value == NULL || set_record_field(self, PyList_GET_ITEM(records, r), f, value) == -1) goto error;
+        }
+    }
+
+    if (offset != length)
+    {
+        invalid_srs();
+        goto error;
+    }
+
+    return records;
+
+error:
+    Py_DECREF(records);
+    return NULL;
+}
+
+// # Schema objects
+
+static int Schema_init(SchemaObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *example;
+
+    static char* kwlist[] = {"example_or_spec", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", kwlist, &example))
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected 1 example record or spec.");
+        return -1;
+    }
+
+    // Clear the old schema in case init is called twice
+    Py_CLEAR(self->fields);
+    Py_CLEAR(self->record_type);
+    Py_CLEAR(self->template);
+    free(self->kinds);
+    self->kinds = NULL;
+
+    PyObject *fields = NULL;
+    PyObject *record_type = NULL;
+
+    if (PyDict_Check(example))
+    {
+        // A dict of only types is a spec, any other dict is an example record
+        fields = PyDict_Keys(example);
+        if (fields == NULL) return -1;
+
+        Py_SETREF(fields, PyList_AsTuple(fields));
+        if (fields == NULL) return -1;
+    }
+    else if ((fields = namedtuple_fields(example)) != NULL)
+    {
+        // A namedtuple type is a spec, of which the annotations (if any) hold the types
+        Py_INCREF(example);
+        record_type = example;
+    }
+    else if (!PyErr_Occurred() && PyTuple_Check(example) && (fields = namedtuple_fields((PyObject *)Py_TYPE(example))) != NULL)
+    {
+        Py_INCREF(Py_TYPE(example));
+        record_type = (PyObject *)Py_TYPE(example);
+    }
+
+    if (fields == NULL)
+    {
+        if (!PyErr_Occurred() || PyErr_ExceptionMatches(PyExc_AttributeError))
+        {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError, "Expected an example record or a spec: a dict, a dict of types, a namedtuple, or a namedtuple type.");
+        }
+        return -1;
+    }
+
+    self->fields = fields;
+    self->record_type = record_type;
+    self->count = PyTuple_GET_SIZE(fields);
+    self->bitmap_size = ((size_t)self->count + 7) / 8;
+
+    self->kinds = (unsigned char *)malloc((size_t)self->count + 1);
+    if (self->kinds == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    if (PyDict_Check(example))
+    {
+        self->template = PyDict_New();
+        if (self->template == NULL) return -1;
+
+        for (Py_ssize_t i = 0; i < self->count; i++)
+            if (PyDict_SetItem(self->template, PyTuple_GET_ITEM(fields, i), Py_None) == -1) return -1;
+
+        int spec = 1;
+        for (Py_ssize_t i = 0; i < self->count; i++)
+            spec &= PyType_Check(PyDict_GetItem(example, PyTuple_GET_ITEM(fields, i)));
+
+        // Examples get the types of their values, where None can't tell and allows any value
+        for (Py_ssize_t i = 0; i < self->count; i++)
+        {
+            PyObject *value = PyDict_GetItem(example, PyTuple_GET_ITEM(fields, i));
+            self->kinds[i] = spec ? kind_of_type(value) : value == Py_None ? FIELD_ANY : kind_of_type((PyObject *)Py_TYPE(value));
+        }
+    }
+    else if (example == record_type)
+    {
+        if (kinds_from_annotations(self, record_type) == -1) return -1;
+    }
+    else
+    {
+        if (PyTuple_GET_SIZE(example) != self->count)
+        {
+            PyErr_SetString(PyExc_TypeError, "The namedtuple doesn't have as many items as fields.");
+            return -1;
+        }
+
+        for (Py_ssize_t i = 0; i < self->count; i++)
+        {
+            PyObject *value = PyTuple_GET_ITEM(example, i);
+            self->kinds[i] = value == Py_None ? FIELD_ANY : kind_of_type((PyObject *)Py_TYPE(value));
+        }
+    }
+
+    return hash_schema(self);
+}
+
+static void Schema_dealloc(SchemaObject *self)
+{
+    Py_XDECREF(self->fields);
+    Py_XDECREF(self->record_type);
+    Py_XDECREF(self->template);
+    free(self->kinds);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Schema_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    SchemaObject *self = (SchemaObject *)type->tp_alloc(type, 0);
+    if (self == NULL) return NULL;
+
+    // Mark the schema as uninitialized
+    self->fields = NULL;
+    self->record_type = NULL;
+    self->template = NULL;
+    self->kinds = NULL;
+    self->count = 0;
+
+    return (PyObject *)self;
+}
+
+static inline int check_schema_ready(SchemaObject *self)
+{
+    if (self->kinds == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "The schema is not initialized.");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Decode the bytes of any bytes-like object
+static inline PyObject *decode_buffer(SchemaObject *self, PyObject *buffer)
+{
+    if (check_schema_ready(self) == -1) return NULL;
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_SIMPLE) == -1)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected a bytes-like object (supporting the buffer protocol).");
+        return NULL;
+    }
+
+    PyObject *records = decode_records(self, (const unsigned char *)view.buf, (size_t)view.len);
+
+    PyBuffer_Release(&view);
+    return records;
+}
+
+static PyObject *Schema_encode(SchemaObject *self, PyObject *record)
+{
+    if (check_schema_ready(self) == -1) return NULL;
+
+    return encode_records(self, &record, 1);
+}
+
+static PyObject *Schema_decode(SchemaObject *self, PyObject *buffer)
+{
+    PyObject *records = decode_buffer(self, buffer);
+    if (records == NULL) return NULL;
+
+    if (PyList_GET_SIZE(records) != 1)
+    {
+        PyErr_Format(PyExc_ValueError, "The bytes hold %zd records instead of 1, decode them with 'decode_many'.", PyList_GET_SIZE(records));
+        Py_DECREF(records);
+        return NULL;
+    }
+
+    PyObject *record = PyList_GET_ITEM(records, 0);
+    Py_INCREF(record);
+    Py_DECREF(records);
+
+    return record;
+}
+
+static PyObject *Schema_encode_many(SchemaObject *self, PyObject *records)
+{
+    if (check_schema_ready(self) == -1) return NULL;
+
+    PyObject *sequence = PySequence_Fast(records, "Expected an iterable of records.");
+    if (sequence == NULL) return NULL;
+
+    PyObject *result = encode_records(self, PySequence_Fast_ITEMS(sequence), PySequence_Fast_GET_SIZE(sequence));
+
+    Py_DECREF(sequence);
+    return result;
+}
+
+static PyObject *Schema_decode_many(SchemaObject *self, PyObject *buffer)
+{
+    return decode_buffer(self, buffer);
+}
+
+static PyMethodDef Schema_methods[] = {
+    {"encode", (PyCFunction)Schema_encode, METH_O, "Encode a record to bytes."},
+    {"decode", (PyCFunction)Schema_decode, METH_O, "Decode the bytes of a record."},
+    {"encode_many", (PyCFunction)Schema_encode_many, METH_O, "Encode many records to bytes at once."},
+    {"decode_many", (PyCFunction)Schema_decode_many, METH_O, "Decode the bytes of many records."},
+
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMemberDef Schema_members[] = {
+    {"fields", T_OBJECT, offsetof(SchemaObject, fields), READONLY, "The keys of the fields of the records."},
+    {"record_type", T_OBJECT, offsetof(SchemaObject, record_type), READONLY, "The namedtuple type of the records, or None for dicts."},
+
+    {NULL, 0, 0, 0, NULL}
+};
+
+PyTypeObject SchemaType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "pybytes.Schema",
+    .tp_doc = "A fixed layout for records of the same shape, encoding only their values.",
+    .tp_basicsize = sizeof(SchemaObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Schema_new,
+    .tp_init = (initproc)Schema_init,
+    .tp_dealloc = (destructor)Schema_dealloc,
+    .tp_methods = Schema_methods,
+    .tp_members = Schema_members,
+};
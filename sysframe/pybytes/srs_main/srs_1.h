@@ -0,0 +1,16 @@
+#ifndef SRS_1_H
+#define SRS_1_H
+
+// Python define statement
+#define PY_SSIZE_T_CLEAN
+
+// Includes
+#include <Python.h>
+
+// The protocol marker of records encoded by a schema, next to the SBS protocol markers
+#define PROT_SRS_1 250
+
+// The type of the schemas, which encode and decode records of a fixed shape
+extern PyTypeObject SchemaType;
+
+#endif // SRS_1_H
@@ -1,6 +1,9 @@
 # Use the test values from `test_pybytes`
 from test_pybytes import test_values
 from sysframe import membridge
+import os
+import threading
+import time
 
 # The shared memory name
 name = '/test-python-membridge-123'
@@ -23,9 +26,415 @@ for value in test_values:
         print(f'Failed to read value {value}')
         errors += 1
 
+# Go over the test values again with a handle that stays mapped
+memory = membridge.Memory(name)
+
+for value in test_values:
+    memory.write(value)
+    
+    if memory.read() != value: # Check if we read back what we wrote
+        print(f'Failed to read value {value} through a handle')
+        errors += 1
+
+# Writes through the functions should be visible to the handle as well, also after a resize
+membridge.write_memory(name, 'small')
+membridge.write_memory(name, 'large' * 100000)
+if memory.read() != 'large' * 100000:
+    print('Failed to read a resized value through a handle')
+    errors += 1
+
+# Trimming the segment after a smaller write should keep the value intact for both
+membridge.write_memory(name, 'small')
+membridge.trim_memory(name)
+if memory.read() != 'small' or membridge.read_memory(name) != 'small':
+    print('Failed to read a value after trimming')
+    errors += 1
+
+# Readers shouldn't ever see a half-written value while another process writes
+written = ['a' * 10, 'b' * 100000, ['c'] * 1000]
+
+pid = os.fork()
+if pid == 0:
+    for i in range(3000):
+        membridge.write_memory(name, written[i % 3])
+    os._exit(0)
+
+for i in range(3000):
+    if memory.read() not in written + ['small']:
+        print('Read a torn value while another process was writing')
+        errors += 1
+        break
+
+os.waitpid(pid, 0)
+
+# Threads of the same process can write and read at once, also when serializing releases the GIL
+import sys
+import uuid
+switch_interval = sys.getswitchinterval()
+sys.setswitchinterval(1e-6)
+
+uuids = [uuid.uuid4() for _ in range(500)]
+def write_threaded():
+    for _ in range(50):
+        membridge.write_memory(name, uuids)
+        memory.write([str(item) for item in uuids])
+def read_threaded():
+    for _ in range(100):
+        membridge.read_memory(name)
+        memory.read()
+
+threads = [threading.Thread(target=write_threaded), threading.Thread(target=write_threaded), threading.Thread(target=read_threaded)]
+for thread in threads:
+    thread.start()
+for thread in threads:
+    thread.join(60)
+sys.setswitchinterval(switch_interval)
+
+if any(thread.is_alive() for thread in threads):
+    print('Deadlocked writing from multiple threads')
+    os._exit(1)
+
+# A failed write leaves the previous value in place
+membridge.write_memory(name, 'kept')
+try:
+    memory.write(object())
+except Exception:
+    pass
+if memory.read() != 'kept':
+    print('Lost the value on a failed write')
+    errors += 1
+
+memory.close()
+
 # Close the shared memory
 membridge.remove_memory(name)
 
+# Call a shared function from multiple threads at once, with args both inline and spilled over
+function_name = '/test-python-membridge-function-123'
+
+pid = os.fork()
+if pid == 0:
+    membridge.create_function(function_name, lambda *args: [args, 'x' * 5000])
+    os._exit(0)
+
+while not os.path.exists('/dev/shm' + function_name): time.sleep(0.01)
+
+failed_calls = []
+def call_shared(index):
+    for i in range(50):
+        args = (index, 'y' * (i * 100))
+        if membridge.call_function(function_name, args) != [args, 'x' * 5000]:
+            failed_calls.append(args)
+
+threads = [threading.Thread(target=call_shared, args=(i,)) for i in range(32)]
+for thread in threads: thread.start()
+for thread in threads: thread.join()
+
+if failed_calls:
+    print(f'Got the wrong value from {len(failed_calls)} shared function calls')
+    errors += 1
+
+if membridge.remove_function(function_name) != True:
+    print('Failed to remove the shared function')
+    errors += 1
+
+os.waitpid(pid, 0)
+
+# Serve a shared function in the background, and keep using this process while it runs
+membridge.create_function(function_name, lambda *args: sum(args), background=True, workers=4, spin=1000)
+
+pid = os.fork()
+if pid == 0:
+    os._exit(0 if all(membridge.call_function(function_name, (i, i), spin=1000) == i * 2 for i in range(500)) else 1)
+
+if os.waitpid(pid, 0)[1] != 0 or membridge.call_function(function_name, (1, 2)) != 3:
+    print('Got the wrong value from a shared function running in the background')
+    errors += 1
+
+# Batches are a single call for the latency counters
+if membridge.call_function_many(function_name, [(i, 1) for i in range(2000)]) != [i + 1 for i in range(2000)]:
+    print('Got the wrong values from a batch of shared function calls')
+    errors += 1
+
+if membridge.call_function_many(function_name, []) != []:
+    print('Got the wrong values from an empty batch of shared function calls')
+    errors += 1
+
+# The latency counters should have seen every call, spinning or not
+stats = membridge.function_stats(function_name, reset=True)
+if stats['calls'] != 502 or stats['spun'] + stats['slept'] != 502 or stats['max_ns'] * 502 < stats['total_ns']:
+    print(f'Got the wrong latency counters {stats}')
+    errors += 1
+
+if membridge.function_stats(function_name)['calls'] != 0:
+    print('Failed to reset the latency counters')
+    errors += 1
+
+# With the stats enabled, every call also lands in the latency histogram
+membridge.enable_stats()
+for i in range(10):
+    membridge.call_function(function_name, (i, i))
+membridge.enable_stats(False)
+
+stats = membridge.function_stats(function_name)
+if len(stats['histogram']) != 24 or sum(stats['histogram']) != 10 or stats['calls'] != 10:
+    print(f'Got the wrong latency histogram {stats}')
+    errors += 1
+
+# Large args and returned values can be passed out-of-band, and are released once they're read
+oob_name = function_name + '_oob'
+membridge.create_function(oob_name, lambda data: (type(data).__name__, bytes(data[::-1])), background=True, oob_threshold=4096)
+
+data = os.urandom(1 << 20)
+returned = membridge.call_function(oob_name, (data,), oob_threshold=4096)
+if returned[0] != 'memoryview' or returned[1] != data[::-1] or any(entry.startswith('sbs-oob-') for entry in os.listdir('/dev/shm')):
+    print('Got the wrong value from a shared function with out-of-band buffers')
+    errors += 1
+
+membridge.remove_function(oob_name)
+
+if membridge.remove_function(function_name) != True:
+    print('Failed to remove the shared function running in the background')
+    errors += 1
+
+# Views only create the items that are accessed
+membridge.write_memory(name, [{'id': i, 'name': f'item-{i}'} for i in range(1000)])
+if membridge.view_memory(name)[500]['name'] != 'item-500' or membridge.Memory(name).view()[-1]['id'] != 999:
+    print('Got the wrong value from a view of the shared memory')
+    errors += 1
+
+# Values with back-references to repeated strings read back the same
+records = [{'status': ('active', 'pending')[i % 2], 'id': i} for i in range(1000)]
+membridge.write_memory(name, records, refs=True)
+if membridge.read_memory(name) != records or membridge.view_memory(name) != records:
+    print('Failed to read back a value written with back-references')
+    errors += 1
+
+# Write a dict as an SFS buffer, and change single items of it from another process
+membridge.write_memory(name, {'count': 0, 'name': 'sfs'}, sfs=True)
+
+pid = os.fork()
+if pid == 0:
+    memory = membridge.Memory(name)
+    for i in range(1, 1001):
+        memory.set_item('count', i)
+        memory.set_item(f'key-{i % 10}', 'x' * i)
+    os._exit(0)
+
+# Reads of single items keep working while the other process writes
+memory = membridge.Memory(name)
+while os.waitpid(pid, os.WNOHANG)[0] == 0:
+    if not isinstance(memory.get_item('count'), int):
+        print('Got the wrong type from an SFS item while it was written')
+        errors += 1
+        break
+
+if memory.get_item('count') != 1000 or membridge.get_item(name, 'key-0') != 'x' * 1000:
+    print('Got the wrong value from an SFS item')
+    errors += 1
+
+if memory.read() != {'count': 1000, 'name': 'sfs', **{f'key-{i}': 'x' * (990 + i) for i in range(1, 10)}, 'key-0': 'x' * 1000}:
+    print('Got the wrong value from an SFS buffer')
+    errors += 1
+
+memory.write([1, 2, 3], sfs=True)
+if not membridge.set_item(name, -1, 'three') or memory.read() != [1, 2, 'three']:
+    print('Failed to set an item of an SFS list')
+    errors += 1
+
+memory.close()
+membridge.remove_memory(name)
+
+# Compressed values read back the same
+membridge.write_memory(name, records, compress=1)
+if membridge.read_memory(name) != records or membridge.view_memory(name)[-1] != records[-1]:
+    print('Failed to read back a compressed value')
+    errors += 1
+
+# Large buffers written out-of-band are read as memoryviews, also by other processes
+blob = os.urandom(1 << 20)
+membridge.write_memory(name, {'blob': blob, 'small': b'small'}, oob_threshold=4096)
+
+pid = os.fork()
+if pid == 0:
+    value = membridge.read_memory(name)
+    os._exit(0 if value['blob'] == blob and value['blob'].readonly and value['small'] == b'small' else 1)
+
+value = membridge.read_memory(name)
+if os.waitpid(pid, 0)[1] != 0 or not isinstance(value['blob'], memoryview) or value['blob'] != blob:
+    print('Failed to read back a value with out-of-band buffers')
+    errors += 1
+
+# Overwriting the value releases its buffers, while the ones already read stay valid
+membridge.write_memory(name, 'overwritten')
+if value['blob'] != blob or membridge.read_memory(name) != 'overwritten' or any(entry.startswith('sbs-oob-') for entry in os.listdir('/dev/shm')):
+    print('Failed to release the out-of-band buffers of an overwritten value')
+    errors += 1
+
+# Segments placed with huge pages and populated up front work like any other
+membridge.remove_memory(name)
+membridge.create_memory(name, prealloc_size=1 << 20, huge_pages=True, populate=True)
+membridge.write_memory(name, 'x' * (4 << 20))
+if membridge.read_memory(name) != 'x' * (4 << 20):
+    print('Failed to read back a value from a placed segment')
+    errors += 1
+
+# Waiting for a change returns once the segment is written to
+membridge.write_memory(name, 'initial')
+version = membridge.wait_for_change(name)
+if membridge.wait_for_change(name, version, timeout=0.01) != version:
+    print('Got a change of the shared memory without a write')
+    errors += 1
+
+thread = threading.Timer(0.1, membridge.write_memory, (name, 'changed'))
+thread.start()
+if membridge.Memory(name).wait_for_change(version, timeout=5) == version or membridge.read_memory(name) != 'changed':
+    print('Failed to wait for a change of the shared memory')
+    errors += 1
+thread.join()
+
+# Other threads can grow and close a handle while it's waiting
+memory = membridge.Memory(name)
+version = memory.wait_for_change()
+def grow_and_close():
+    for size in range(1, 9):
+        memory.write('x' * (size << 20))
+    memory.close()
+thread = threading.Timer(0.1, grow_and_close)
+thread.start()
+if memory.wait_for_change(version, timeout=5) == version:
+    print('Failed to wait for a change while the handle was remapped')
+    errors += 1
+thread.join()
+
+# Closing while waiting only unmaps the handle once the wait is over
+memory = membridge.Memory(name)
+thread = threading.Timer(0.1, memory.close)
+thread.start()
+memory.wait_for_change(memory.wait_for_change(), timeout=0.5)
+thread.join()
+
+try:
+    memory.read()
+    print('Read through a closed handle')
+    errors += 1
+except ValueError:
+    pass
+membridge.remove_memory(name)
+
+# Tables hold the values of many keys in one segment, written from several processes at once
+table_name = '/test-python-membridge-table-123'
+table = membridge.Table(table_name, capacity=10000)
+
+pids = []
+for worker in range(4):
+    pid = os.fork()
+    if pid == 0:
+        worker_table = membridge.Table(table_name)
+        for i in range(1000):
+            worker_table.set((worker, i), {'worker': worker, 'index': i})
+        for i in range(0, 1000, 2):
+            worker_table.delete((worker, i))
+        os._exit(0)
+    pids.append(pid)
+for pid in pids:
+    os.waitpid(pid, 0)
+
+if len(table) != 2000 or table.get((3, 999)) != {'worker': 3, 'index': 999} or table.get((3, 998), 'deleted') != 'deleted':
+    print('Got the wrong values from a table')
+    errors += 1
+
+for value in test_values:
+    table.set('value', value)
+    if table.get('value') != value and value == value:
+        print(f'Failed to read back value {value} from a table')
+        errors += 1
+
+if not table.delete('value') or table.delete('value'):
+    print('Failed to delete a key from a table')
+    errors += 1
+
+table.close()
+membridge.remove_memory(table_name)
+
+# Every reader of a channel gets every message
+channel_name = '/test-python-membridge-channel-123'
+readers = [membridge.Channel(channel_name, 4096) for _ in range(3)]
+
+pid = os.fork()
+if pid == 0:
+    channel = membridge.Channel(channel_name)
+    for i in range(20):
+        channel.send({'index': i, 'payload': 'x' * i})
+    os._exit(0)
+os.waitpid(pid, 0)
+
+for reader in readers:
+    if [reader.recv(timeout=5) for _ in range(20)] != [{'index': i, 'payload': 'x' * i} for i in range(20)]:
+        print('Got the wrong messages from a channel')
+        errors += 1
+
+# Readers that fall behind skip the messages that were overwritten
+reader = readers[0]
+for i in range(1000):
+    readers[1].send(i)
+
+messages = []
+try:
+    while True:
+        messages.append(reader.recv(timeout=0))
+except TimeoutError:
+    pass
+
+if not messages or messages[-1] != 999 or len(messages) + reader.dropped != 1000:
+    print('Failed to skip the overwritten messages of a channel')
+    errors += 1
+
+# Blocking reads wait for the next message
+thread = threading.Timer(0.1, readers[1].send, ('later',))
+thread.start()
+if reader.recv(timeout=5) != 'later':
+    print('Failed to wait for a message on a channel')
+    errors += 1
+thread.join()
+
+# Closing a channel from another thread stops a blocking read, without unmapping the ring under it
+thread = threading.Timer(0.1, reader.close)
+thread.start()
+try:
+    reader.recv(timeout=5)
+    print('Received a message on a closed channel')
+    errors += 1
+except ValueError:
+    pass
+thread.join()
+
+for reader in readers:
+    reader.close()
+membridge.remove_memory(channel_name)
+
+# The stats of a segment count the reads and writes of processes that enabled them
+stats_name = '/test_membridge_stats'
+membridge.remove_memory(stats_name)
+membridge.write_memory(stats_name, 'before')
+
+membridge.enable_stats()
+for value in ('small', 'a larger value ' * 1000):
+    membridge.write_memory(stats_name, value)
+    membridge.read_memory(stats_name)
+membridge.enable_stats(False)
+membridge.read_memory(stats_name)
+
+stats = membridge.stats(stats_name, reset=True)
+if stats['writes'] != 2 or stats['reads'] != 2 or stats['bytes_written'] < 15000 or stats['bytes_read'] != stats['bytes_written'] or stats['version'] != 3:
+    print(f'Got the wrong stats of a segment {stats}')
+    errors += 1
+
+if membridge.stats(stats_name)['writes'] != 0:
+    print('Failed to reset the stats of a segment')
+    errors += 1
+membridge.remove_memory(stats_name)
+
 # Print if there were no errors, or how many there were
 print(errors == 0 and 'No errors' or f'{errors} errors')
 
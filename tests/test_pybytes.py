@@ -2,6 +2,13 @@ from unittest import TestCase, main
 from sysframe import pybytes
 
 from collections import *
+from array import array
+import io
+import os
+from multiprocessing import shared_memory
+import sys
+import threading
+import typing
 from pathlib import Path, PurePath
 import datetime
 import decimal
@@ -125,6 +132,426 @@ class TestPybytes(TestCase):
         
         # Test the whole list with testing values as well
         self.assertFromTo(test_values)
+    
+    def test_buffers(self):
+        # Decoding should work from any object supporting the buffer protocol
+        bytes_obj = pybytes.from_value(test_values)
+        
+        for buffer in (bytearray(bytes_obj), memoryview(bytes_obj)):
+            self.assertEqual(test_values, pybytes.to_value(buffer))
+        
+        # Also from a slice of a larger buffer, without the slice being copied
+        padded = memoryview(b'\x00' * 16 + bytes_obj + b'\x00' * 16)
+        self.assertEqual(test_values, pybytes.to_value(padded[16:-16]))
+
+    def test_size_hint(self):
+        # The size hint only changes how much is allocated upfront, not the bytes
+        for size_hint in (0, 1, 100, 10000000):
+            self.assertEqual(pybytes.from_value(test_values, size_hint=size_hint), pybytes.from_value(test_values))
+
+    def test_streams(self):
+        # Dumping writes the same bytes as from_value, and values can follow each other in a file
+        for chunk_size in (1, 1000, 65536):
+            file = io.BytesIO()
+            written = pybytes.dump(test_values, file, chunk_size=chunk_size)
+            pybytes.dump(memoryview(b''), file, chunk_size=chunk_size)
+            
+            self.assertEqual(written, len(pybytes.from_value(test_values)))
+            self.assertEqual(file.getvalue(), pybytes.from_value(test_values) + pybytes.from_value(memoryview(b'')))
+            
+            file.seek(0)
+            self.assertEqual(pybytes.load(file, chunk_size=chunk_size), test_values)
+            self.assertEqual(pybytes.load(file, chunk_size=chunk_size), memoryview(b''))
+        
+        # A stream that ends before the value does can't be loaded
+        with self.assertRaises(ValueError):
+            pybytes.load(io.BytesIO(pybytes.from_value(test_values)[:-1]))
+        
+        # Nor can counts of more items than the stream holds, which are checked before allocating for them
+        for datachar in (31, 36, 41, 46, 107):
+            for count in (2 ** 61 + 1, 2 ** 40, 10 ** 6):
+                with self.assertRaises(ValueError):
+                    pybytes.load(io.BytesIO(bytes([253, datachar, 8]) + count.to_bytes(8, 'little') + b'\x03abc' + bytes(200000)))
+        with self.assertRaises(ValueError):
+            pybytes.load(io.BytesIO(pybytes.from_value([1.5] * 300)[:5] + bytes([8]) + (2 ** 61).to_bytes(8, 'little') + bytes(1000)))
+
+    def test_strings(self):
+        # ASCII and non-ASCII strings, with the first non-ASCII character at and around the word boundaries
+        for value in ('a', 'é', 'ascii' * 100, 'a' * 31 + 'é', 'a' * 32 + 'é', 'a' * 33 + '€', '日本語' * 50):
+            self.assertFromTo(value)
+            self.assertFromTo({value: value})
+        
+        # Strings that aren't valid UTF-8 either way raise an error
+        with self.assertRaises(UnicodeEncodeError):
+            pybytes.from_value('\ud800')
+        
+        invalid = bytearray(pybytes.from_value('a' * 40))
+        invalid[-3] = 0xff
+        with self.assertRaises(UnicodeDecodeError):
+            pybytes.to_value(invalid)
+    
+    def test_workers(self):
+        # Large buffers are copied by multiple threads, giving the same bytes
+        data = bytes(range(256)) * (24 << 12)
+        value = [data, bytearray(data), memoryview(data), array('q', range(1 << 20)), {'small': b'abc', 'large': data[:5 << 20]}]
+        
+        bytes_obj = pybytes.from_value(value, workers=4)
+        self.assertEqual(bytes_obj, pybytes.from_value(value))
+        self.assertEqual(pybytes.to_value(bytes_obj, workers=4), value)
+        
+        with self.assertRaises(ValueError):
+            pybytes.from_value(value, workers=0)
+        
+        # Long lists of numbers are packed by multiple threads
+        for numbers in ([i / 3 for i in range(1 << 18)], [i % 2 == 0 for i in range(1 << 18)], list(range(-(1 << 17), 1 << 17)), tuple(range(1 << 40, (1 << 40) + (1 << 18)))):
+            bytes_obj = pybytes.from_value(numbers, workers=4)
+            self.assertEqual(bytes_obj, pybytes.from_value(numbers))
+            self.assertEqual(pybytes.to_value(bytes_obj, workers=4), numbers)
+        
+        # The threads are started again in forked children
+        pid = os.fork()
+        if pid == 0:
+            os._exit(0 if pybytes.to_value(pybytes.from_value(value, workers=4)) == value else 1)
+        self.assertEqual(os.waitpid(pid, 0)[1], 0)
+        
+        # Other threads can't drop the buffers or change the containers they're in while those are copied
+        items = [bytes(8 << 20), bytes(8 << 20)]
+        done = threading.Event()
+        
+        def mutate():
+            while not done.is_set():
+                items[0] = None
+                items[0] = bytes(8 << 20)
+                items.append(None)
+                items.pop()
+        
+        thread = threading.Thread(target=mutate)
+        thread.start()
+        try:
+            for _ in range(20):
+                decoded = pybytes.to_value(pybytes.from_value(items, workers=8), workers=8)
+                self.assertIn(len(decoded), (2, 3))
+                self.assertIn(decoded[0], (None, bytes(8 << 20)))
+        finally:
+            done.set()
+            thread.join()
+    
+    def test_compress(self):
+        # Large values are compressed into a frame, small ones are left as they are
+        value = [{'description': 'lorem ipsum dolor sit amet ' * 5, 'index': i} for i in range(1000)]
+        bytes_obj = pybytes.from_value(value, compress=6)
+        self.assertLess(len(bytes_obj), len(pybytes.from_value(value)) // 4)
+        self.assertEqual(pybytes.to_value(bytes_obj), value)
+        self.assertEqual(pybytes.view(bytes_obj)[500], value[500])
+        self.assertEqual(pybytes.from_value('short', compress=9), pybytes.from_value('short'))
+        
+        for value in test_values:
+            self.assertEqual(pybytes.to_value(pybytes.from_value(value, compress=1, compress_threshold=0)), value)
+        
+        # Corrupt frames raise the same error as other invalid bytes
+        for invalid in (bytes_obj[:100], bytes_obj[:1] + b'\x05' + bytes_obj[2:], bytes_obj[:2] + b'\x00' * 8 + bytes_obj[10:]):
+            with self.assertRaises(ValueError):
+                pybytes.to_value(invalid)
+    
+    def test_oob(self):
+        # Large buffers are written out-of-band and come back as read-only memoryviews, small ones are inline
+        blob = bytes(range(256)) * 1024
+        value = {'blob': blob, 'array': bytearray(blob[:8192]), 'view': memoryview(blob)[100:5000], 'small': b'small', 'int': 1}
+        bytes_obj = pybytes.from_value(value, oob_threshold=4096)
+        self.assertLess(len(bytes_obj), 200)
+        
+        try:
+            decoded = pybytes.to_value(bytes_obj, oob=True)
+            self.assertEqual(decoded, value)
+            self.assertIsInstance(decoded['blob'], memoryview)
+            self.assertTrue(decoded['blob'].readonly)
+            self.assertIsInstance(decoded['small'], bytes)
+            self.assertEqual(pybytes.view(bytes_obj, oob=True)['array'], value['array'])
+            
+            # The segment is only mapped if that's allowed, and only our user can read it
+            with self.assertRaises(ValueError):
+                pybytes.to_value(bytes_obj)
+            with self.assertRaises(ValueError):
+                pybytes.view(bytes_obj)
+            self.assertEqual(os.stat('/dev/shm' + bytes_obj[2:2 + bytes_obj[1]].decode()).st_mode & 0o777, 0o600)
+        finally:
+            self.assertTrue(pybytes.release_buffers(bytes_obj))
+        
+        # The decoded buffers stay valid, but the bytes can't be decoded again
+        self.assertEqual(decoded['blob'], blob)
+        self.assertFalse(pybytes.release_buffers(bytes_obj))
+        with self.assertRaises(FileNotFoundError):
+            pybytes.to_value(bytes_obj, oob=True)
+        
+        # Without buffers that are large enough, the bytes are the same as without a threshold
+        self.assertEqual(pybytes.from_value(test_values, oob_threshold=1 << 30), pybytes.from_value(test_values))
+        self.assertFalse(pybytes.release_buffers(pybytes.from_value(test_values)))
+        
+        with self.assertRaises(ValueError):
+            pybytes.from_value(value, oob_threshold=4096, compress=1)
+        with self.assertRaises(ValueError):
+            pybytes.to_value(bytes_obj[:4], oob=True)
+        
+        # Frames can't name segments that aren't ours, or that don't hold out-of-band buffers
+        body = bytes_obj[2 + bytes_obj[1]:]
+        for segment_name in (f'test-pybytes-{os.getpid()}', f'sbs-oob-{os.getpid()}-999999'):
+            segment = shared_memory.SharedMemory(segment_name, create=True, size=4096)
+            try:
+                frame = bytes_obj[:1] + bytes([len(segment_name) + 1]) + b'/' + segment_name.encode() + body
+                with self.assertRaises(ValueError):
+                    pybytes.to_value(frame, oob=True)
+                with self.assertRaises(ValueError):
+                    pybytes.release_buffers(frame)
+                self.assertTrue(os.path.exists('/dev/shm/' + segment_name))
+            finally:
+                segment.close()
+                segment.unlink()
+    
+    def test_stats(self):
+        # Nothing is counted until the stats are enabled
+        pybytes.stats(reset=True)
+        pybytes.from_value(test_values)
+        self.assertEqual(pybytes.stats()['encodes'], 0)
+        
+        pybytes.enable_stats()
+        try:
+            # The small size hint makes the encode grow its buffer
+            bytes_obj = pybytes.from_value(list(range(100000)), size_hint=16)
+            pybytes.to_value(bytes_obj)
+            pybytes.to_value(pybytes.from_value(bytes_obj, compress=1))
+            
+            # The counts of other threads are kept after they exit
+            thread = threading.Thread(target=pybytes.from_value, args=('thread',))
+            thread.start()
+            thread.join()
+        finally:
+            pybytes.enable_stats(False)
+        
+        stats = pybytes.stats(reset=True)
+        self.assertEqual(stats['encodes'], 3)
+        self.assertEqual(stats['decodes'], 2)
+        self.assertGreater(stats['reallocs'], 0)
+        self.assertEqual(stats['bytes_in'], len(bytes_obj) + len(pybytes.from_value(bytes_obj)))
+        self.assertGreater(stats['bytes_out'], stats['bytes_in'])
+        self.assertEqual(pybytes.stats(), dict.fromkeys(stats, 0))
+    
+    def test_schema(self):
+        # Schemas from an example dict, a spec of types, and namedtuples with and without annotations
+        Point = namedtuple('Point', 'xcoord ycoord label')
+        class Typed(typing.NamedTuple):
+            index: int
+            name: str
+            extra: list
+        
+        example = {'id': 1, 'name': 'name', 'score': 0.5, 'active': True, 'data': b'', 'tags': [], 'extra': None}
+        cases = [
+            (pybytes.Schema(example), [dict(example, id=i, name=f'user-{i}', tags=['a'] * (i % 3), extra=None if i % 2 else {'x': i}) for i in range(100)]),
+            (pybytes.Schema({'id': int, 'name': str, 'value': object}), [{'id': -i, 'name': 'é' * i, 'value': test_values[i % len(test_values)]} for i in range(100)]),
+            (pybytes.Schema(Point(1.5, 2.5, 'label')), [Point(i / 3, -i / 3, f'point-{i}') for i in range(100)]),
+            (pybytes.Schema(Typed), [Typed(i, str(i), [i]) for i in range(100)]),
+            (pybytes.Schema({}), [{}] * 10),
+        ]
+        
+        for schema, records in cases:
+            self.assertEqual(schema.decode_many(schema.encode_many(records)), records)
+            self.assertEqual(schema.decode_many(schema.encode_many([])), [])
+            for record in records[:10]:
+                decoded = schema.decode(schema.encode(record))
+                self.assertEqual(decoded, record)
+                self.assertIs(type(decoded), type(record))
+        
+        # Every field can be None, and the keys aren't written
+        schema = cases[0][0]
+        self.assertEqual(schema.decode(schema.encode(dict.fromkeys(example))), dict.fromkeys(example))
+        self.assertNotIn(b'score', schema.encode_many(cases[0][1]))
+        self.assertEqual(schema.fields, tuple(example))
+        self.assertIsNone(schema.record_type)
+        self.assertIs(cases[2][0].record_type, Point)
+        
+        # Records that don't match the schema raise
+        for record, error in (([1, 2], TypeError), ({'id': 1}, ValueError), (dict(example, id='1'), TypeError), (dict(example, id=True), TypeError), (dict(example, id=2 ** 64), OverflowError)):
+            with self.assertRaises(error):
+                schema.encode(record)
+        Other = namedtuple('Other', 'first second third')
+        for record in ((1.5, 2.5, 'label'), Other(1.5, 2.5, 'label')):
+            with self.assertRaises(TypeError):
+                cases[2][0].encode(record)
+        
+        # Bytes of other schemas, other protocols, or cut off bytes raise as well
+        bytes_obj = schema.encode(cases[0][1][1])
+        with self.assertRaises(ValueError):
+            cases[1][0].decode(bytes_obj)
+        with self.assertRaises(ValueError):
+            pybytes.to_value(bytes_obj)
+        with self.assertRaises(ValueError):
+            schema.decode(schema.encode_many(cases[0][1]))
+        for i in range(len(bytes_obj)):
+            with self.assertRaises(ValueError):
+                schema.decode(bytes_obj[:i])
+        
+        # A schema without fields can't be made to decode more records than it encodes
+        empty = pybytes.Schema({})
+        header = empty.encode_many([])[:5]
+        for bytes_obj in (header + b'\xff\xff\xff\xff', header + (1 << 17).to_bytes(4, sys.byteorder), empty.encode_many([{}] * 10) + b'\x00'):
+            with self.assertRaises(ValueError):
+                empty.decode_many(bytes_obj)
+        with self.assertRaises(OverflowError):
+            empty.encode_many([{}] * ((1 << 16) + 1))
+    
+    def test_refs(self):
+        # Repeated strings are written once, in any position
+        Point = namedtuple('Point', 'xcoord ycoord')
+        records = [{'status': ('active', 'pending')[i % 2], 'name': f'user-{i % 10}', 'id': i, 'point': Point(i, 'ab')} for i in range(1000)]
+        for value in (records, ['abc'] * 300, {'key': {'key': 'key'}}, 'single', [], None):
+            bytes_obj = pybytes.from_value(value, refs=True)
+            self.assertEqual(pybytes.to_value(bytes_obj), value)
+            self.assertEqual(pybytes.view(bytes_obj), value)
+            
+            file = io.BytesIO()
+            pybytes.dump(value, file, chunk_size=128, refs=True)
+            self.assertEqual(file.getvalue(), bytes_obj)
+            file.seek(0)
+            self.assertEqual(pybytes.load(file, chunk_size=128), value)
+        
+        self.assertLess(len(pybytes.from_value(records, refs=True)), len(pybytes.from_value(records)) * 3 // 4)
+        
+        # The repeated strings are the same objects after decoding
+        decoded = pybytes.to_value(pybytes.from_value(records, refs=True))
+        self.assertIs(decoded[0]['status'], decoded[2]['status'])
+        
+        # Strings past the max number of references are written in full
+        value = [f'unique-{i}' for i in range(70000)] + ['unique-5', 'unique-69999']
+        self.assertEqual(pybytes.to_value(pybytes.from_value(value, refs=True)), value)
+        
+        # References need the strings before them
+        with self.assertRaises(ValueError):
+            pybytes.to_value(bytes([253, 110, 111, 0]))
+    
+    def test_dicts(self):
+        # Dicts with only short string keys, and the ones that can't use the compact key run
+        for value in (
+            {str(i): i for i in range(1000)},
+            {'ünïcödé': 'keys', '': None, 'nested': {'a': [1, 2]}},
+            {'short': 1, 'long' * 100: 2},
+            {'str': 1, 2: 'int'},
+        ):
+            self.assertFromTo(value)
+        
+        # Keys are interned while decoding
+        decoded = pybytes.to_value(pybytes.from_value([{'key': 1}, {'key': 2}]))
+        self.assertIs(next(iter(decoded[0])), next(iter(decoded[1])))
+        
+        # OrderedDicts keep their own order
+        ordered = OrderedDict({'a': 1, 'b': 2, 'c': 3})
+        ordered.move_to_end('a')
+        self.assertEqual(list(pybytes.to_value(pybytes.from_value(ordered))), ['b', 'c', 'a'])
+    
+    def test_packed(self):
+        # Homogeneous numeric lists and tuples are packed, which has to keep the exact item types
+        for value in (
+            [1.5, -0.0, float('inf')] * 10,
+            [True, False] * 10,
+            list(range(-128, 128)),
+            list(range(-40000, 40000, 7)),
+            tuple([2**31, -2**31 - 1] * 10),
+            [2**63 - 1, -2**63] * 10,
+            [2**64] * 10,
+            [1, 2.0] * 10,
+            [True] + [1] * 10,
+            [1] * 7,
+        ):
+            decoded = pybytes.to_value(pybytes.from_value(value))
+            self.assertEqual(value, decoded)
+            self.assertIs(type(value), type(decoded))
+            self.assertEqual([type(item) for item in value], [type(item) for item in decoded])
+        
+        # Packing saves the datatype marker of every item
+        self.assertLess(len(pybytes.from_value([1.5] * 1000)), 1000 * 9)
+        
+        # Arrays keep their typecode
+        for value in (array('d', range(1000)), array('b', range(-128, 128)), array('u', 'unicode'), array('Q')):
+            decoded = pybytes.to_value(pybytes.from_value(value))
+            self.assertEqual(value, decoded)
+            self.assertEqual(value.typecode, decoded.typecode)
+        
+        # Packed values can be streamed and viewed like any other value
+        value = [[float(i)] * 10000 for i in range(5)]
+        file = io.BytesIO()
+        pybytes.dump(value, file, chunk_size=1024)
+        file.seek(0)
+        self.assertEqual(pybytes.load(file, chunk_size=1024), value)
+        self.assertEqual(pybytes.view(pybytes.from_value(value))[3], value[3])
+    
+    def test_views(self):
+        # Every value is found at the right offset by skipping over the ones before it
+        items = list(test_values) + [Path('/long' * 100)]
+        view = pybytes.view(pybytes.from_value(items))
+        self.assertIsInstance(view, pybytes.ListView)
+        self.assertEqual(len(view), len(items))
+        for i, value in enumerate(items):
+            self.assertEqual(view[i], value)
+        self.assertEqual(view[-1], items[-1])
+        self.assertEqual(view[2:8:3], items[2:8:3])
+        self.assertEqual(view, items)
+        self.assertEqual(view.decode(), items)
+        self.assertRaises(IndexError, view.__getitem__, len(items))
+        
+        # Nested containers become views too, including the compact dicts
+        value = {'a': [1, {'b': (2, 3)}], 'c': 'x', 5: None}
+        view = pybytes.view(pybytes.from_value(value))
+        self.assertIsInstance(view['a'][1], pybytes.DictView)
+        self.assertEqual(view['a'][1]['b'][1], 3)
+        self.assertEqual(list(view), list(value))
+        self.assertEqual(view.items()[2], (5, None))
+        self.assertEqual(view.get('missing', 1), 1)
+        self.assertTrue('c' in view and 'missing' not in view)
+        self.assertRaises(KeyError, view.__getitem__, 'missing')
+        self.assertEqual(pybytes.view(pybytes.from_value({str(i): i for i in range(100)}))['42'], 42)
+        
+        # Other values are converted directly
+        self.assertEqual(pybytes.view(pybytes.from_value(12345)), 12345)
+        self.assertEqual(pybytes.view(pybytes.from_value([])), [])
+        
+        # The buffer stays exported while a view of it exists
+        buffer = bytearray(pybytes.from_value([1, 2]))
+        view = pybytes.view(buffer)
+        self.assertRaises(BufferError, buffer.extend, b'...')
+        del view
+        buffer.extend(b'...')
+    
+    def test_sfs(self):
+        # Lists and dicts convert back fully, in their original order
+        items = list(test_values[:20])
+        mapping = {str(i): value for i, value in enumerate(test_values[:20])}
+        self.assertEqual(pybytes.to_value(pybytes.sfs_from_value(items)), items)
+        self.assertEqual(list(pybytes.to_value(pybytes.sfs_from_value(mapping)).items()), list(mapping.items()))
+        self.assertEqual(pybytes.to_value(pybytes.sfs_from_value([])), [])
+        self.assertEqual(pybytes.to_value(pybytes.sfs_from_value({})), {})
+        
+        # Single items, including ones that have to move and new keys that grow the index
+        buffer = pybytes.sfs_from_value({'a': 1, (1, 2): [3]})
+        self.assertEqual(pybytes.sfs_get_item(buffer, (1, 2)), [3])
+        for i in range(200):
+            pybytes.sfs_set_item(buffer, 'a', 'x' * i)
+            pybytes.sfs_set_item(buffer, i, i)
+        self.assertEqual(pybytes.sfs_get_item(buffer, 'a'), 'x' * 199)
+        self.assertEqual(pybytes.to_value(buffer), {'a': 'x' * 199, (1, 2): [3], **{i: i for i in range(200)}})
+        self.assertRaises(KeyError, pybytes.sfs_get_item, buffer, 'missing')
+        
+        # Lists keep their length, and accept negative indexes
+        buffer = pybytes.sfs_from_value([1, 2, 3])
+        pybytes.sfs_set_item(buffer, -1, 'three')
+        self.assertEqual(pybytes.sfs_get_item(buffer, 2), 'three')
+        self.assertRaises(IndexError, pybytes.sfs_set_item, buffer, 3, 4)
+        
+        # Fixed-size buffers are written in place, until they run out of space
+        view = memoryview(bytearray(buffer))
+        pybytes.sfs_set_item(view, 0, 0)
+        self.assertEqual(pybytes.to_value(view), [0, 2, 'three'])
+        self.assertRaises(BufferError, pybytes.sfs_set_item, view, 0, 'x' * 1000)
+        
+        self.assertRaises(TypeError, pybytes.sfs_from_value, (1, 2))
+        self.assertRaises(ValueError, pybytes.sfs_get_item, pybytes.from_value([1]), 0)
 
 if __name__ == '__main__':
     main()